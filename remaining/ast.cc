@@ -277,7 +277,7 @@ ast_equal::ast_equal(position_information *p,
                      ast_expression *r) :
     ast_binaryrelation(p, l, r)
 {
-    tag = AST_BINARYRELATION;
+    tag = AST_EQUAL;
 }
 
 /* The ast_notequal class. */
@@ -443,6 +443,20 @@ ast_cast::ast_cast(position_information *p,
 }
 
 
+/* The ast_inlinedcall class. */
+ast_inlinedcall::ast_inlinedcall(position_information *p,
+                                 sym_index f,
+                                 ast_stmt_list *b,
+                                 ast_expression *r) :
+    ast_expression(p, r->type),
+    function(f),
+    body(b),
+    result(r)
+{
+    tag = AST_INLINEDCALL;
+}
+
+
 /* The ast_functionhead class. */
 ast_functionhead::ast_functionhead(position_information *p,
                                    sym_index s) :
@@ -827,6 +841,19 @@ void ast_cast::print(ostream &o)
 }
 
 
+void ast_inlinedcall::print(ostream &o)
+{
+    o << "Inlined call (body, result) ["
+      << short_symbols << sym_tab->get_symbol(function) << ", "
+      << sym_tab->get_symbol(type) << long_symbols << "]\n";
+    begin_child(o);
+    o << body << endl;
+    end_child(o);
+    last_child(o);
+    o << result;
+    end_child(o);
+}
+
 void ast_functionhead::print(ostream &o)
 {
     o << "Function head (" << short_symbols << sym_tab->get_symbol(sym_p)
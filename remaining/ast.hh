@@ -81,6 +81,8 @@ AST_NODE
      |
      +- AST_CAST
      |
+     +- AST_INLINEDCALL
+     |
      +- AST_PARAMETER
 */
 
@@ -126,7 +128,8 @@ enum ast_node_types {
     AST_FUNCTIONHEAD,
     AST_PROCEDUREHEAD,
     AST_PARAMETER,
-    AST_CAST
+    AST_CAST,
+    AST_INLINEDCALL
 };
 typedef enum ast_node_types ast_node_type;
 
@@ -142,11 +145,14 @@ class quad_list;
 /* Class stubs to allow referencing the classes below before they're declared.
    See below. */
 class ast_binaryoperation;
+class ast_binaryrelation;
 class ast_stmt_list;
 class ast_id;
 class ast_integer;
 class ast_real;
 class ast_cast;
+class ast_uminus;
+class ast_not;
 
 class quad_list;
 
@@ -250,6 +256,12 @@ public:
 
     virtual sym_index generate_quads(quad_list &) = 0;
 
+    // Quad generation for the condition of an if, elsif or while statement,
+    // which jumps to the label if the expression is false, or if it is true.
+    // By default the value is computed and tested by a q_jmpf. See quads.cc.
+    virtual void generate_false_jump(quad_list &, int);
+    virtual void generate_true_jump(quad_list &, int);
+
     // Used for safe downcasting. We could provide a mechanism to safely
     // downcast ALL ast nodes... But these ones are the only ones we'll need
     // in this lab course. They will be used during AST optimization.
@@ -272,6 +284,14 @@ public:
         return NULL;
     }
 
+    virtual ast_uminus *get_ast_uminus() {
+        return NULL;
+    }
+
+    virtual ast_not *get_ast_not() {
+        return NULL;
+    }
+
     // This, however, is very illegal. It's also only used in optimize.cc, to
     // allow us to downcast an ast_expression to an ast_binaryoperation.
     // See the comments in that file for more information.
@@ -279,6 +299,12 @@ public:
         fatal("Illegal downcast to ast_binaryoperation from ast_expression");
         return NULL;
     }
+
+    // The same goes for binary relations, which are folded in optimize.cc.
+    virtual ast_binaryrelation *get_ast_binaryrelation() {
+        fatal("Illegal downcast to ast_binaryrelation from ast_expression");
+        return NULL;
+    }
 };
 
 
@@ -309,6 +335,12 @@ public:
     virtual void optimize();
 
     virtual sym_index generate_quads(quad_list &) = 0;
+
+    // Needed for safe downcasting.
+    virtual ast_binaryrelation *get_ast_binaryrelation() {
+        fatal("Illegal downcast to ast_binaryrelation");
+        return NULL;
+    }
 };
 
 
@@ -750,6 +782,11 @@ public:
 
     // Quad generation.
     virtual sym_index generate_quads(quad_list &);
+
+    // Safe downcasting.
+    virtual ast_uminus *get_ast_uminus() {
+        return this;
+    }
 };
 
 
@@ -773,6 +810,16 @@ public:
 
     // Quad generation.
     virtual sym_index generate_quads(quad_list &);
+
+    // Quad generation for conditions, jumping as soon as the result is
+    // known.
+    virtual void generate_false_jump(quad_list &, int);
+    virtual void generate_true_jump(quad_list &, int);
+
+    // Safe downcasting.
+    virtual ast_not *get_ast_not() {
+        return this;
+    }
 };
 
 
@@ -860,6 +907,38 @@ public:
 
 
 
+/* A function call which has been replaced by the function body. The
+   statements in body are executed first, and then result is evaluated to
+   give the value of the call. Only created by the inliner, see inline.cc,
+   which is run after type checking. */
+class ast_inlinedcall : public ast_expression
+{
+protected:
+    virtual void print(ostream &);
+public:
+    // The function that was inlined. Only used for printing.
+    sym_index function;
+
+    // The function body, with the parameters and local variables replaced
+    // by temporaries. Can be NULL.
+    ast_stmt_list *body;
+
+    // The value returned by the function.
+    ast_expression *result;
+
+    // Constructor.
+    ast_inlinedcall(position_information *, sym_index, ast_stmt_list *,
+                    ast_expression *);
+
+    // AST optimization.
+    virtual void optimize();
+
+    // Quad generation.
+    virtual sym_index generate_quads(quad_list &);
+};
+
+
+
 /*** Classes derived from ast_binaryrelation ***/
 
 /* Equality operator. a = b. */
@@ -879,6 +958,14 @@ public:
 
     // Quad generation.
     virtual sym_index generate_quads(quad_list &);
+
+    // Quad generation for conditions, comparing and jumping in one quad.
+    virtual void generate_false_jump(quad_list &, int);
+
+    // Safe downcasts.
+    virtual ast_equal *get_ast_binaryrelation() {
+        return this;
+    }
 };
 
 
@@ -899,6 +986,14 @@ public:
 
     // Quad generation.
     virtual sym_index generate_quads(quad_list &);
+
+    // Quad generation for conditions, comparing and jumping in one quad.
+    virtual void generate_false_jump(quad_list &, int);
+
+    // Safe downcasts.
+    virtual ast_notequal *get_ast_binaryrelation() {
+        return this;
+    }
 };
 
 
@@ -919,6 +1014,14 @@ public:
 
     // Quad generation.
     virtual sym_index generate_quads(quad_list &);
+
+    // Quad generation for conditions, comparing and jumping in one quad.
+    virtual void generate_false_jump(quad_list &, int);
+
+    // Safe downcasts.
+    virtual ast_lessthan *get_ast_binaryrelation() {
+        return this;
+    }
 };
 
 
@@ -939,6 +1042,14 @@ public:
 
     // Quad generation.
     virtual sym_index generate_quads(quad_list &);
+
+    // Quad generation for conditions, comparing and jumping in one quad.
+    virtual void generate_false_jump(quad_list &, int);
+
+    // Safe downcasts.
+    virtual ast_greaterthan *get_ast_binaryrelation() {
+        return this;
+    }
 };
 
 
@@ -1014,6 +1125,11 @@ public:
     // Quad generation.
     virtual sym_index generate_quads(quad_list &);
 
+    // Quad generation for conditions, jumping as soon as the result is
+    // known.
+    virtual void generate_false_jump(quad_list &, int);
+    virtual void generate_true_jump(quad_list &, int);
+
     // Safe downcasts.
     virtual ast_or *get_ast_binaryoperation() {
         return this;
@@ -1039,6 +1155,11 @@ public:
     // Quad generation.
     virtual sym_index generate_quads(quad_list &);
 
+    // Quad generation for conditions, jumping as soon as the result is
+    // known.
+    virtual void generate_false_jump(quad_list &, int);
+    virtual void generate_true_jump(quad_list &, int);
+
     // Safe downcasts.
     virtual ast_and *get_ast_binaryoperation() {
         return this;
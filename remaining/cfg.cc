@@ -0,0 +1,359 @@
+#include <iomanip>
+
+#include "cfg.hh"
+
+/*** This file contains the construction of control flow graphs over quad
+ lists. See cfg.hh. ***/
+
+basic_block::basic_block(int first, int last) :
+	first(first),
+	last(last),
+	rpo(-1),
+	idom(-1),
+	loop(-1)
+{
+}
+
+control_flow_graph::control_flow_graph(quad_list *q) :
+	quads(q)
+{
+	find_blocks();
+	find_edges();
+	order_blocks();
+	find_dominators();
+	find_loops();
+}
+
+/* Returns true if a quad of this kind jumps, and so ends a block. */
+static bool ends_block(quad_op_type op)
+{
+	return op == q_jmp || quad_conditional_jump(op) || op == q_ireturn
+			|| op == q_rreturn;
+}
+
+/* Splits the quad list into basic blocks. */
+void control_flow_graph::find_blocks()
+{
+	int n = quads->size();
+	int first = 0;
+
+	for (int i = 0; i < n; i++) {
+		quad_op_type op = quads->op_code(i);
+
+		// A label starts a new block, unless it's the first quad of one.
+		if (op == q_labl && i > first) {
+			blocks.push_back(basic_block(first, i - 1));
+			first = i;
+		}
+		if (ends_block(op)) {
+			blocks.push_back(basic_block(first, i));
+			first = i + 1;
+		}
+	}
+	if (first < n) {
+		blocks.push_back(basic_block(first, n - 1));
+	}
+}
+
+void control_flow_graph::add_edge(int from, int to)
+{
+	// A conditional jump to the very next quad gives the same edge twice.
+	vector<int> &succ = blocks[from].succ;
+	for (unsigned int i = 0; i < succ.size(); i++) {
+		if (succ[i] == to) {
+			return;
+		}
+	}
+	succ.push_back(to);
+	blocks[to].pred.push_back(from);
+}
+
+/* Adds the edges between the blocks. */
+void control_flow_graph::find_edges()
+{
+	if (blocks.empty()) {
+		return;
+	}
+
+	// Labels are numbered for the whole program, so a table from the
+	// smallest to the largest label of this quad list maps them to blocks.
+	long min_label = 0;
+	long max_label = -1;
+	for (unsigned int b = 0; b < blocks.size(); b++) {
+		quadruple q = quads->get(blocks[b].first);
+		if (q.op_code == q_labl) {
+			if (max_label < min_label) {
+				min_label = max_label = q.int1;
+			} else {
+				min_label = min(min_label, q.int1);
+				max_label = max(max_label, q.int1);
+			}
+		}
+	}
+	vector<int> label_block(max_label - min_label + 1, -1);
+	for (unsigned int b = 0; b < blocks.size(); b++) {
+		quadruple q = quads->get(blocks[b].first);
+		if (q.op_code == q_labl) {
+			label_block[q.int1 - min_label] = b;
+		}
+	}
+
+	for (unsigned int b = 0; b < blocks.size(); b++) {
+		quadruple q = quads->get(blocks[b].last);
+		bool falls_through = !ends_block(q.op_code)
+				|| quad_conditional_jump(q.op_code);
+
+		if (ends_block(q.op_code)) {
+			// Returns jump to the label ending the quad list.
+			if (q.int1 < min_label || q.int1 > max_label
+					|| label_block[q.int1 - min_label] == -1) {
+				fatal("Jump to label outside the quad list");
+			} else {
+				add_edge(b, label_block[q.int1 - min_label]);
+			}
+		}
+		if (falls_through && b + 1 < blocks.size()) {
+			add_edge(b, b + 1);
+		}
+	}
+}
+
+/* Numbers the blocks in reverse postorder of a depth first walk from the
+   entry block. */
+void control_flow_graph::order_blocks()
+{
+	if (blocks.empty()) {
+		return;
+	}
+
+	// The walk uses an explicit stack of (block, next successor to visit)
+	// so deeply nested code can't overflow the C++ stack.
+	vector<bool> visited(blocks.size(), false);
+	vector<pair<int, unsigned int> > stack;
+	vector<int> postorder;
+
+	visited[0] = true;
+	stack.push_back(make_pair(0, 0u));
+	while (!stack.empty()) {
+		int b = stack.back().first;
+		unsigned int i = stack.back().second;
+
+		if (i < blocks[b].succ.size()) {
+			stack.back().second++;
+			int s = blocks[b].succ[i];
+			if (!visited[s]) {
+				visited[s] = true;
+				stack.push_back(make_pair(s, 0u));
+			}
+		} else {
+			postorder.push_back(b);
+			stack.pop_back();
+		}
+	}
+
+	rpo_order.assign(postorder.rbegin(), postorder.rend());
+	for (unsigned int i = 0; i < rpo_order.size(); i++) {
+		blocks[rpo_order[i]].rpo = i;
+	}
+}
+
+/* Walks up the dominator tree from two blocks until they meet. */
+int control_flow_graph::intersect(int a, int b)
+{
+	while (a != b) {
+		while (blocks[a].rpo > blocks[b].rpo) {
+			a = blocks[a].idom;
+		}
+		while (blocks[b].rpo > blocks[a].rpo) {
+			b = blocks[b].idom;
+		}
+	}
+	return a;
+}
+
+/* Computes the immediate dominators, using the algorithm of Cooper, Harvey
+   and Kennedy ("A Simple, Fast Dominance Algorithm"). It iterates until
+   nothing changes, but the control flow of a Diesel program is always
+   reducible, and visiting the blocks in reverse postorder then gets all
+   dominators right on the first pass. The second one just confirms it. */
+void control_flow_graph::find_dominators()
+{
+	if (rpo_order.empty()) {
+		return;
+	}
+
+	// The entry block is temporarily its own dominator, which stops
+	// intersect() at the root of the tree.
+	blocks[0].idom = 0;
+
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (unsigned int i = 1; i < rpo_order.size(); i++) {
+			basic_block &block = blocks[rpo_order[i]];
+			int new_idom = -1;
+
+			for (unsigned int p = 0; p < block.pred.size(); p++) {
+				int pred = block.pred[p];
+				if (blocks[pred].idom == -1) {
+					// Unreachable, or not processed yet.
+					continue;
+				}
+				if (new_idom == -1) {
+					new_idom = pred;
+				} else {
+					new_idom = intersect(pred, new_idom);
+				}
+			}
+			if (block.idom != new_idom) {
+				block.idom = new_idom;
+				changed = true;
+			}
+		}
+	}
+
+	blocks[0].idom = -1;
+	for (unsigned int i = 1; i < rpo_order.size(); i++) {
+		int b = rpo_order[i];
+		blocks[blocks[b].idom].dom_children.push_back(b);
+	}
+}
+
+bool control_flow_graph::dominates(int a, int b)
+{
+	if (blocks[a].rpo == -1 || blocks[b].rpo == -1) {
+		return false;
+	}
+	// A dominator always comes earlier in reverse postorder, so there is no
+	// need to walk further up the tree than a.
+	while (b != -1 && blocks[b].rpo >= blocks[a].rpo) {
+		if (b == a) {
+			return true;
+		}
+		b = blocks[b].idom;
+	}
+	return false;
+}
+
+/* Finds the natural loops. A back edge is an edge to a block that dominates
+   its source, and the loop consists of the header and all blocks that can
+   reach the source of a back edge without going through the header. Back
+   edges to the same header give a single loop. */
+void control_flow_graph::find_loops()
+{
+	vector<int> work;
+
+	// Headers are visited in reverse postorder, so an outer loop is always
+	// found before the loops nested inside it. The inner loop then takes
+	// over the blocks it contains, and the loop it takes them from is its
+	// parent.
+	for (unsigned int i = 0; i < rpo_order.size(); i++) {
+		int h = rpo_order[i];
+		basic_block &header = blocks[h];
+
+		for (unsigned int p = 0; p < header.pred.size(); p++) {
+			if (dominates(h, header.pred[p])) {
+				work.push_back(header.pred[p]);
+			}
+		}
+		if (work.empty()) {
+			continue;
+		}
+
+		int l = loops.size();
+		loops.push_back(loop_info());
+		loop_info &loop = loops.back();
+		loop.header = h;
+		loop.parent = header.loop;
+		loop.depth = loop.parent == -1 ? 1 : loops[loop.parent].depth + 1;
+		loop.blocks.push_back(h);
+		header.loop = l;
+
+		while (!work.empty()) {
+			int b = work.back();
+			work.pop_back();
+			if (blocks[b].loop == l) {
+				continue;
+			}
+			blocks[b].loop = l;
+			loop.blocks.push_back(b);
+			for (unsigned int q = 0; q < blocks[b].pred.size(); q++) {
+				int pred = blocks[b].pred[q];
+				if (blocks[pred].rpo != -1 && blocks[pred].loop != l) {
+					work.push_back(pred);
+				}
+			}
+		}
+	}
+}
+
+int control_flow_graph::loop_depth(int b)
+{
+	return blocks[b].loop == -1 ? 0 : loops[blocks[b].loop].depth;
+}
+
+/* Prints a list of blocks, or '-' if it's empty. */
+static void print_blocks(ostream &o, const vector<int> &list)
+{
+	if (list.empty()) {
+		o << " -";
+	}
+	for (unsigned int i = 0; i < list.size(); i++) {
+		o << " B" << list[i];
+	}
+}
+
+/* The quads are numbered from 1, like in the quad list printout. */
+void control_flow_graph::print(ostream &o)
+{
+	for (unsigned int b = 0; b < blocks.size(); b++) {
+		basic_block &block = blocks[b];
+
+		o << setw(4) << "B" << left << setw(4) << b << right
+		  << "quads " << block.first + 1 << "-" << block.last + 1;
+		if (block.rpo == -1) {
+			o << " (unreachable)" << endl;
+			continue;
+		}
+		o << endl;
+		o << "        succ:";
+		print_blocks(o, block.succ);
+		o << endl << "        pred:";
+		print_blocks(o, block.pred);
+		o << endl << "        idom: ";
+		if (block.idom == -1) {
+			o << "-";
+		} else {
+			o << "B" << block.idom;
+		}
+		o << endl << "        dominates:";
+		print_blocks(o, block.dom_children);
+		if (block.loop != -1) {
+			o << endl << "        loop: L" << block.loop
+			  << " (depth " << loop_depth(b) << ")";
+		}
+		o << endl;
+	}
+
+	for (unsigned int l = 0; l < loops.size(); l++) {
+		o << setw(4) << "L" << left << setw(4) << l << right
+		  << "header B" << loops[l].header
+		  << ", depth " << loops[l].depth;
+		if (loops[l].parent != -1) {
+			o << ", inside L" << loops[l].parent;
+		}
+		o << endl << "        blocks:";
+		print_blocks(o, loops[l].blocks);
+		o << endl;
+	}
+}
+
+ostream &operator<<(ostream &o, control_flow_graph *cfg)
+{
+	if (cfg != NULL) {
+		cfg->print(o);
+	} else {
+		o << "Control flow graph: NULL\n";
+	}
+	return o;
+}
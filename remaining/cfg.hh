@@ -0,0 +1,99 @@
+#ifndef __CFG_HH__
+#define __CFG_HH__
+
+#include <vector>
+
+#include "quads.hh"
+
+/*** The control flow graph of a procedure's quad list. The quads are split
+ into basic blocks, straight sequences of quads that are only entered at the
+ top and only left at the bottom. A block starts at the first quad, at each
+ label and after each jump or return, and its successors are the blocks it
+ can jump or fall through to. On top of that we compute the dominator tree
+ and the natural loops. The graph refers to the quads by their index in the
+ quad list, so it must be rebuilt if quads are added or removed. ***/
+
+/* A basic block. Blocks are numbered in the order their quads appear, so
+   block 0 is the entry block. */
+class basic_block
+{
+public:
+	// The indexes of the first and last quad in the block.
+	int first;
+	int last;
+
+	// The blocks control can go to from this block, and come from.
+	vector<int> succ;
+	vector<int> pred;
+
+	// The position of the block in a reverse postorder walk of the graph,
+	// or -1 if the block can't be reached from the entry block.
+	int rpo;
+
+	// The immediate dominator, and the blocks this block is the immediate
+	// dominator of. idom is -1 for the entry block and unreachable blocks.
+	int idom;
+	vector<int> dom_children;
+
+	// The innermost loop the block is part of, or -1.
+	int loop;
+
+	basic_block(int, int);
+};
+
+/* A natural loop: the header block, which dominates all the blocks in the
+   loop, and all blocks that can reach a back edge to the header without
+   passing through it. */
+class loop_info
+{
+public:
+	int header;
+
+	// The innermost loop containing this one, or -1. The depth of an
+	// outermost loop is 1.
+	int parent;
+	int depth;
+
+	// All blocks of the loop, including those of nested loops.
+	vector<int> blocks;
+};
+
+class control_flow_graph
+{
+private:
+	void find_blocks();
+	void add_edge(int, int);
+	void find_edges();
+	void order_blocks();
+	void find_dominators();
+	void find_loops();
+
+	int intersect(int, int);
+
+	void print(ostream &);
+
+public:
+	// The quads the graph was built from.
+	quad_list *quads;
+
+	vector<basic_block> blocks;
+
+	// The reachable blocks in reverse postorder. Every block comes before
+	// its successors, except along back edges.
+	vector<int> rpo_order;
+
+	vector<loop_info> loops;
+
+	// Builds the graph. This is linear in the number of quads.
+	control_flow_graph(quad_list *);
+
+	// Returns true if block a dominates block b.
+	bool dominates(int, int);
+
+	// Returns the loop depth of a block, 0 if it's not in a loop.
+	int loop_depth(int);
+
+	friend ostream &operator<<(ostream &, control_flow_graph *);
+};
+
+#endif
@@ -3,37 +3,62 @@
 #include <fstream>
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
+#include <sys/stat.h>
 
 #include "symtab.hh"
 #include "quads.hh"
 #include "codegen.hh"
+#include "regalloc.hh"
+#include "machine.hh"
+#include "object.hh"
 
 using namespace std;
 
 // Defined in main.cc.
 extern bool assembler_trace;
+extern bool optimize;
+extern int optimize_level;
+extern bool static_links;
+extern bool object_code;
+extern bool executable_code;
 
-// Used in parser.y. Ideally the filename should be parametrized, but it's not
-// _that_ important...
+// Used in parser.y. The file name is set by main.cc, see the -o option.
 code_generator *code_gen = new code_generator("d.out");
 
 // Constructor.
-code_generator::code_generator(const string object_file_name)
+code_generator::code_generator(const string object_file_name) :
+    out_buffer(OUT_BUFFER_SIZE),
+    object(new object_file()),
+    object_file_name(object_file_name)
 {
-    out.open(object_file_name);
-
-    reg[RAX] = "rax";
-    reg[RCX] = "rcx";
-    reg[RDX] = "rdx";
+    for (int i = 0; i < NR_REGISTERS; i++) {
+        reg[i] = register_name(register_type(i));
+    }
 }
 
 
-/* Destructor. */
+/* Destructor. Called by main.cc before exiting the compiler, to write what
+   is left in the buffer of the outfile. */
 code_generator::~code_generator()
 {
-    // Make sure we close the outfile before exiting the compiler.
-    out << flush;
-    out.close();
+    open();
+    out_file.close();
+    delete object;
+}
+
+
+/* Opens the outfile, unless it is already open. Its buffer is large enough
+   to only be written in big chunks, rather than on every line. */
+void code_generator::open()
+{
+    if (!out_file.is_open()) {
+        out_file.rdbuf()->pubsetbuf(&out_buffer[0], out_buffer.size());
+        out_file.open(object_file_name, ios::out | ios::binary);
+        if (!out_file) {
+            fatal("could not open " + object_file_name);
+        }
+    }
 }
 
 void code_generator::debug(string x){
@@ -44,12 +69,56 @@ void code_generator::debug(string x){
 
 /* This method is called from parser.y when code generation is to start.
    The argument is a quad_list representing the body of the procedure, and
-   the symbol for the environment for which code is being generated. */
+   the symbol for the environment for which code is being generated. From
+   optimization level 2 the variables of the procedure are first given
+   registers. From optimization level 1 the peephole optimizer goes over the
+   instructions generated before they are written to the file, as assembler
+   code or, with the -b and -e options, as machine code in an object file or
+   executable. */
 void code_generator::generate_assembler(quad_list *q, symbol *env)
 {
+    registers.clear();
+    saved_registers.clear();
+    sse = ::optimize && optimize_level >= 1;
+    cache_frames = ::optimize && optimize_level >= 1;
+    frame_level = env->level + 1;
+    cached_level = -1;
+    register_parameters = ::optimize && optimize_level >= 2;
+    if (::optimize && optimize_level >= 2) {
+        reg_alloc->allocate(q, env->level + 1, sse, register_parameters,
+                            registers, saved_registers);
+    }
+    leaf = cache_frames && leaf_procedure(q, env);
+
     prologue(env);
     expand(q);
     epilogue(env);
+
+    // Below RBP is the display, or the static link. A procedure without a
+    // frame of its own only reads the display of its caller up to the level
+    // it is declared on.
+    instruction_list code(out.str());
+    out.str("");
+    if (::optimize && optimize_level >= 1) {
+        code.peephole(static_links ? 1 : leaf ? frame_level - 1 : frame_level);
+    }
+    open();
+    if (object_code) {
+        // The global level comes last, when the whole program can be
+        // encoded.
+        object->add(code);
+        if (env->level == 0) {
+            object->write(out_file, executable_code);
+            if (executable_code) {
+                // Let those the umask allows to run it.
+                mode_t mask = umask(0);
+                umask(mask);
+                chmod(object_file_name.c_str(), 0777 & ~mask);
+            }
+        }
+    } else {
+        out_file << code;
+    }
 }
 
 
@@ -63,6 +132,41 @@ int code_generator::align(int frame_size)
 
 
 
+/* Returns true if a procedure may do without a frame of its own, which is
+   done from optimization level 1. It must call nothing, so no nested
+   procedure can look at its variables, and they must fit in the red zone
+   below RSP. RBP is then left pointing at the frame of the caller, whose
+   display has the same frames as the one the procedure would have copied,
+   but with static links there is none to follow, so the procedure must not
+   use the variables of enclosing blocks either. */
+bool code_generator::leaf_procedure(quad_list *q_list, symbol *env)
+{
+    int ar_size = env->tag == SYM_FUNC
+        ? env->get_function_symbol()->ar_size
+        : env->get_procedure_symbol()->ar_size;
+
+    // The main program is called from the run-time support.
+    if (env->level == 0 || align(ar_size) > RED_ZONE) {
+        return false;
+    }
+    for (int i = 0; i < q_list->size(); i++) {
+        quadruple q = q_list->get(i);
+        sym_index args[3] = { q.sym1, q.sym2, q.sym3 };
+        if (q.op_code == q_call) {
+            return false;
+        }
+        for (int a = 0; a < 3 && static_links; a++) {
+            symbol *sym = quad_arg(q.op_code, a + 1) == qa_sym
+                ? sym_tab->get_symbol(args[a]) : NULL;
+            if (sym != NULL && sym->tag != SYM_CONST
+                && sym->level < frame_level) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
 /* This method generates assembler code for initialisating a procedure or
    function. */
 void code_generator::prologue(symbol *new_env)
@@ -98,31 +202,83 @@ void code_generator::prologue(symbol *new_env)
     /* Print out the label number (a SYM_PROC/ SYM_FUNC attribute) */
     out << "L" << label_nr << ":" << "\t\t\t" << "# " <<
         /* Print out the function/procedure name */
-        sym_tab->pool_lookup(new_env->id) << endl;
+        sym_tab->pool_lookup(new_env->id) << "\n";
 
     if (assembler_trace) {
-        out << "\t" << "# PROLOGUE (" << short_symbols << new_env << long_symbols << ")" << endl;
+        out << "\t" << "# PROLOGUE (" << short_symbols << new_env << long_symbols << ")" << "\n";
     }
 
     /* Your code here */
 
-    //store the previous RBP
-    out << "\t\t" << "push" << "\t" << "rbp" << endl;
-    //Save the previous RSP in a temporary location
-    out << "\t\t" << "mov" << "\t" << "rcx, rsp" << endl;
+    if (leaf) {
+        // Nothing to set up, the variables are below RSP.
+    } else if (static_links) {
+        // The caller passes the static link, the frame of the block the
+        // procedure is declared in, in RAX. It goes right below the old RBP,
+        // where the display would start.
+        out << "\t\t" << "push" << "\t" << "rbp" << "\n";
+        out << "\t\t" << "mov" << "\t" << "rbp, rsp" << "\n";
+        out << "\t\t" << "push" << "\t" << "rax" << "\n";
+        out << "\t\t" << "sub" << "\t" << "rsp, " << ar_size << "\n";
+    } else {
+        //store the previous RBP
+        out << "\t\t" << "push" << "\t" << "rbp" << "\n";
+        //Save the previous RSP in a temporary location
+        out << "\t\t" << "mov" << "\t" << "rcx, rsp" << "\n";
+
+        //any other display values are copied here
+        for (int i = 1; i <= lvl; i++){
+        	out << "\t\t" << "push" << "\t" << "[rbp-" << i*STACK_WIDTH << "]" << "\n";
+        }
 
-    //any other display values are copied here
-    for (int i = 1; i <= lvl; i++){
-    	out << "\t\t" << "push" << "\t" << "[rbp-" << i*STACK_WIDTH << "]" << endl;
+        //push the previous RSP on the stack
+        out << "\t\t" << "push" << "\t" << "rcx" << "\n";
+        //and really make it our new RBP
+        out << "\t\t" << "mov" << "\t" << "rbp, rcx" << "\n";
+        //allocate space for temporary storage
+        out << "\t\t" << "sub" << "\t" << "rsp, " << ar_size<< "\n";
     }
 
-    //push the previous RSP on the stack
-    out << "\t\t" << "push" << "\t" << "rcx" << endl;
-    //and really make it our new RBP
-    out << "\t\t" << "mov" << "\t" << "rbp, rcx" << endl;
-    //allocate space for temporary storage
-    out << "\t\t" << "sub" << "\t" << "rsp, " << ar_size<< endl;
-    out << flush;
+    // Save the callee saved registers the register allocator handed out.
+    for (unsigned int i = 0; i < saved_registers.size(); i++) {
+        out << "\t\t" << "push" << "\t" << reg[saved_registers[i]] << "\n";
+    }
+
+    // Move the register arguments to the registers they were given, or
+    // spill them to their slots on the stack.
+    if (register_parameters) {
+        vector<pair<register_type, register_type> > moves;
+        map<parameter_symbol *, register_type> given;
+        map<sym_index, register_type>::iterator r;
+        for (r = registers.begin(); r != registers.end(); r++) {
+            symbol *sym = sym_tab->get_symbol(r->first);
+            if (sym->tag == SYM_PARAM) {
+                given[sym->get_parameter_symbol()] = r->second;
+            }
+        }
+        for (parameter_symbol *p = last_arg; p != NULL; p = p->preceding) {
+            register_type arg = parameter_register(p);
+            if (arg == NR_REGISTERS) {
+                continue;
+            }
+            if (given.find(p) != given.end()) {
+                moves.push_back(make_pair(given[p], arg));
+            } else {
+                out << "\t\t" << (arg >= XMM0 ? "movsd" : "mov") << "\t"
+                    << (arg >= XMM0 ? "qword ptr " : "") << "["
+                    << frame_register(frame_level) << "+"
+                    << parameter_offset(p) << "], " << reg[arg] << "\n";
+            }
+        }
+        move_registers(moves);
+    }
+    if (assembler_trace) {
+        map<sym_index, register_type>::iterator r;
+        for (r = registers.begin(); r != registers.end(); r++) {
+            out << "\t" << "# " << short_symbols << sym_tab->get_symbol(r->first)
+                << long_symbols << " in " << reg[r->second] << "\n";
+        }
+    }
 }
 
 
@@ -131,13 +287,30 @@ void code_generator::prologue(symbol *new_env)
 void code_generator::epilogue(symbol *old_env)
 {
     if (assembler_trace) {
-        out << "\t" << "# EPILOGUE (" << short_symbols << old_env << long_symbols << ")" << endl;
+        out << "\t" << "# EPILOGUE (" << short_symbols << old_env << long_symbols << ")" << "\n";
     }
 
     /* Your code here */
-    out << "\t\t" << "leave" << endl;
-    out << "\t\t" << "ret" << endl;
-    out << flush;
+    for (int i = saved_registers.size() - 1; i >= 0; i--) {
+        out << "\t\t" << "pop" << "\t" << reg[saved_registers[i]] << "\n";
+    }
+    if (!leaf) {
+        out << "\t\t" << "leave" << "\n";
+    }
+    out << "\t\t" << "ret" << "\n";
+
+    // The real constants used with SSE.
+    if (!constants.empty()) {
+        out << "\t\t" << ".section" << "\t" << ".rodata" << "\n";
+        out << "\t\t" << ".align" << "\t" << STACK_WIDTH << "\n";
+        map<long, int>::iterator c;
+        for (c = constants.begin(); c != constants.end(); c++) {
+            out << "L" << c->second << ":" << "\n";
+            out << "\t\t" << ".quad" << "\t" << c->first << "\n";
+        }
+        out << "\t\t" << ".text" << "\n";
+        constants.clear();
+    }
 }
 
 
@@ -153,12 +326,22 @@ void code_generator::find(sym_index sym_p, int *level, int *offset)
 
 	switch(sym->tag){
 	case SYM_PARAM:
-		//out << "symparam" << endl;
-		*offset = STACK_WIDTH + sym->get_parameter_symbol()->offset + sym->get_parameter_symbol()->size;
+		//out << "symparam" << "\n";
+		*offset = parameter_offset(sym->get_parameter_symbol());
 		break;
 	case SYM_CONST:
 	case SYM_ARRAY:
 	case SYM_VAR:
+		if (leaf && sym->level == frame_level) {
+			// Right below RSP.
+			*offset = -(STACK_WIDTH + sym->offset);
+			break;
+		}
+		if (static_links) {
+			// Below the old RBP and the static link.
+			*offset = -(2 * STACK_WIDTH + sym->offset);
+			break;
+		}
 		*offset = -(( (sym->level + 1) * STACK_WIDTH) + sym->offset);
 		break;
 	default:
@@ -166,6 +349,18 @@ void code_generator::find(sym_index sym_p, int *level, int *offset)
 	}
 }
 
+/* This function returns the offset of a parameter from the frame of its
+   procedure, or from RSP if the current procedure has no frame, when it is
+   above the return address and the callee saved registers pushed. */
+int code_generator::parameter_offset(parameter_symbol *param)
+{
+	if (leaf && param->level == frame_level) {
+		return STACK_WIDTH * saved_registers.size() + param->offset
+			+ param->size;
+	}
+	return STACK_WIDTH + param->offset + param->size;
+}
+
 /*
  * Generates code for getting the address of a frame for the specified scope level.
  */
@@ -173,9 +368,40 @@ void code_generator::frame_address(int level, const register_type dest)
 {
 	debug("frame_address");
     /* Your code here */
+	if (static_links) {
+		// Follow the static links out from the current frame.
+		if (level == frame_level) {
+			out << "\t\t" << "mov" << "\t" << reg[dest] << ", rbp\n";
+		}
+		for (int l = frame_level; l > level; l--) {
+			out << "\t\t" << "mov" << "\t" << reg[dest] << ", [" << (l == frame_level ? "rbp" : reg[dest]) << "-" << STACK_WIDTH << "]\n";
+		}
+		return;
+	}
 	out << "\t\t" << "mov" << "\t" << reg[dest] << ", [rbp-" << (level)*STACK_WIDTH << "]\n";
 }
 
+/* Returns the register to address the variables of a scope level off. At
+   optimization level 0 the address of the frame is always loaded into RCX
+   from the display. From level 1 the current frame is addressed off RBP
+   directly, or RSP if there is none, and the outer frame loaded last is kept
+   in R11 until the next label or call. */
+string code_generator::frame_register(int level)
+{
+	if (!cache_frames) {
+		frame_address(level, RCX);
+		return reg[RCX];
+	}
+	if (level == frame_level) {
+		return leaf ? "rsp" : "rbp";
+	}
+	if (level != cached_level) {
+		frame_address(level, R11);
+		cached_level = level;
+	}
+	return reg[R11];
+}
+
 /* This function fetches the value of a variable or a constant into a
    register. */
 void code_generator::fetch(sym_index sym_p, register_type dest)
@@ -186,21 +412,28 @@ void code_generator::fetch(sym_index sym_p, register_type dest)
 	if(sym == NULL) return;
 	int level = 0;
 	int offset = 0;
+	string base;
+
+	if (registers.find(sym_p) != registers.end()) {
+		register_type src = registers[sym_p];
+		out << "\t\t" << (src >= XMM0 ? "movq" : "mov") << "\t" << reg[dest] << ", " << reg[src] << "\n";
+		return;
+	}
 
 	switch(sym->tag){
 	case SYM_ARRAY:
 	case SYM_VAR:
 		find(sym_p, &level, &offset);
-		frame_address(level, RCX);
-		out << "\t\t" << "mov" << "\t" << reg[dest] << ", [rcx" << offset << "]\n";
+		base = frame_register(level);
+		out << "\t\t" << "mov" << "\t" << reg[dest] << ", [" << base << offset << "]\n";
 		break;
 	case SYM_CONST:
 		out << "\t\t" << "mov" << "\t" << reg[dest] << ", " << sym->get_constant_symbol()->const_value.ival << "\n";
 		break;
 	case SYM_PARAM:
 		find(sym_p, &level, &offset);
-		frame_address(level, RCX);
-		out << "\t\t" << "mov" << "\t" << reg[dest] << ", [rcx+" << offset << "]" << "\n";
+		base = frame_register(level);
+		out << "\t\t" << "mov" << "\t" << reg[dest] << ", [" << base << "+" << offset << "]" << "\n";
 		break;
 	default:
 		break;
@@ -217,7 +450,7 @@ void code_generator::fetch_float(sym_index sym_p)
 	int offset=0;
 
 	find(sym_p, &level, &offset);
-	frame_address(level, RCX);
+	string base = frame_register(level);
 	symbol* sym = sym_tab->get_symbol(sym_p);
 	//out << "\t\t" << "fld" << "\t" << "[rcx" << offset << "]\n";
 
@@ -226,13 +459,13 @@ void code_generator::fetch_float(sym_index sym_p)
 		case SYM_ARRAY:
 		case SYM_VAR:
 			if(offset > 0){
-				out << "\t\t" << "fld" << "\t" << "qword ptr [" << reg[RCX] << "+" << offset << "]\n";
+				out << "\t\t" << "fld" << "\t" << "qword ptr [" << base << "+" << offset << "]\n";
 			} else{
-				out << "\t\t" << "fld" << "\t" << "qword ptr [" << reg[RCX] << offset << "]\n";
+				out << "\t\t" << "fld" << "\t" << "qword ptr [" << base << offset << "]\n";
 			}
 			break;
 		case SYM_CONST:
-			out << "\t\t" << "mov" << "\t" << "rcx, " << sym_tab->ieee(sym->get_constant_symbol()->const_value.rval) << endl;
+			out << "\t\t" << "mov" << "\t" << "rcx, " << sym_tab->ieee(sym->get_constant_symbol()->const_value.rval) << "\n";
 			out << "\t\t" << "push" << "\t" << "rcx" << "\n";
 			out << "\t\t" << "fld" << "\t" << "qword ptr [" << "rsp" << "]\n";
 			out << "\t\t" << "add" << "\t" << "rsp, " << STACK_WIDTH << "\n";
@@ -249,19 +482,26 @@ void code_generator::store(register_type src, sym_index sym_p)
     /* Your code here */
 	int offset = 0;
 	int level = 0;
+	string base;
+
+	if (registers.find(sym_p) != registers.end()) {
+		register_type dest = registers[sym_p];
+		out << "\t\t" << (dest >= XMM0 ? "movq" : "mov") << "\t" << reg[dest] << ", " << reg[src] << "\n";
+		return;
+	}
 	find(sym_p, &level, &offset);
 
 	symbol* sym = sym_tab->get_symbol(sym_p);
 
 	switch(sym->tag){
 	case SYM_PARAM:
-		frame_address(level, RCX);
-		out << "\t\t" << "mov" << "\t[" << reg[RCX] << "+" << offset << "], " << reg[src] << "\n";
+		base = frame_register(level);
+		out << "\t\t" << "mov" << "\t[" << base << "+" << offset << "], " << reg[src] << "\n";
 		break;
 	case SYM_ARRAY:
 	case SYM_VAR:
-		frame_address(level, RCX);
-		out << "\t\t" << "mov" << "\t[" << reg[RCX] << offset << "], " << reg[src] << "\n";
+		base = frame_register(level);
+		out << "\t\t" << "mov" << "\t[" << base << offset << "], " << reg[src] << "\n";
 		break;
 	default:
 		break;
@@ -277,28 +517,342 @@ void code_generator::store_float(sym_index sym_p)
 	int offset = 0;
 	int level = 0;
 	find(sym_p, &level, &offset);
-	frame_address(level, RCX);
+	string base = frame_register(level);
 	//out << "\t\t" << "fstp" << "\t[" << reg[RCX] << offset << "]" << "\n";
-	out << "\t\t" << "fstp" << "\t" << "qword ptr [" << reg[RCX] << offset << "]\n";
+	// Parameters have positive offsets. They are only ever stored into
+	// directly when the quad optimizer has removed an assignment.
+	if (offset > 0) {
+		out << "\t\t" << "fstp" << "\t" << "qword ptr [" << base << "+" << offset << "]\n";
+	} else {
+		out << "\t\t" << "fstp" << "\t" << "qword ptr [" << base << offset << "]\n";
+	}
 }
 
 
+/* Returns the label of a real constant, given by its ieee bit pattern, in
+   the read-only data section after the procedure. */
+int code_generator::constant_label(long bits)
+{
+	if (constants.find(bits) == constants.end()) {
+		constants[bits] = sym_tab->get_next_label();
+	}
+	return constants[bits];
+}
+
+/* This function loads a real into an XMM register. Constants are loaded
+   from the read-only data section after the procedure. */
+void code_generator::fetch_sse(sym_index sym_p, const register_type dest)
+{
+	symbol *sym = sym_tab->get_symbol(sym_p);
+	int level = 0;
+	int offset = 0;
+	string base;
+
+	if (registers.find(sym_p) != registers.end()) {
+		register_type src = registers[sym_p];
+		out << "\t\t" << (src >= XMM0 ? "movapd" : "movq") << "\t" << reg[dest] << ", " << reg[src] << "\n";
+		return;
+	}
+
+	switch (sym->tag) {
+	case SYM_CONST:
+		out << "\t\t" << "movsd" << "\t" << reg[dest] << ", qword ptr [rip+L" << constant_label(sym_tab->ieee(sym->get_constant_symbol()->const_value.rval)) << "]\n";
+		break;
+	case SYM_PARAM:
+	case SYM_VAR:
+		find(sym_p, &level, &offset);
+		base = frame_register(level);
+		out << "\t\t" << "movsd" << "\t" << reg[dest] << ", qword ptr [" << base << (offset > 0 ? "+" : "") << offset << "]\n";
+		break;
+	default:
+		break;
+	}
+}
+
+/* This function stores an XMM register into a real variable. */
+void code_generator::store_sse(const register_type src, sym_index sym_p)
+{
+	int level = 0;
+	int offset = 0;
+
+	if (registers.find(sym_p) != registers.end()) {
+		register_type dest = registers[sym_p];
+		out << "\t\t" << (dest >= XMM0 ? "movapd" : "movq") << "\t" << reg[dest] << ", " << reg[src] << "\n";
+		return;
+	}
+
+	find(sym_p, &level, &offset);
+	string base = frame_register(level);
+	out << "\t\t" << "movsd" << "\t" << "qword ptr [" << base << (offset > 0 ? "+" : "") << offset << "], " << reg[src] << "\n";
+}
+
+/* This function generates real addition, subtraction, multiplication or
+   division, with the x87 instruction popping the FPU stack or the SSE one
+   given. */
+void code_generator::float_arithmetic(quadruple *q, const string x87_op,
+                                      const string sse_op)
+{
+    if (sse) {
+        fetch_sse(q->sym1, XMM0);
+        fetch_sse(q->sym2, XMM1);
+        out << "\t\t" << sse_op << "\t" << "xmm0, xmm1" << "\n";
+        store_sse(XMM0, q->sym3);
+        return;
+    }
+    fetch_float(q->sym1);
+    fetch_float(q->sym2);
+    out << "\t\t" << x87_op << "\n";
+    store_float(q->sym3);
+}
+
+/* This function compares the first real to the second. fcomip and ucomisd
+   both set ZF, PF and CF like an unsigned compare would, and all three if
+   either one is a NaN. */
+void code_generator::compare_float(sym_index left, sym_index right)
+{
+    if (sse) {
+        fetch_sse(left, XMM0);
+        fetch_sse(right, XMM1);
+        out << "\t\t" << "ucomisd" << "\t" << "xmm0, xmm1" << "\n";
+        return;
+    }
+    fetch_float(right);
+    fetch_float(left);
+    out << "\t\t" << "fcomip" << "\t" << "ST(0), ST(1)" << "\n";
+    // Clear the stack
+    out << "\t\t" << "fstp" << "\t" << "ST(0)" << "\n";
+}
+
 /* This function fetches the base address of an array. */
 void code_generator::array_address(sym_index sym_p, register_type dest)
 {
 	debug("array_address");
-	symbol* sym = sym_tab->get_symbol(sym_p);
     /* Your code here */
 	int level = 0;
 	int offset = 0;
 
 	find(sym_p, &level, &offset);
+	if (cache_frames) {
+		string base = frame_register(level);
+		out << "\t\t" << "lea" << "\t" << reg[dest] << ", [" << base << offset << "]\n";
+		return;
+	}
 	frame_address(level, RCX);
 
-	out << "\t\t" << "sub" << "\t" << reg[RCX] << ", " << ((sym->level + 1) * STACK_WIDTH + sym->offset) << "\n";
+	out << "\t\t" << "sub" << "\t" << reg[RCX] << ", " << -offset << "\n";
 	out << "\t\t" << "mov" << "\t" << reg[dest] << ", " << reg[RCX] << "\n";
 }
 
+/* Computes the magic number and shift used to divide by the constant d
+ (2 <= |d| < 2^63) with a multiplication, see Hacker's Delight, chapter 10.
+ The high 64 bits of magic * n, corrected by +n or -n when the sign of
+ magic differs from that of d, shifted right arithmetically by shift and
+ incremented when negative, equal n / d rounded towards zero. */
+static void signed_magic(long d, long *magic, int *shift)
+{
+    const unsigned long two63 = 1UL << 63;
+    unsigned long ad = d < 0 ? -(unsigned long)d : d;
+    unsigned long t = two63 + ((unsigned long)d >> 63);
+    unsigned long anc = t - 1 - t % ad;
+    unsigned long q1 = two63 / anc;
+    unsigned long r1 = two63 - q1 * anc;
+    unsigned long q2 = two63 / ad;
+    unsigned long r2 = two63 - q2 * ad;
+    unsigned long delta;
+    int p = 63;
+
+    do {
+        p++;
+        q1 = 2 * q1;
+        r1 = 2 * r1;
+        if (r1 >= anc) {
+            q1++;
+            r1 -= anc;
+        }
+        q2 = 2 * q2;
+        r2 = 2 * r2;
+        if (r2 >= ad) {
+            q2++;
+            r2 -= ad;
+        }
+        delta = ad - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+
+    *magic = (long)(q2 + 1);
+    if (d < 0) {
+        *magic = -*magic;
+    }
+    *shift = p - 64;
+}
+
+/* Returns the register an argument is passed in to the procedures of the
+   program from optimization level 2, or NR_REGISTERS if it is passed on the
+   stack. The integer arguments take those of the caller saved registers the
+   register allocator hands out in turn, and the reals XMM0 to XMM7. The run-
+   time support on level 0 always takes its arguments on the stack. */
+register_type parameter_register(parameter_symbol *param)
+{
+    static const register_type integer_registers[] = { RDI, RSI, R8, R9,
+                                                       R10 };
+    bool real = param->type == real_type;
+    int index = 0;
+
+    for (parameter_symbol *p = param->preceding; p != NULL; p = p->preceding) {
+        if ((p->type == real_type) == real) {
+            index++;
+        }
+    }
+    if (real) {
+        return index < 8 ? register_type(XMM0 + index) : NR_REGISTERS;
+    }
+    return index < 5 ? integer_registers[index] : NR_REGISTERS;
+}
+
+/* This function copies a register into another one. */
+void code_generator::move_register(const register_type dest,
+                                   const register_type src)
+{
+    string op = dest < XMM0 && src < XMM0 ? "mov"
+        : dest >= XMM0 && src >= XMM0 ? "movapd" : "movq";
+    out << "\t\t" << op << "\t" << reg[dest] << ", " << reg[src] << "\n";
+}
+
+/* This function makes register moves, given as destination and source, as
+   if they were made at once: no register is written before all moves
+   reading it are done. When the rest of the moves all wait for each other,
+   one of the registers they read is set aside in RAX. */
+void code_generator::move_registers(vector<pair<register_type,
+                                    register_type> > moves)
+{
+    while (!moves.empty()) {
+        unsigned int m;
+        for (m = 0; m < moves.size(); m++) {
+            bool read = false;
+            for (unsigned int o = 0; o < moves.size(); o++) {
+                if (o != m && moves[o].second == moves[m].first) {
+                    read = true;
+                }
+            }
+            if (!read) {
+                break;
+            }
+        }
+        if (m == moves.size()) {
+            register_type blocked = moves[0].first;
+            move_register(RAX, blocked);
+            for (unsigned int o = 0; o < moves.size(); o++) {
+                if (moves[o].second == blocked) {
+                    moves[o].second = RAX;
+                }
+            }
+            m = 0;
+        }
+        if (moves[m].first != moves[m].second) {
+            move_register(moves[m].first, moves[m].second);
+        }
+        moves.erase(moves.begin() + m);
+    }
+}
+
+/* This function finds the call each parameter of a quad list is passed to
+   and the formal parameter it is passed as, if it is passed in a register.
+   The register arguments of a call are loaded right before it, unless the
+   variables they are read from may change first, by a call or an assignment
+   while the arguments before them are computed. Those are pushed like all
+   arguments of the run-time support, and loaded from the stack. Either way
+   all arguments have a slot on the stack where the called procedure finds
+   those it doesn't keep in registers. */
+void code_generator::find_arguments(quad_list *q_list)
+{
+    int n = q_list->size();
+
+    quad_parameters(q_list, argument_call);
+    argument_formal.assign(n, NULL);
+    argument_position.assign(n, 0);
+    arguments_deferred.assign(n, true);
+    reserved_arguments = 0;
+
+    for (int c = 0; c < n; c++) {
+        quadruple call = q_list->get(c);
+        if (call.op_code != q_call) {
+            continue;
+        }
+        symbol *sym = sym_tab->get_symbol(call.sym1);
+        parameter_symbol *formal = sym->tag == SYM_FUNC
+            ? sym->get_function_symbol()->last_parameter
+            : sym->get_procedure_symbol()->last_parameter;
+        int position = call.int2;
+        int first = c;
+
+        // The parameters come last argument first, as the formals are
+        // linked.
+        for (int p = 0; p < c; p++) {
+            if (argument_call[p] != c) {
+                continue;
+            }
+            argument_position[p] = --position;
+            if (register_parameters && sym->level > 0
+                && parameter_register(formal) != NR_REGISTERS) {
+                argument_formal[p] = formal;
+                first = min(first, p);
+            }
+            formal = formal->preceding;
+        }
+        for (int p = first; p < c; p++) {
+            if (argument_formal[p] == NULL || argument_call[p] != c) {
+                continue;
+            }
+            for (int i = p + 1; i < c; i++) {
+                quadruple q = q_list->get(i);
+                if (q.op_code == q_call || (quad_assigns(q.op_code)
+                                            && q.sym3 == q_list->get(p).sym1)) {
+                    arguments_deferred[c] = false;
+                }
+            }
+        }
+    }
+}
+
+/* This function loads the register arguments of the call at an index of a
+   quad list, see find_arguments(). Deferred arguments in registers are moved
+   first, as loading the others doesn't change any register they are in. */
+void code_generator::pass_arguments(quad_list *q_list, int c)
+{
+    vector<pair<register_type, register_type> > moves;
+    vector<int> loads;
+
+    if (arguments_deferred[c] && reserved_arguments > 0) {
+        out << "\t\t" << "sub" << "\t" << "rsp, "
+            << STACK_WIDTH * reserved_arguments << "\n";
+        reserved_arguments = 0;
+    }
+    for (int p = 0; p < c; p++) {
+        if (argument_call[p] != c || argument_formal[p] == NULL) {
+            continue;
+        }
+        register_type r = parameter_register(argument_formal[p]);
+        sym_index sym_p = q_list->get(p).sym1;
+        if (!arguments_deferred[c]) {
+            out << "\t\t" << (r >= XMM0 ? "movsd" : "mov") << "\t" << reg[r]
+                << ", " << (r >= XMM0 ? "qword ptr " : "") << "[rsp+"
+                << STACK_WIDTH * argument_position[p] << "]\n";
+        } else if (registers.find(sym_p) != registers.end()) {
+            moves.push_back(make_pair(r, registers[sym_p]));
+        } else {
+            loads.push_back(p);
+        }
+    }
+    move_registers(moves);
+    for (unsigned int l = 0; l < loads.size(); l++) {
+        register_type r = parameter_register(argument_formal[loads[l]]);
+        if (r >= XMM0) {
+            fetch_sse(q_list->get(loads[l]).sym1, r);
+        } else {
+            fetch(q_list->get(loads[l]).sym1, r);
+        }
+    }
+}
+
 /* This method expands a quad_list into assembler code, quad for quad. */
 void code_generator::expand(quad_list *q_list)
 {
@@ -311,18 +865,22 @@ void code_generator::expand(quad_list *q_list)
 
     quadruple *q = ql_iterator->get_current(); // This is the head of the list.
 
+    find_arguments(q_list);
+
     while (q != NULL) {
         quad_nr++;
 
         // We always do labels here so that a branch doesn't miss the
         // trace code.
         if (q->op_code == q_labl) {
-            out << "L" << q->int1 << ":" << endl;
+            out << "L" << q->int1 << ":" << "\n";
+            // Control may come here with another frame in R11.
+            cached_level = -1;
         }
 
         // Debug output.
         if (assembler_trace) {
-            out << "\t" << "# QUAD " << quad_nr << ": " << short_symbols << q << long_symbols << endl;
+            out << "\t" << "# QUAD " << quad_nr << ": " << short_symbols << q << long_symbols << "\n";
         }
 
         // The main switch on quad type. This is where code is actually
@@ -330,8 +888,15 @@ void code_generator::expand(quad_list *q_list)
         switch (q->op_code) {
         case q_rload:
         	debug("q_rload");
+            if (sse && registers.find(q->sym3) != registers.end()
+                && registers[q->sym3] >= XMM0) {
+                out << "\t\t" << "movsd" << "\t" << reg[registers[q->sym3]]
+                    << ", qword ptr [rip+L" << constant_label(q->int1) << "]"
+                    << "\n";
+                break;
+            }
         case q_iload:
-            out << "\t\t" << "mov" << "\t" << "rax, " << q->int1 << endl;
+            out << "\t\t" << "mov" << "\t" << "rax, " << q->int1 << "\n";
             store(RAX, q->sym3);
             break;
 
@@ -340,56 +905,58 @@ void code_generator::expand(quad_list *q_list)
             int label2 = sym_tab->get_next_label();
 
             fetch(q->sym1, RAX);
-            out << "\t\t" << "cmp" << "\t" << "rax, 0" << endl;
-            out << "\t\t" << "je" << "\t" << "L" << label << endl;
+            out << "\t\t" << "cmp" << "\t" << "rax, 0" << "\n";
+            out << "\t\t" << "je" << "\t" << "L" << label << "\n";
             // Not equal branch
-            out << "\t\t" << "mov" << "\t" << "rax, 0" << endl;
-            out << "\t\t" << "jmp" << "\t" << "L" << label2 << endl;
+            out << "\t\t" << "mov" << "\t" << "rax, 0" << "\n";
+            out << "\t\t" << "jmp" << "\t" << "L" << label2 << "\n";
             // Equal branch
-            out << "\t\t" << "L" << label << ":" << endl;
-            out << "\t\t" << "mov" << "\t" << "rax, 1" << endl;
+            out << "\t\t" << "L" << label << ":" << "\n";
+            out << "\t\t" << "mov" << "\t" << "rax, 1" << "\n";
 
-            out << "\t\t" << "L" << label2 << ":" <<  endl;
+            out << "\t\t" << "L" << label2 << ":" << "\n";
             store(RAX, q->sym3);
             break;
         }
         case q_ruminus:
+            if (sse) {
+                // Flip the sign bit.
+                fetch_sse(q->sym1, XMM0);
+                out << "\t\t" << "movq" << "\t" << "rax, xmm0" << "\n";
+                out << "\t\t" << "btc" << "\t" << "rax, 63" << "\n";
+                store(RAX, q->sym3);
+                break;
+            }
             fetch_float(q->sym1);
-            out << "\t\t" << "fchs" << endl;
+            out << "\t\t" << "fchs" << "\n";
             store_float(q->sym3);
             break;
 
         case q_iuminus:
             fetch(q->sym1, RAX);
-            out << "\t\t" << "neg" << "\t" << "rax" << endl;
+            out << "\t\t" << "neg" << "\t" << "rax" << "\n";
             store(RAX, q->sym3);
             break;
 
         case q_rplus:
-            fetch_float(q->sym1);
-            fetch_float(q->sym2);
-            out << "\t\t" << "faddp" << endl;
-            store_float(q->sym3);
+            float_arithmetic(q, "faddp", "addsd");
             break;
 
         case q_iplus:
             fetch(q->sym1, RAX);
             fetch(q->sym2, RCX);
-            out << "\t\t" << "add" << "\t" << "rax, rcx" << endl;
+            out << "\t\t" << "add" << "\t" << "rax, rcx" << "\n";
             store(RAX, q->sym3);
             break;
 
         case q_rminus:
-            fetch_float(q->sym1);
-            fetch_float(q->sym2);
-            out << "\t\t" << "fsubp" << endl;
-            store_float(q->sym3);
+            float_arithmetic(q, "fsubp", "subsd");
             break;
 
         case q_iminus:
             fetch(q->sym1, RAX);
             fetch(q->sym2, RCX);
-            out << "\t\t" << "sub" << "\t" << "rax, rcx" << endl;
+            out << "\t\t" << "sub" << "\t" << "rax, rcx" << "\n";
             store(RAX, q->sym3);
             break;
 
@@ -398,19 +965,21 @@ void code_generator::expand(quad_list *q_list)
             int label2 = sym_tab->get_next_label();
 
             fetch(q->sym1, RAX);
-            out << "\t\t" << "cmp" << "\t" << "rax, 0" << endl;
-            out << "\t\t" << "jne" << "\t" << "L" << label << endl;
+            out << "\t\t" << "cmp" << "\t" << "rax, 0" << "\n";
+            out << "\t\t" << "jne" << "\t" << "L" << label << "\n";
             fetch(q->sym2, RAX);
-            out << "\t\t" << "cmp" << "\t" << "rax, 0" << endl;
-            out << "\t\t" << "jne" << "\t" << "L" << label << endl;
+            out << "\t\t" << "cmp" << "\t" << "rax, 0" << "\n";
+            out << "\t\t" << "jne" << "\t" << "L" << label << "\n";
+            // The second fetch may be skipped, and R11 with it.
+            cached_level = -1;
             // False branch
-            out << "\t\t" << "mov" << "\t" << "rax, 0" << endl;
-            out << "\t\t" << "jmp" << "\t" << "L" << label2 << endl;
+            out << "\t\t" << "mov" << "\t" << "rax, 0" << "\n";
+            out << "\t\t" << "jmp" << "\t" << "L" << label2 << "\n";
             // True branch
-            out << "\t\t" << "L" << label << ":" << endl;
-            out << "\t\t" << "mov" << "\t" << "rax, 1" << endl;
+            out << "\t\t" << "L" << label << ":" << "\n";
+            out << "\t\t" << "mov" << "\t" << "rax, 1" << "\n";
 
-            out << "\t\t" << "L" << label2 << ":" << endl;
+            out << "\t\t" << "L" << label2 << ":" << "\n";
             store(RAX, q->sym3);
             break;
         }
@@ -419,77 +988,140 @@ void code_generator::expand(quad_list *q_list)
             int label2 = sym_tab->get_next_label();
 
             fetch(q->sym1, RAX);
-            out << "\t\t" << "cmp" << "\t" << "rax, 0" << endl;
-            out << "\t\t" << "je" << "\t" << "L" << label << endl;
+            out << "\t\t" << "cmp" << "\t" << "rax, 0" << "\n";
+            out << "\t\t" << "je" << "\t" << "L" << label << "\n";
             fetch(q->sym2, RAX);
-            out << "\t\t" << "cmp" << "\t" << "rax, 0" << endl;
-            out << "\t\t" << "je" << "\t" << "L" << label << endl;
+            out << "\t\t" << "cmp" << "\t" << "rax, 0" << "\n";
+            out << "\t\t" << "je" << "\t" << "L" << label << "\n";
+            // The second fetch may be skipped, and R11 with it.
+            cached_level = -1;
             // True branch
-            out << "\t\t" << "mov" << "\t" << "rax, 1" << endl;
-            out << "\t\t" << "jmp" << "\t" << "L" << label2 << endl;
+            out << "\t\t" << "mov" << "\t" << "rax, 1" << "\n";
+            out << "\t\t" << "jmp" << "\t" << "L" << label2 << "\n";
             // False branch
-            out << "\t\t" << "L" << label << ":" << endl;
-            out << "\t\t" << "mov" << "\t" << "rax, 0" << endl;
+            out << "\t\t" << "L" << label << ":" << "\n";
+            out << "\t\t" << "mov" << "\t" << "rax, 0" << "\n";
 
-            out << "\t\t" << "L" << label2 << ":" << endl;
+            out << "\t\t" << "L" << label2 << ":" << "\n";
             store(RAX, q->sym3);
             break;
         }
         case q_rmult:
-            fetch_float(q->sym1);
-            fetch_float(q->sym2);
-            out << "\t\t" << "fmulp" << endl;
-            store_float(q->sym3);
+            float_arithmetic(q, "fmulp", "mulsd");
             break;
 
         case q_imult:
             fetch(q->sym1, RAX);
             fetch(q->sym2, RCX);
-            out << "\t\t" << "imul" << "\t" << "rax, rcx" << endl;
+            out << "\t\t" << "imul" << "\t" << "rax, rcx" << "\n";
             store(RAX, q->sym3);
             break;
 
         case q_rdivide:
-            fetch_float(q->sym1);
-            fetch_float(q->sym2);
-            out << "\t\t" << "fdivp" << endl;
-            store_float(q->sym3);
+            float_arithmetic(q, "fdivp", "divsd");
             break;
 
         case q_idivide:
             fetch(q->sym1, RAX);
             fetch(q->sym2, RCX);
-            out << "\t\t" << "cqo" << endl;
-            out << "\t\t" << "idiv" << "\t" << "rax, rcx" << endl;
+            out << "\t\t" << "cqo" << "\n";
+            out << "\t\t" << "idiv" << "\t" << "rax, rcx" << "\n";
             store(RAX, q->sym3);
             break;
 
         case q_imod:
             fetch(q->sym1, RAX);
             fetch(q->sym2, RCX);
-            out << "\t\t" << "cqo" << endl;
-            out << "\t\t" << "idiv" << "\t" << "rax, rcx" << endl;
+            out << "\t\t" << "cqo" << "\n";
+            out << "\t\t" << "idiv" << "\t" << "rax, rcx" << "\n";
             store(RDX, q->sym3);
             break;
 
+        case q_ishl:
+            fetch(q->sym1, RAX);
+            out << "\t\t" << "shl" << "\t" << "rax, " << q->int2 << "\n";
+            store(RAX, q->sym3);
+            break;
+
+        case q_ishr:
+        case q_imask:
+            // Add 2^k - 1 to negative dividends so that the result is
+            // rounded towards zero, like idiv does. RCX gets the bias.
+            fetch(q->sym1, RAX);
+            out << "\t\t" << "mov" << "\t" << "rcx, rax" << "\n";
+            if (q->int2 > 1) {
+                out << "\t\t" << "sar" << "\t" << "rcx, 63" << "\n";
+            }
+            out << "\t\t" << "shr" << "\t" << "rcx, " << 64 - q->int2
+                << "\n";
+            if (q->op_code == q_ishr) {
+                out << "\t\t" << "add" << "\t" << "rax, rcx" << "\n";
+                out << "\t\t" << "sar" << "\t" << "rax, " << q->int2 << "\n";
+            } else {
+                // x mod 2^k = x - ((x + bias) and -2^k).
+                out << "\t\t" << "add" << "\t" << "rcx, rax" << "\n";
+                out << "\t\t" << "mov" << "\t" << "rdx, " << -(1L << q->int2)
+                    << "\n";
+                out << "\t\t" << "and" << "\t" << "rcx, rdx" << "\n";
+                out << "\t\t" << "sub" << "\t" << "rax, rcx" << "\n";
+            }
+            store(RAX, q->sym3);
+            break;
+
+        case q_idivc:
+        case q_imodc: {
+            long magic;
+            int shift;
+
+            signed_magic(q->int2, &magic, &shift);
+            // The dividend stays in RCX, the quotient ends up in RDX.
+            fetch(q->sym1, RCX);
+            out << "\t\t" << "mov" << "\t" << "rax, " << magic << "\n";
+            out << "\t\t" << "imul" << "\t" << "rcx" << "\n";
+            if (q->int2 > 0 && magic < 0) {
+                out << "\t\t" << "add" << "\t" << "rdx, rcx" << "\n";
+            } else if (q->int2 < 0 && magic > 0) {
+                out << "\t\t" << "sub" << "\t" << "rdx, rcx" << "\n";
+            }
+            if (shift > 0) {
+                out << "\t\t" << "sar" << "\t" << "rdx, " << shift << "\n";
+            }
+            out << "\t\t" << "mov" << "\t" << "rax, rdx" << "\n";
+            out << "\t\t" << "shr" << "\t" << "rax, 63" << "\n";
+            out << "\t\t" << "add" << "\t" << "rdx, rax" << "\n";
+            if (q->op_code == q_idivc) {
+                out << "\t\t" << "mov" << "\t" << "rax, rdx" << "\n";
+            } else {
+                // n mod d = n - (n div d) * d.
+                if (q->int2 >= INT32_MIN && q->int2 <= INT32_MAX) {
+                    out << "\t\t" << "imul" << "\t" << "rdx, rdx, " << q->int2
+                        << "\n";
+                } else {
+                    out << "\t\t" << "mov" << "\t" << "rax, " << q->int2
+                        << "\n";
+                    out << "\t\t" << "imul" << "\t" << "rdx, rax" << "\n";
+                }
+                out << "\t\t" << "mov" << "\t" << "rax, rcx" << "\n";
+                out << "\t\t" << "sub" << "\t" << "rax, rdx" << "\n";
+            }
+            store(RAX, q->sym3);
+            break;
+        }
+
         case q_req: {
             int label = sym_tab->get_next_label();
             int label2 = sym_tab->get_next_label();
 
-            fetch_float(q->sym1);
-            fetch_float(q->sym2);
-            out << "\t\t" << "fcomip" << "\t" << "ST(0), ST(1)" << endl;
-            // Clear the stack
-            out << "\t\t" << "fstp" << "\t" << "ST(0)" << endl;
-            out << "\t\t" << "je" << "\t" << "L" << label << endl;
+            compare_float(q->sym2, q->sym1);
+            out << "\t\t" << "je" << "\t" << "L" << label << "\n";
             // False branch
-            out << "\t\t" << "mov" << "\t" << "rax, 0" << endl;
-            out << "\t\t" << "jmp" << "\t" << "L" << label2 << endl;
+            out << "\t\t" << "mov" << "\t" << "rax, 0" << "\n";
+            out << "\t\t" << "jmp" << "\t" << "L" << label2 << "\n";
             // True branch
-            out << "\t\t" << "L" << label << ":" << endl;
-            out << "\t\t" << "mov" << "\t" << "rax, 1" << endl;
+            out << "\t\t" << "L" << label << ":" << "\n";
+            out << "\t\t" << "mov" << "\t" << "rax, 1" << "\n";
 
-            out << "\t\t" << "L" << label2 << ":" << endl;
+            out << "\t\t" << "L" << label2 << ":" << "\n";
             store(RAX, q->sym3);
             break;
         }
@@ -499,16 +1131,16 @@ void code_generator::expand(quad_list *q_list)
 
             fetch(q->sym1, RAX);
             fetch(q->sym2, RCX);
-            out << "\t\t" << "cmp" << "\t" << "rax, rcx" << endl;
-            out << "\t\t" << "je" << "\t" << "L" << label << endl;
+            out << "\t\t" << "cmp" << "\t" << "rax, rcx" << "\n";
+            out << "\t\t" << "je" << "\t" << "L" << label << "\n";
             // False branch
-            out << "\t\t" << "mov" << "\t" << "rax, 0" << endl;
-            out << "\t\t" << "jmp" << "\t" << "L" << label2 << endl;
+            out << "\t\t" << "mov" << "\t" << "rax, 0" << "\n";
+            out << "\t\t" << "jmp" << "\t" << "L" << label2 << "\n";
             // True branch
-            out << "\t\t" << "L" << label << ":" << endl;
-            out << "\t\t" << "mov" << "\t" << "rax, 1" << endl;
+            out << "\t\t" << "L" << label << ":" << "\n";
+            out << "\t\t" << "mov" << "\t" << "rax, 1" << "\n";
 
-            out << "\t\t" << "L" << label2 << ":" << endl;
+            out << "\t\t" << "L" << label2 << ":" << "\n";
             store(RAX, q->sym3);
             break;
         }
@@ -516,20 +1148,16 @@ void code_generator::expand(quad_list *q_list)
             int label = sym_tab->get_next_label();
             int label2 = sym_tab->get_next_label();
 
-            fetch_float(q->sym1);
-            fetch_float(q->sym2);
-            out << "\t\t" << "fcomip" << "\t" << "ST(0), ST(1)" << endl;
-            // Clear the stack
-            out << "\t\t" << "fstp" << "\t" << "ST(0)" << endl;
-            out << "\t\t" << "jne" << "\t" << "L" << label << endl;
+            compare_float(q->sym2, q->sym1);
+            out << "\t\t" << "jne" << "\t" << "L" << label << "\n";
             // False branch
-            out << "\t\t" << "mov" << "\t" << "rax, 0" << endl;
-            out << "\t\t" << "jmp" << "\t" << "L" << label2 << endl;
+            out << "\t\t" << "mov" << "\t" << "rax, 0" << "\n";
+            out << "\t\t" << "jmp" << "\t" << "L" << label2 << "\n";
             // True branch
-            out << "\t\t" << "L" << label << ":" << endl;
-            out << "\t\t" << "mov" << "\t" << "rax, 1" << endl;
+            out << "\t\t" << "L" << label << ":" << "\n";
+            out << "\t\t" << "mov" << "\t" << "rax, 1" << "\n";
 
-            out << "\t\t" << "L" << label2 << ":" << endl;
+            out << "\t\t" << "L" << label2 << ":" << "\n";
             store(RAX, q->sym3);
             break;
         }
@@ -539,16 +1167,16 @@ void code_generator::expand(quad_list *q_list)
 
             fetch(q->sym1, RAX);
             fetch(q->sym2, RCX);
-            out << "\t\t" << "cmp" << "\t" << "rax, rcx" << endl;
-            out << "\t\t" << "jne" << "\t" << "L" << label << endl;
+            out << "\t\t" << "cmp" << "\t" << "rax, rcx" << "\n";
+            out << "\t\t" << "jne" << "\t" << "L" << label << "\n";
             // False branch
-            out << "\t\t" << "mov" << "\t" << "rax, 0" << endl;
-            out << "\t\t" << "jmp" << "\t" << "L" << label2 << endl;
+            out << "\t\t" << "mov" << "\t" << "rax, 0" << "\n";
+            out << "\t\t" << "jmp" << "\t" << "L" << label2 << "\n";
             // True branch
-            out << "\t\t" << "L" << label << ":" << endl;
-            out << "\t\t" << "mov" << "\t" << "rax, 1" << endl;
+            out << "\t\t" << "L" << label << ":" << "\n";
+            out << "\t\t" << "mov" << "\t" << "rax, 1" << "\n";
 
-            out << "\t\t" << "L" << label2 << ":" << endl;
+            out << "\t\t" << "L" << label2 << ":" << "\n";
             store(RAX, q->sym3);
             break;
         }
@@ -556,21 +1184,16 @@ void code_generator::expand(quad_list *q_list)
             int label = sym_tab->get_next_label();
             int label2 = sym_tab->get_next_label();
 
-            // We need to push in reverse order for this to work
-            fetch_float(q->sym2);
-            fetch_float(q->sym1);
-            out << "\t\t" << "fcomip" << "\t" << "ST(0), ST(1)" << endl;
-            // Clear the stack
-            out << "\t\t" << "fstp" << "\t" << "ST(0)" << endl;
-            out << "\t\t" << "jb" << "\t" << "L" << label << endl;
+            compare_float(q->sym1, q->sym2);
+            out << "\t\t" << "jb" << "\t" << "L" << label << "\n";
             // False branch
-            out << "\t\t" << "mov" << "\t" << "rax, 0" << endl;
-            out << "\t\t" << "jmp" << "\t" << "L" << label2 << endl;
+            out << "\t\t" << "mov" << "\t" << "rax, 0" << "\n";
+            out << "\t\t" << "jmp" << "\t" << "L" << label2 << "\n";
             // True branch
-            out << "\t\t" << "L" << label << ":" << endl;
-            out << "\t\t" << "mov" << "\t" << "rax, 1" << endl;
+            out << "\t\t" << "L" << label << ":" << "\n";
+            out << "\t\t" << "mov" << "\t" << "rax, 1" << "\n";
 
-            out << "\t\t" << "L" << label2 << ":" << endl;
+            out << "\t\t" << "L" << label2 << ":" << "\n";
             store(RAX, q->sym3);
             break;
         }
@@ -580,16 +1203,16 @@ void code_generator::expand(quad_list *q_list)
 
             fetch(q->sym1, RAX);
             fetch(q->sym2, RCX);
-            out << "\t\t" << "cmp" << "\t" << "rax, rcx" << endl;
-            out << "\t\t" << "jl" << "\t" << "L" << label << endl;
+            out << "\t\t" << "cmp" << "\t" << "rax, rcx" << "\n";
+            out << "\t\t" << "jl" << "\t" << "L" << label << "\n";
             // False branch
-            out << "\t\t" << "mov" << "\t" << "rax, 0" << endl;
-            out << "\t\t" << "jmp" << "\t" << "L" << label2 << endl;
+            out << "\t\t" << "mov" << "\t" << "rax, 0" << "\n";
+            out << "\t\t" << "jmp" << "\t" << "L" << label2 << "\n";
             // True branch
-            out << "\t\t" << "L" << label << ":" << endl;
-            out << "\t\t" << "mov" << "\t" << "rax, 1" << endl;
+            out << "\t\t" << "L" << label << ":" << "\n";
+            out << "\t\t" << "mov" << "\t" << "rax, 1" << "\n";
 
-            out << "\t\t" << "L" << label2 << ":" << endl;
+            out << "\t\t" << "L" << label2 << ":" << "\n";
             store(RAX, q->sym3);
             break;
         }
@@ -597,21 +1220,16 @@ void code_generator::expand(quad_list *q_list)
             int label = sym_tab->get_next_label();
             int label2 = sym_tab->get_next_label();
 
-            // We need to push in reverse order for this to work
-            fetch_float(q->sym2);
-            fetch_float(q->sym1);
-            out << "\t\t" << "fcomip" << "\t" << "ST(0), ST(1)" << endl;
-            // Clear the stack
-            out << "\t\t" << "fstp" << "\t" << "ST(0)" << endl;
-            out << "\t\t" << "ja" << "\t" << "L" << label << endl;
+            compare_float(q->sym1, q->sym2);
+            out << "\t\t" << "ja" << "\t" << "L" << label << "\n";
             // False branch
-            out << "\t\t" << "mov" << "\t" << "rax, 0" << endl;
-            out << "\t\t" << "jmp" << "\t" << "L" << label2 << endl;
+            out << "\t\t" << "mov" << "\t" << "rax, 0" << "\n";
+            out << "\t\t" << "jmp" << "\t" << "L" << label2 << "\n";
             // True branch
-            out << "\t\t" << "L" << label << ":" << endl;
-            out << "\t\t" << "mov" << "\t" << "rax, 1" << endl;
+            out << "\t\t" << "L" << label << ":" << "\n";
+            out << "\t\t" << "mov" << "\t" << "rax, 1" << "\n";
 
-            out << "\t\t" << "L" << label2 << ":" << endl;
+            out << "\t\t" << "L" << label2 << ":" << "\n";
             store(RAX, q->sym3);
             break;
         }
@@ -621,16 +1239,16 @@ void code_generator::expand(quad_list *q_list)
 
             fetch(q->sym1, RAX);
             fetch(q->sym2, RCX);
-            out << "\t\t" << "cmp" << "\t" << "rax, rcx" << endl;
-            out << "\t\t" << "jg" << "\t" << "L" << label << endl;
+            out << "\t\t" << "cmp" << "\t" << "rax, rcx" << "\n";
+            out << "\t\t" << "jg" << "\t" << "L" << label << "\n";
             // False branch
-            out << "\t\t" << "mov" << "\t" << "rax, 0" << endl;
-            out << "\t\t" << "jmp" << "\t" << "L" << label2 << endl;
+            out << "\t\t" << "mov" << "\t" << "rax, 0" << "\n";
+            out << "\t\t" << "jmp" << "\t" << "L" << label2 << "\n";
             // True branch
-            out << "\t\t" << "L" << label << ":" << endl;
-            out << "\t\t" << "mov" << "\t" << "rax, 1" << endl;
+            out << "\t\t" << "L" << label << ":" << "\n";
+            out << "\t\t" << "mov" << "\t" << "rax, 1" << "\n";
 
-            out << "\t\t" << "L" << label2 << ":" << endl;
+            out << "\t\t" << "L" << label2 << ":" << "\n";
             store(RAX, q->sym3);
             break;
         }
@@ -638,7 +1256,7 @@ void code_generator::expand(quad_list *q_list)
         case q_istore:
             fetch(q->sym1, RAX);
             fetch(q->sym3, RCX);
-            out << "\t\t" << "mov" << "\t" << "[rcx], rax" << endl;
+            out << "\t\t" << "mov" << "\t" << "[rcx], rax" << "\n";
             break;
 
         case q_rassign:
@@ -650,8 +1268,18 @@ void code_generator::expand(quad_list *q_list)
         case q_param:
             /* Your code here */
         	debug("q_param");
+        	if (argument_formal[quad_nr - 1] != NULL
+        	    && arguments_deferred[argument_call[quad_nr - 1]]) {
+        		// Loaded right before the call.
+        		reserved_arguments++;
+        		break;
+        	}
+        	if (reserved_arguments > 0) {
+        		out << "\t\t" << "sub" << "\t" << "rsp, " << STACK_WIDTH * reserved_arguments << "\n";
+        		reserved_arguments = 0;
+        	}
         	fetch(q->sym1, RAX);
-        	out << "\t\t" << "push" << "\t" << reg[RAX] << endl;
+        	out << "\t\t" << "push" << "\t" << reg[RAX] << "\n";
             break;
 
         case q_call: {
@@ -660,6 +1288,14 @@ void code_generator::expand(quad_list *q_list)
         	symbol* sym = sym_tab->get_symbol(q->sym1);
         	int size = 0;
         	string name = "";
+
+        	pass_arguments(q_list, quad_nr - 1);
+
+        	// The procedures of the run-time support are on level 0, where
+        	// there is no frame.
+        	if (static_links && sym->level > 0) {
+        		frame_address(sym->level, RAX);
+        	}
         	switch(sym->tag){
         	case SYM_PROC:
         		size = 0;
@@ -667,7 +1303,7 @@ void code_generator::expand(quad_list *q_list)
         			size = sym->get_procedure_symbol()->last_parameter->size;
 
         		name = sym_tab->pool_lookup(sym->get_procedure_symbol()->id);
-        		out << "\t\t" << "call" << "\t" << "L" << sym->get_procedure_symbol()->label_nr << "\t# " << name << endl;
+        		out << "\t\t" << "call" << "\t" << "L" << sym->get_procedure_symbol()->label_nr << "\t# " << name << "\n";
         		break;
         	case SYM_FUNC:
         		size = 0;
@@ -675,27 +1311,42 @@ void code_generator::expand(quad_list *q_list)
         			size = sym->get_function_symbol()->last_parameter->size;
 
         		name = sym_tab->pool_lookup(sym->get_function_symbol()->id);
-        		out << "\t\t" << "call" << "\t" << "L" << sym->get_function_symbol()->label_nr << "\t# " << name << endl;
-        		store(RAX, q->sym3);
+        		out << "\t\t" << "call" << "\t" << "L" << sym->get_function_symbol()->label_nr << "\t# " << name << "\n";
+        		// The function called may have changed R11, which the
+        		// result may be stored through.
+        		cached_level = -1;
+        		if (register_parameters && sym->level > 0
+        		    && sym->type == real_type) {
+        			store_sse(XMM0, q->sym3);
+        		} else {
+        			store(RAX, q->sym3);
+        		}
         		break;
         	default:
         		break;
         	}
 
-        	out << "\t\t" << "add" << "\t" << "rsp, " << STACK_WIDTH * q->int2 << endl;
+        	out << "\t\t" << "add" << "\t" << "rsp, " << STACK_WIDTH * q->int2 << "\n";
+        	// The procedure called may have changed R11.
+        	cached_level = -1;
             break;
         }
         case q_rreturn:
         case q_ireturn:
-            fetch(q->sym2, RAX);
-            out << "\t\t" << "jmp" << "\t" << "L" << q->int1 << endl;
+            if (register_parameters && q->op_code == q_rreturn
+                && q->sym2 != NULL_SYM) {
+                fetch_sse(q->sym2, XMM0);
+            } else {
+                fetch(q->sym2, RAX);
+            }
+            out << "\t\t" << "jmp" << "\t" << "L" << q->int1 << "\n";
             break;
 
         case q_lindex:
             array_address(q->sym1, RAX);
             fetch(q->sym2, RCX);
-            out << "\t\t" << "imul" << "\t" << "rcx, " << STACK_WIDTH << endl;
-            out << "\t\t" << "sub" << "\t" << "rax, rcx" << endl;
+            out << "\t\t" << "imul" << "\t" << "rcx, " << STACK_WIDTH << "\n";
+            out << "\t\t" << "sub" << "\t" << "rax, rcx" << "\n";
             store(RAX, q->sym3);
             break;
 
@@ -704,9 +1355,16 @@ void code_generator::expand(quad_list *q_list)
         case q_irindex:
             array_address(q->sym1, RAX);
             fetch(q->sym2, RCX);
-            out << "\t\t" << "imul" << "\t" << "rcx, " << STACK_WIDTH << endl;
-            out << "\t\t" << "sub" << "\t" << "rax, rcx" << endl;
-            out << "\t\t" << "mov" << "\t" << "rax, [rax]" << endl;
+            out << "\t\t" << "imul" << "\t" << "rcx, " << STACK_WIDTH << "\n";
+            out << "\t\t" << "sub" << "\t" << "rax, rcx" << "\n";
+            out << "\t\t" << "mov" << "\t" << "rax, [rax]" << "\n";
+            store(RAX, q->sym3);
+            break;
+
+        case q_rderef:
+        case q_ideref:
+            fetch(q->sym1, RCX);
+            out << "\t\t" << "mov" << "\t" << "rax, [rcx]" << "\n";
             store(RAX, q->sym3);
             break;
 
@@ -714,27 +1372,59 @@ void code_generator::expand(quad_list *q_list)
             block_level level;      // Current scope level.
             int offset;             // Offset within current activation record.
 
+            if (sse) {
+                fetch(q->sym1, RAX);
+                out << "\t\t" << "cvtsi2sd" << "\t" << "xmm0, rax" << "\n";
+                store_sse(XMM0, q->sym3);
+                break;
+            }
             find(q->sym1, &level, &offset);
-            frame_address(level, RCX);
-            out << "\t\t" << "fild" << "\t" << "qword ptr [rcx";
+            string base = frame_register(level);
+            out << "\t\t" << "fild" << "\t" << "qword ptr [" << base;
             if (offset >= 0) {
                 out << "+" << offset;
             } else {
                 out << offset; // Implicit "-"
             }
-            out << "]" << endl;
+            out << "]" << "\n";
             store_float(q->sym3);
         }
         break;
 
         case q_jmp:
-            out << "\t\t" << "jmp" << "\t" << "L" << q->int1 << endl;
+            out << "\t\t" << "jmp" << "\t" << "L" << q->int1 << "\n";
             break;
 
         case q_jmpf:
             fetch(q->sym2, RAX);
-            out << "\t\t" << "cmp" << "\t" << "rax, 0" << endl;
-            out << "\t\t" << "je" << "\t" << "L" << q->int1 << endl;
+            out << "\t\t" << "cmp" << "\t" << "rax, 0" << "\n";
+            out << "\t\t" << "je" << "\t" << "L" << q->int1 << "\n";
+            break;
+
+        case q_ijnlt:
+        case q_ijngt:
+        case q_ijneq:
+        case q_ijnne:
+            fetch(q->sym2, RAX);
+            fetch(q->sym3, RCX);
+            out << "\t\t" << "cmp" << "\t" << "rax, rcx" << "\n";
+            out << "\t\t" << (q->op_code == q_ijnlt ? "jge"
+                                : q->op_code == q_ijngt ? "jle"
+                                : q->op_code == q_ijneq ? "jne" : "je")
+                << "\t" << "L" << q->int1 << "\n";
+            break;
+
+        case q_rjnlt:
+        case q_rjngt:
+        case q_rjneq:
+        case q_rjnne:
+            // The jumps taken are the opposite of those setting 1 in
+            // q_rlt, q_rgt, q_req and q_rne, including for NaNs.
+            compare_float(q->sym2, q->sym3);
+            out << "\t\t" << (q->op_code == q_rjnlt ? "jae"
+                                : q->op_code == q_rjngt ? "jbe"
+                                : q->op_code == q_rjneq ? "jne" : "je")
+                << "\t" << "L" << q->int1 << "\n";
             break;
 
         case q_labl:
@@ -750,7 +1440,4 @@ void code_generator::expand(quad_list *q_list)
         // Get the next quad from the list.
         q = ql_iterator->get_next();
     }
-
-    // Flush the generated code to file.
-    out << flush;
 }
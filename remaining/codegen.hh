@@ -2,6 +2,9 @@
 #define __CODEGEN_HH__
 
 #include <fstream>
+#include <map>
+#include <sstream>
+#include <vector>
 
 #include "quads.hh"
 #include "symtab.hh"
@@ -9,25 +12,106 @@
 using namespace std;
 
 
-/* These are the registers we will be using. */
-enum register_type { RAX, RCX, RDX };
+/* These are the registers we will be using. RAX, RCX and RDX are scratch
+   registers, and XMM0 and XMM1 are where reals are computed from
+   optimization level 1, when R11 also holds frame addresses. The others
+   are only used from optimization level 2, for the variables given
+   registers by the register allocator (see regalloc.hh) and for arguments
+   (see parameter_register()). RSP, RBP and RIP are only named in the
+   machine instructions, see machine.hh. */
+enum register_type { RAX, RCX, RDX, RBX, RSI, RDI, R8, R9, R10, R11, R12, R13,
+                     R14, R15, RSP, RBP, RIP, XMM0, XMM1, XMM2, XMM3, XMM4,
+                     XMM5, XMM6, XMM7, XMM8, XMM9, XMM10, XMM11, XMM12, XMM13,
+                     XMM14, XMM15, NR_REGISTERS };
 
 
+// Returns the register an argument is passed in to the procedures of the
+// program from optimization level 2, or NR_REGISTERS if it is on the stack.
+register_type parameter_register(parameter_symbol *);
+
 // Maximum number of formal parameters allowed.
 const int MAX_PARAMETERS = 127;
 
 // This is the width/size of a single address on the stack (in bytes).
 const int STACK_WIDTH = 8;
 
+// The bytes below RSP which signal handlers leave alone, where procedures
+// without a frame of their own keep their variables.
+const int RED_ZONE = 128;
+
+// The size of the buffer of the assembler outfile.
+const int OUT_BUFFER_SIZE = 1 << 20;
+
 /* This class generates assembler code for the Intel architecture. */
+class object_file;
+
 class code_generator
 {
 private:
     // Register array.
-    string reg[3];
-
-    // Output file stream.
-    ofstream out;
+    string reg[NR_REGISTERS];
+
+    // The registers of the variables of the procedure being generated that
+    // have one, and the callee saved registers among them.
+    map<sym_index, register_type> registers;
+    vector<register_type> saved_registers;
+
+    // True if reals are computed with SSE instructions in XMM registers,
+    // which is done from optimization level 1. Level 0 keeps the x87 FPU
+    // stack to match the trace files.
+    bool sse;
+
+    // True if the variables of the current frame are addressed off RBP, and
+    // the address of an outer frame is kept in R11 while it may be reused.
+    // See frame_register().
+    bool cache_frames;
+
+    // The level of the variables of the procedure being generated, and the
+    // level of the frame whose address is in R11, or -1.
+    int frame_level;
+    int cached_level;
+
+    // True if the first arguments of calls to the procedures of the program
+    // are passed in registers, and real function values returned in XMM0,
+    // which is done from optimization level 2. See pass_arguments().
+    bool register_parameters;
+
+    // For each quad of the list being expanded: the index of the call a
+    // parameter is passed to, the formal parameter it is passed as if it is
+    // passed in a register, and its position among the arguments.
+    vector<int> argument_call;
+    vector<parameter_symbol *> argument_formal;
+    vector<int> argument_position;
+
+    // For each call in the list, true if the arguments it takes in registers
+    // are loaded right before it rather than pushed when computed.
+    vector<bool> arguments_deferred;
+
+    // The stack slots of deferred register arguments not yet reserved.
+    int reserved_arguments;
+
+    // True if the procedure being generated does without a frame of its
+    // own, and addresses its variables off RSP. See leaf_procedure().
+    bool leaf;
+
+    // The labels of the real constants loaded by the procedure being
+    // generated, by their ieee bit pattern. They are put in a read-only data
+    // section after it.
+    map<long, int> constants;
+
+    // Output file stream, and its buffer.
+    ofstream out_file;
+    vector<char> out_buffer;
+
+    // The program encoded into machine code, with the -b option.
+    object_file *object;
+
+    // The assembler code of the procedure being generated. It is read into
+    // a list of machine instructions when done, see machine.hh.
+    ostringstream out;
+
+    // Open the output file.
+    void open();
 
     // Align a stack frame.
     int  align(int);
@@ -44,6 +128,12 @@ private:
     // Get variable/parameter level & offset.
     void find(sym_index, int *, int *);
 
+    // Get the offset of a parameter.
+    int parameter_offset(parameter_symbol *);
+
+    // Check whether a procedure may do without a frame.
+    bool leaf_procedure(quad_list *, symbol *);
+
     // memory -> register.
     void fetch(sym_index, const register_type);
 
@@ -56,13 +146,47 @@ private:
     // FPU -> memory.
     void store_float(sym_index);
 
+    // Label of a real constant used with SSE.
+    int constant_label(long);
+
+    // memory -> XMM register.
+    void fetch_sse(sym_index, const register_type);
+
+    // XMM register -> memory.
+    void store_sse(const register_type, sym_index);
+
+    // Real arithmetic, with the x87 and SSE instruction doing it.
+    void float_arithmetic(quadruple *, const string, const string);
+
+    // Compares two reals, setting the flags like an unsigned integer cmp.
+    void compare_float(sym_index, sym_index);
+
     // Get array base address.
     void array_address(sym_index, const register_type);
 
     // Get frame base address.
     void frame_address(int level, const register_type);
+
+    // Get the register holding a frame base address.
+    string frame_register(int level);
+
+    // register -> register, for any two kinds of register.
+    void move_register(const register_type, const register_type);
+
+    // Several register -> register moves at once.
+    void move_registers(vector<pair<register_type, register_type> >);
+
+    // Find the calls the parameters of a quad list are passed to.
+    void find_arguments(quad_list *);
+
+    // Load the register arguments of a call.
+    void pass_arguments(quad_list *, int);
 public:
     bool isDebug = false;
+
+    // The name of the assembler outfile. It is opened when first written.
+    string object_file_name;
+
     // Constructor. Arg = filename of assembler outfile.
     code_generator(const string);
 
@@ -75,4 +199,7 @@ public:
     void debug(string);
 };
 
+// Defined in codegen.cc.
+extern code_generator *code_gen;
+
 #endif
@@ -22,6 +22,12 @@ main: # this is where the process starts
     fnstcw word ptr [rbp-8]
     or word ptr [rbp-8], 3072 # from FE_TOWARDZERO
     fldcw word ptr [rbp-8]
+    # The same goes for SSE, used for reals from optimization level 1. As
+    # rounding towards zero twice gives the same result as doing it once,
+    # results are the same as when computed on the FPU stack and stored.
+    stmxcsr dword ptr [rbp-8]
+    or dword ptr [rbp-8], 24576 # rounding control bits, towards zero
+    ldmxcsr dword ptr [rbp-8]
     leave
 
     enter 0, 0
@@ -32,8 +38,10 @@ main: # this is where the process starts
     ret
 
 L0: # read function
-    # Return value is in RAX
+    # Return value is in RAX. getchar returns an int, which is sign
+    # extended so that the end of the input is -1.
     call    getchar
+    cdqe
     ret
 
 L1: # write procedure
@@ -44,10 +52,5 @@ L1: # write procedure
 L2: # trunc function
     # This very cryptic instruction
     # ConVerTs with Truncation a Signed Double TO a Signed Integer
-    # cvttsd2si rax, [rsp+8]
-    enter 8, 0
-    fld qword ptr [rbp+16]
-    fistp qword ptr [rbp-8]
-    mov rax, qword ptr [rbp-8]
-    leave
+    cvttsd2si rax, qword ptr [rsp+8]
     ret
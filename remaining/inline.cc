@@ -0,0 +1,898 @@
+#include <algorithm>
+#include <set>
+
+#include "inline.hh"
+#include "optimize.hh"
+
+/*** This file contains the inliner, see inline.hh. It is run from
+ ast_optimizer::do_optimize() from optimization level 2, after type
+ checking and before the rest of the AST optimization. ***/
+
+ast_inliner *inliner = new ast_inliner();
+
+ast_inliner::ast_inliner() {
+	threshold = DEFAULT_INLINE_THRESHOLD;
+	body_level = -1;
+	result = NULL_SYM;
+	budget = 0;
+}
+
+/* Returns the parameters of a procedure or function, last one first. */
+static parameter_symbol *last_parameter(symbol *sym) {
+	if (sym->tag == SYM_FUNC) {
+		return sym->get_function_symbol()->last_parameter;
+	}
+	return sym->get_procedure_symbol()->last_parameter;
+}
+
+/* Appends the statements of a list to a vector, first statement first.
+ Empty list elements, left behind by dead branch elimination, are
+ skipped. */
+static void flatten(ast_stmt_list *list, vector<ast_statement *> &stmts) {
+	vector<ast_statement *> reversed;
+	for (ast_stmt_list *l = list; l != NULL; l = l->preceding) {
+		if (l->last_stmt != NULL) {
+			reversed.push_back(l->last_stmt);
+		}
+	}
+	stmts.insert(stmts.end(), reversed.rbegin(), reversed.rend());
+}
+
+/* The opposite of flatten(). An empty vector gives an empty list rather
+ than NULL, since the bodies of if statements may not be NULL. */
+static ast_stmt_list *unflatten(position_information *pos,
+		vector<ast_statement *> &stmts) {
+	ast_stmt_list *list = NULL;
+	for (unsigned int i = 0; i < stmts.size(); i++) {
+		list = new ast_stmt_list(stmts[i]->pos, stmts[i], list);
+	}
+	if (list == NULL) {
+		list = new ast_stmt_list(pos, NULL);
+	}
+	return list;
+}
+
+/* Appends the statements in back after those in front. Either can be NULL.
+ The list nodes are reused. */
+static ast_stmt_list *append(ast_stmt_list *front, ast_stmt_list *back) {
+	if (back == NULL) {
+		return front;
+	}
+	ast_stmt_list *first = back;
+	while (first->preceding != NULL) {
+		first = first->preceding;
+	}
+	first->preceding = front;
+	return back;
+}
+
+/* Counts the temporaries the quads of a statement list need at most: one
+ for each expression node but the identifiers, which are collected. */
+static int count_stmts(ast_stmt_list *, set<sym_index> &);
+
+static int count_expr(ast_expression *expr, set<sym_index> &ids) {
+	if (expr == NULL) {
+		return 0;
+	}
+	if (optimizer->is_binop(expr)) {
+		ast_binaryoperation *binop = expr->get_ast_binaryoperation();
+		return 1 + count_expr(binop->left, ids) + count_expr(binop->right, ids);
+	}
+	if (optimizer->is_binrel(expr)) {
+		ast_binaryrelation *binrel = expr->get_ast_binaryrelation();
+		return 1 + count_expr(binrel->left, ids)
+				+ count_expr(binrel->right, ids);
+	}
+
+	switch (expr->tag) {
+	case AST_ID:
+		ids.insert(expr->get_ast_id()->sym_p);
+		return 0;
+	case AST_INDEXED: {
+		ast_indexed *indexed = static_cast<ast_indexed *>(expr);
+		return 1 + count_expr(indexed->id, ids)
+				+ count_expr(indexed->index, ids);
+	}
+	case AST_FUNCTIONCALL: {
+		int count = 1;
+		for (ast_expr_list *e =
+				static_cast<ast_functioncall *>(expr)->parameter_list;
+				e != NULL; e = e->preceding) {
+			count += count_expr(e->last_expr, ids);
+		}
+		return count;
+	}
+	case AST_UMINUS:
+		return 1 + count_expr(expr->get_ast_uminus()->expr, ids);
+	case AST_NOT:
+		return 1 + count_expr(expr->get_ast_not()->expr, ids);
+	case AST_CAST:
+		return 1 + count_expr(expr->get_ast_cast()->expr, ids);
+	case AST_INLINEDCALL: {
+		ast_inlinedcall *call = static_cast<ast_inlinedcall *>(expr);
+		return count_stmts(call->body, ids) + count_expr(call->result, ids);
+	}
+	default:
+		return 1;
+	}
+}
+
+static int count_stmt(ast_statement *stmt, set<sym_index> &ids) {
+	switch (stmt->tag) {
+	case AST_PROCEDURECALL: {
+		int count = 0;
+		for (ast_expr_list *e =
+				static_cast<ast_procedurecall *>(stmt)->parameter_list;
+				e != NULL; e = e->preceding) {
+			count += count_expr(e->last_expr, ids);
+		}
+		return count;
+	}
+	case AST_ASSIGN: {
+		ast_assign *assign = static_cast<ast_assign *>(stmt);
+		return count_expr(assign->lhs, ids) + count_expr(assign->rhs, ids);
+	}
+	case AST_WHILE: {
+		ast_while *loop = static_cast<ast_while *>(stmt);
+		return count_expr(loop->condition, ids) + count_stmts(loop->body, ids);
+	}
+	case AST_IF: {
+		ast_if *if_stmt = static_cast<ast_if *>(stmt);
+		int count = count_expr(if_stmt->condition, ids)
+				+ count_stmts(if_stmt->body, ids)
+				+ count_stmts(if_stmt->else_body, ids);
+		for (ast_elsif_list *l = if_stmt->elsif_list; l != NULL;
+				l = l->preceding) {
+			count += count_expr(l->last_elsif->condition, ids)
+					+ count_stmts(l->last_elsif->body, ids);
+		}
+		return count;
+	}
+	case AST_RETURN:
+		return count_expr(static_cast<ast_return *>(stmt)->value, ids);
+	default:
+		return 0;
+	}
+}
+
+static int count_stmts(ast_stmt_list *list, set<sym_index> &ids) {
+	int count = 0;
+	for (ast_stmt_list *l = list; l != NULL; l = l->preceding) {
+		if (l->last_stmt != NULL) {
+			count += count_stmt(l->last_stmt, ids);
+		}
+	}
+	return count;
+}
+
+/*** Checking whether a body may be inlined. ***/
+
+/* A body may be inlined if it doesn't call the procedure itself or any
+ procedure nested inside it (those need its activation record), doesn't
+ declare any local arrays (we can only create temporary variables) and
+ doesn't return from inside a while loop (checked in normalize()). The
+ size is the number of statement and expression nodes. */
+bool ast_inliner::scan_stmts(ast_stmt_list *list, sym_index callee,
+		int *size) {
+	for (ast_stmt_list *l = list; l != NULL; l = l->preceding) {
+		if (l->last_stmt != NULL && !scan_stmt(l->last_stmt, callee, size)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool ast_inliner::scan_stmt(ast_statement *stmt, sym_index callee,
+		int *size) {
+	symbol *sym = sym_tab->get_symbol(callee);
+
+	(*size)++;
+	switch (stmt->tag) {
+	case AST_PROCEDURECALL: {
+		ast_procedurecall *call = static_cast<ast_procedurecall *>(stmt);
+		if (call->id->sym_p == callee
+				|| sym_tab->get_symbol(call->id->sym_p)->level > sym->level) {
+			return false;
+		}
+		for (ast_expr_list *e = call->parameter_list; e != NULL;
+				e = e->preceding) {
+			if (!scan_expr(e->last_expr, callee, size)) {
+				return false;
+			}
+		}
+		return true;
+	}
+	case AST_ASSIGN: {
+		ast_assign *assign = static_cast<ast_assign *>(stmt);
+		return scan_expr(assign->lhs, callee, size)
+				&& scan_expr(assign->rhs, callee, size);
+	}
+	case AST_WHILE: {
+		ast_while *loop = static_cast<ast_while *>(stmt);
+		return scan_expr(loop->condition, callee, size)
+				&& scan_stmts(loop->body, callee, size);
+	}
+	case AST_IF: {
+		ast_if *if_stmt = static_cast<ast_if *>(stmt);
+		if (!scan_expr(if_stmt->condition, callee, size)
+				|| !scan_stmts(if_stmt->body, callee, size)
+				|| !scan_stmts(if_stmt->else_body, callee, size)) {
+			return false;
+		}
+		for (ast_elsif_list *l = if_stmt->elsif_list; l != NULL;
+				l = l->preceding) {
+			if (!scan_expr(l->last_elsif->condition, callee, size)
+					|| !scan_stmts(l->last_elsif->body, callee, size)) {
+				return false;
+			}
+		}
+		return true;
+	}
+	case AST_RETURN: {
+		ast_return *ret = static_cast<ast_return *>(stmt);
+		return ret->value == NULL || scan_expr(ret->value, callee, size);
+	}
+	default:
+		return false;
+	}
+}
+
+bool ast_inliner::scan_expr(ast_expression *expr, sym_index callee,
+		int *size) {
+	symbol *sym = sym_tab->get_symbol(callee);
+
+	(*size)++;
+	if (optimizer->is_binop(expr)) {
+		ast_binaryoperation *binop = expr->get_ast_binaryoperation();
+		return scan_expr(binop->left, callee, size)
+				&& scan_expr(binop->right, callee, size);
+	}
+	if (optimizer->is_binrel(expr)) {
+		ast_binaryrelation *binrel = expr->get_ast_binaryrelation();
+		return scan_expr(binrel->left, callee, size)
+				&& scan_expr(binrel->right, callee, size);
+	}
+
+	switch (expr->tag) {
+	case AST_ID: {
+		symbol *var = sym_tab->get_symbol(expr->get_ast_id()->sym_p);
+		return var->tag != SYM_ARRAY || var->level <= sym->level;
+	}
+	case AST_INDEXED: {
+		ast_indexed *indexed = static_cast<ast_indexed *>(expr);
+		return scan_expr(indexed->id, callee, size)
+				&& scan_expr(indexed->index, callee, size);
+	}
+	case AST_FUNCTIONCALL: {
+		ast_functioncall *call = static_cast<ast_functioncall *>(expr);
+		if (call->id->sym_p == callee
+				|| sym_tab->get_symbol(call->id->sym_p)->level > sym->level) {
+			return false;
+		}
+		for (ast_expr_list *e = call->parameter_list; e != NULL;
+				e = e->preceding) {
+			if (!scan_expr(e->last_expr, callee, size)) {
+				return false;
+			}
+		}
+		return true;
+	}
+	case AST_UMINUS:
+		return scan_expr(expr->get_ast_uminus()->expr, callee, size);
+	case AST_NOT:
+		return scan_expr(expr->get_ast_not()->expr, callee, size);
+	case AST_CAST:
+		return scan_expr(expr->get_ast_cast()->expr, callee, size);
+	case AST_INTEGER:
+	case AST_REAL:
+		return true;
+	case AST_INLINEDCALL: {
+		ast_inlinedcall *inlined = static_cast<ast_inlinedcall *>(expr);
+		return scan_stmts(inlined->body, callee, size)
+				&& scan_expr(inlined->result, callee, size);
+	}
+	default:
+		return false;
+	}
+}
+
+/* Returns true if a statement list contains a return statement anywhere.
+ Inlined function bodies never do. */
+bool ast_inliner::contains_return(ast_stmt_list *list) {
+	for (ast_stmt_list *l = list; l != NULL; l = l->preceding) {
+		ast_statement *stmt = l->last_stmt;
+		if (stmt == NULL) {
+			continue;
+		}
+		if (stmt->tag == AST_RETURN) {
+			return true;
+		}
+		if (stmt->tag == AST_WHILE
+				&& contains_return(static_cast<ast_while *>(stmt)->body)) {
+			return true;
+		}
+		if (stmt->tag == AST_IF) {
+			ast_if *if_stmt = static_cast<ast_if *>(stmt);
+			if (contains_return(if_stmt->body)
+					|| contains_return(if_stmt->else_body)) {
+				return true;
+			}
+			for (ast_elsif_list *e = if_stmt->elsif_list; e != NULL;
+					e = e->preceding) {
+				if (contains_return(e->last_elsif->body)) {
+					return true;
+				}
+			}
+		}
+	}
+	return false;
+}
+
+/* Returns true if an expression is a variable or parameter other than
+ those of the body being copied, which the caller's other operands may
+ change. */
+bool ast_inliner::outer_variable(ast_expression *expr) {
+	if (expr->tag != AST_ID) {
+		return false;
+	}
+	symbol *sym = sym_tab->get_symbol(expr->get_ast_id()->sym_p);
+	return (sym->tag == SYM_VAR || sym->tag == SYM_PARAM)
+			&& sym->level != body_level;
+}
+
+/* Rewrites a statement sequence so that every return statement is the
+ last statement of the sequence or of an arm of an if statement that is
+ itself last. Statements after a return are dropped, and the statements
+ following an if statement that contains a return are moved into each of
+ its arms (adding an else arm if needed):
+
+     if x < 0 then return -x; end; return x;
+
+ becomes
+
+     if x < 0 then return -x; else return x; end;
+
+ The inliner can then turn each return into an assignment of the result
+ and let control fall through to the end of the body. Returns from inside
+ while loops can't be handled this way, so false is returned for those.
+ The statements in the sequence must be a copy, as they are changed. */
+bool ast_inliner::normalize(vector<ast_statement *> &stmts) {
+	for (unsigned int i = 0; i < stmts.size(); i++) {
+		ast_statement *stmt = stmts[i];
+
+		if (stmt->tag == AST_RETURN) {
+			stmts.resize(i + 1);
+			return true;
+		}
+
+		if (stmt->tag == AST_WHILE) {
+			if (contains_return(static_cast<ast_while *>(stmt)->body)) {
+				return false;
+			}
+			continue;
+		}
+
+		if (stmt->tag != AST_IF) {
+			continue;
+		}
+
+		ast_if *if_stmt = static_cast<ast_if *>(stmt);
+		ast_stmt_list tmp(stmt->pos, stmt);
+		if (!contains_return(&tmp)) {
+			continue;
+		}
+
+		// Each arm gets its own copy of the statements after the if.
+		ast_stmt_list *rest = NULL;
+		for (unsigned int j = i + 1; j < stmts.size(); j++) {
+			rest = new ast_stmt_list(stmts[j]->pos, stmts[j], rest);
+		}
+		stmts.resize(i + 1);
+
+		vector<ast_stmt_list **> arms;
+		arms.push_back(&if_stmt->body);
+		for (ast_elsif_list *e = if_stmt->elsif_list; e != NULL;
+				e = e->preceding) {
+			arms.push_back(&e->last_elsif->body);
+		}
+		arms.push_back(&if_stmt->else_body);
+
+		for (unsigned int j = 0; j < arms.size(); j++) {
+			vector<ast_statement *> arm;
+			flatten(*arms[j], arm);
+			flatten(clone_stmts(rest), arm);
+			if (!normalize(arm)) {
+				return false;
+			}
+			*arms[j] = unflatten(stmt->pos, arm);
+		}
+		return true;
+	}
+	return true;
+}
+
+/*** Copying of AST nodes. When a body is copied into a caller, the
+ parameters and local variables of the callee are replaced by temporaries
+ and the return statements by assignments of the result. ***/
+
+ast_stmt_list *ast_inliner::clone_stmts(ast_stmt_list *list) {
+	vector<ast_statement *> stmts;
+	ast_stmt_list *copy = NULL;
+
+	flatten(list, stmts);
+	for (unsigned int i = 0; i < stmts.size(); i++) {
+		ast_statement *stmt = clone_stmt(stmts[i]);
+		if (stmt != NULL) {
+			copy = new ast_stmt_list(stmts[i]->pos, stmt, copy);
+		}
+	}
+	if (copy == NULL && list != NULL) {
+		copy = new ast_stmt_list(list->pos, NULL);
+	}
+	return copy;
+}
+
+ast_statement *ast_inliner::clone_stmt(ast_statement *stmt) {
+	position_information *pos = stmt->pos;
+
+	switch (stmt->tag) {
+	case AST_PROCEDURECALL: {
+		ast_procedurecall *call = static_cast<ast_procedurecall *>(stmt);
+		return new ast_procedurecall(pos, clone_id(call->id),
+				clone_exprs(call->parameter_list));
+	}
+	case AST_ASSIGN: {
+		ast_assign *assign = static_cast<ast_assign *>(stmt);
+		return new ast_assign(pos, clone_lvalue(assign->lhs),
+				clone_expr(assign->rhs));
+	}
+	case AST_WHILE: {
+		ast_while *loop = static_cast<ast_while *>(stmt);
+		return new ast_while(pos, clone_expr(loop->condition),
+				clone_stmts(loop->body));
+	}
+	case AST_IF: {
+		ast_if *if_stmt = static_cast<ast_if *>(stmt);
+		vector<ast_elsif *> elsifs;
+		for (ast_elsif_list *e = if_stmt->elsif_list; e != NULL;
+				e = e->preceding) {
+			elsifs.push_back(e->last_elsif);
+		}
+		ast_elsif_list *elsif_list = NULL;
+		for (int i = elsifs.size() - 1; i >= 0; i--) {
+			ast_elsif *elsif = new ast_elsif(elsifs[i]->pos,
+					clone_expr(elsifs[i]->condition),
+					clone_stmts(elsifs[i]->body));
+			elsif_list = new ast_elsif_list(elsifs[i]->pos, elsif, elsif_list);
+		}
+		return new ast_if(pos, clone_expr(if_stmt->condition),
+				clone_stmts(if_stmt->body), elsif_list,
+				clone_stmts(if_stmt->else_body));
+	}
+	case AST_RETURN: {
+		ast_return *ret = static_cast<ast_return *>(stmt);
+		if (body_level < 0) {
+			if (ret->value == NULL) {
+				return new ast_return(pos);
+			}
+			return new ast_return(pos, clone_expr(ret->value));
+		}
+		// Inlined into a caller. Procedures simply fall through to the end
+		// of the body.
+		if (result == NULL_SYM) {
+			return NULL;
+		}
+		ast_id *lhs = new ast_id(pos, result);
+		lhs->type = sym_tab->get_symbol(result)->type;
+		return new ast_assign(pos, lhs, clone_expr(ret->value));
+	}
+	default:
+		fatal("Unexpected statement in ast_inliner::clone_stmt()");
+		return NULL;
+	}
+}
+
+/* Copies an identifier, replacing the parameters and local variables of
+ the body being inlined with temporaries. The temporaries for the
+ parameters have been created by expand(), those for local variables are
+ created the first time they are seen. */
+ast_id *ast_inliner::clone_id(ast_id *id) {
+	sym_index sym_p = id->sym_p;
+	symbol *sym = sym_tab->get_symbol(sym_p);
+
+	if (body_level >= 0 && sym->level == body_level
+			&& (sym->tag == SYM_VAR || sym->tag == SYM_PARAM)) {
+		if (renamed.find(sym) == renamed.end()) {
+			renamed[sym] = sym_tab->gen_temp_var(sym->type);
+		}
+		sym_p = renamed[sym];
+	}
+
+	ast_id *copy = new ast_id(id->pos, sym_p);
+	copy->type = id->type;
+	return copy;
+}
+
+ast_lvalue *ast_inliner::clone_lvalue(ast_lvalue *lvalue) {
+	if (lvalue->tag == AST_INDEXED) {
+		ast_indexed *indexed = static_cast<ast_indexed *>(lvalue);
+		ast_indexed *copy = new ast_indexed(indexed->pos,
+				clone_id(indexed->id), clone_expr(indexed->index));
+		copy->type = indexed->type;
+		return copy;
+	}
+	return clone_id(lvalue->get_ast_id());
+}
+
+ast_expr_list *ast_inliner::clone_exprs(ast_expr_list *list) {
+	if (list == NULL) {
+		return NULL;
+	}
+	return new ast_expr_list(list->pos, clone_expr(list->last_expr),
+			clone_exprs(list->preceding));
+}
+
+ast_expression *ast_inliner::clone_expr(ast_expression *expr) {
+	position_information *pos = expr->pos;
+	ast_expression *copy;
+
+	if (optimizer->is_binop(expr) || optimizer->is_binrel(expr)) {
+		ast_expression *left;
+		ast_expression *right;
+		if (optimizer->is_binop(expr)) {
+			left = clone_expr(expr->get_ast_binaryoperation()->left);
+			right = clone_expr(expr->get_ast_binaryoperation()->right);
+		} else {
+			left = clone_expr(expr->get_ast_binaryrelation()->left);
+			right = clone_expr(expr->get_ast_binaryrelation()->right);
+		}
+
+		switch (expr->tag) {
+		case AST_ADD:
+			copy = new ast_add(pos, left, right);
+			break;
+		case AST_SUB:
+			copy = new ast_sub(pos, left, right);
+			break;
+		case AST_OR:
+			copy = new ast_or(pos, left, right);
+			break;
+		case AST_AND:
+			copy = new ast_and(pos, left, right);
+			break;
+		case AST_MULT:
+			copy = new ast_mult(pos, left, right);
+			break;
+		case AST_DIVIDE:
+			copy = new ast_divide(pos, left, right);
+			break;
+		case AST_IDIV:
+			copy = new ast_idiv(pos, left, right);
+			break;
+		case AST_MOD:
+			copy = new ast_mod(pos, left, right);
+			break;
+		case AST_EQUAL:
+			copy = new ast_equal(pos, left, right);
+			break;
+		case AST_NOTEQUAL:
+			copy = new ast_notequal(pos, left, right);
+			break;
+		case AST_LESSTHAN:
+			copy = new ast_lessthan(pos, left, right);
+			break;
+		default:
+			copy = new ast_greaterthan(pos, left, right);
+			break;
+		}
+		copy->type = expr->type;
+		return copy;
+	}
+
+	switch (expr->tag) {
+	case AST_ID:
+		return clone_id(expr->get_ast_id());
+	case AST_INDEXED:
+		return clone_lvalue(static_cast<ast_indexed *>(expr));
+	case AST_FUNCTIONCALL: {
+		ast_functioncall *call = static_cast<ast_functioncall *>(expr);
+		copy = new ast_functioncall(pos, clone_id(call->id),
+				clone_exprs(call->parameter_list));
+		break;
+	}
+	case AST_UMINUS:
+		copy = new ast_uminus(pos, clone_expr(expr->get_ast_uminus()->expr));
+		break;
+	case AST_NOT:
+		copy = new ast_not(pos, clone_expr(expr->get_ast_not()->expr));
+		break;
+	case AST_CAST:
+		copy = new ast_cast(pos, clone_expr(expr->get_ast_cast()->expr));
+		break;
+	case AST_INTEGER:
+		copy = new ast_integer(pos, expr->get_ast_integer()->value);
+		break;
+	case AST_REAL:
+		copy = new ast_real(pos, expr->get_ast_real()->value);
+		break;
+	case AST_INLINEDCALL: {
+		ast_inlinedcall *inlined = static_cast<ast_inlinedcall *>(expr);
+		copy = new ast_inlinedcall(pos, inlined->function,
+				clone_stmts(inlined->body), clone_expr(inlined->result));
+		break;
+	}
+	default:
+		fatal("Unexpected expression in ast_inliner::clone_expr()");
+		return NULL;
+	}
+	copy->type = expr->type;
+	return copy;
+}
+
+/*** The interface methods. ***/
+
+/* Keeps a normalized copy of a body if it is small enough to be inlined.
+ Functions have to end with a return statement, otherwise the result would
+ be undefined on some path anyway and we don't bother. */
+void ast_inliner::remember(sym_index callee, ast_stmt_list *body) {
+	symbol *sym = sym_tab->get_symbol(callee);
+	int size = 0;
+
+	if (threshold <= 0 || sym->level == 0) {
+		return;
+	}
+	if (sym->tag == SYM_FUNC && (body == NULL || body->last_stmt == NULL
+			|| body->last_stmt->tag != AST_RETURN)) {
+		return;
+	}
+	if (!scan_stmts(body, callee, &size) || size > threshold) {
+		return;
+	}
+
+	vector<ast_statement *> stmts;
+	body_level = -1;
+	flatten(clone_stmts(body), stmts);
+	if (!normalize(stmts)) {
+		return;
+	}
+
+	inline_body b;
+	b.body = stmts.empty() ? NULL : unflatten(stmts[0]->pos, stmts);
+	b.size = 0;
+	scan_stmts(b.body, callee, &b.size);
+
+	// Besides those of its quads, a copy needs a temporary for each local
+	// variable and the result.
+	set<sym_index> ids;
+	b.temps = count_stmts(b.body, ids) + 1;
+	for (set<sym_index>::iterator i = ids.begin(); i != ids.end(); i++) {
+		symbol *var = sym_tab->get_symbol(*i);
+		if (var->tag == SYM_VAR && var->level == sym->level + 1) {
+			b.temps++;
+		}
+	}
+
+	if (b.size <= threshold) {
+		bodies[callee] = b;
+		// The temporaries of calls inlined into the body are among the
+		// symbols it refers to.
+		sym_tab->keep_symbols();
+	}
+}
+
+/* Builds the statements that replace a call: the arguments are assigned to
+ temporaries standing in for the parameters, in the same order as they
+ would have been evaluated and pushed for the call, followed by a copy of
+ the body. For functions the expression giving the value of the call is
+ returned as well. Returns false if the callee can't be inlined here. */
+bool ast_inliner::expand(position_information *pos, ast_id *id,
+		ast_expr_list *args, ast_stmt_list **stmts, ast_expression **value) {
+	map<sym_index, inline_body>::iterator it = bodies.find(id->sym_p);
+	if (it == bodies.end()) {
+		return false;
+	}
+
+	symbol *sym = sym_tab->get_symbol(id->sym_p);
+	ast_stmt_list *body = it->second.body;
+
+	// Arguments should have the same type as the parameters by now, but
+	// don't take any chances.
+	parameter_symbol *param = last_parameter(sym);
+	for (ast_expr_list *a = args; a != NULL; a = a->preceding) {
+		if (param == NULL || a->last_expr->type != param->type) {
+			return false;
+		}
+		param = param->preceding;
+	}
+
+	// One more temporary is needed for each argument, see do_inline().
+	int temps = it->second.temps;
+	for (ast_expr_list *a = args; a != NULL; a = a->preceding) {
+		temps++;
+	}
+	if (temps > budget) {
+		return false;
+	}
+	budget -= temps;
+
+	body_level = sym->level + 1;
+	renamed.clear();
+	result = NULL_SYM;
+	*stmts = NULL;
+	*value = NULL;
+
+	param = last_parameter(sym);
+	for (ast_expr_list *a = args; a != NULL; a = a->preceding) {
+		sym_index temp = sym_tab->gen_temp_var(param->type);
+		ast_id *lhs = new ast_id(pos, temp);
+		lhs->type = param->type;
+		renamed[param] = temp;
+		*stmts = new ast_stmt_list(pos, new ast_assign(pos, lhs,
+				a->last_expr), *stmts);
+		param = param->preceding;
+	}
+
+	if (sym->tag == SYM_FUNC) {
+		// A function which only returns at the very end can use the
+		// returned expression directly, unless it is a variable of
+		// another frame, which would only be read after the operands
+		// following the call.
+		if (body->last_stmt->tag == AST_RETURN
+				&& !contains_return(body->preceding)
+				&& !outer_variable(
+						static_cast<ast_return *>(body->last_stmt)->value)) {
+			ast_return *ret = static_cast<ast_return *>(body->last_stmt);
+			*stmts = append(*stmts, clone_stmts(body->preceding));
+			*value = clone_expr(ret->value);
+		} else {
+			result = sym_tab->gen_temp_var(sym->type);
+			*stmts = append(*stmts, clone_stmts(body));
+			ast_id *result_id = new ast_id(pos, result);
+			result_id->type = sym->type;
+			*value = result_id;
+		}
+	} else {
+		*stmts = append(*stmts, clone_stmts(body));
+	}
+
+	body_level = -1;
+	cout << "Inlined " << sym_tab->pool_lookup(sym->id) << " (size "
+			<< it->second.size << ") into "
+			<< sym_tab->pool_lookup(
+					sym_tab->get_symbol(sym_tab->current_environment())->id)
+			<< endl;
+	return true;
+}
+
+/* Replaces the calls in a statement list, first statement first so that
+ the statements spliced in for a procedure call are never visited again. */
+void ast_inliner::inline_stmts(ast_stmt_list *list) {
+	if (list == NULL) {
+		return;
+	}
+	inline_stmts(list->preceding);
+
+	ast_statement *stmt = list->last_stmt;
+	if (stmt == NULL) {
+		return;
+	}
+	if (stmt->tag == AST_PROCEDURECALL) {
+		ast_procedurecall *call = static_cast<ast_procedurecall *>(stmt);
+		ast_stmt_list *stmts;
+		ast_expression *value;
+		inline_exprs(call->parameter_list);
+		if (expand(call->pos, call->id, call->parameter_list, &stmts, &value)) {
+			optimizer->splice_statement(list, stmts);
+		}
+		return;
+	}
+	inline_stmt(stmt);
+}
+
+void ast_inliner::inline_stmt(ast_statement *stmt) {
+	switch (stmt->tag) {
+	case AST_ASSIGN: {
+		ast_assign *assign = static_cast<ast_assign *>(stmt);
+		if (assign->lhs->tag == AST_INDEXED) {
+			ast_indexed *indexed = static_cast<ast_indexed *>(assign->lhs);
+			indexed->index = inline_expr(indexed->index);
+		}
+		assign->rhs = inline_expr(assign->rhs);
+		break;
+	}
+	case AST_WHILE: {
+		ast_while *loop = static_cast<ast_while *>(stmt);
+		loop->condition = inline_expr(loop->condition);
+		inline_stmts(loop->body);
+		break;
+	}
+	case AST_IF: {
+		ast_if *if_stmt = static_cast<ast_if *>(stmt);
+		if_stmt->condition = inline_expr(if_stmt->condition);
+		inline_stmts(if_stmt->body);
+		for (ast_elsif_list *e = if_stmt->elsif_list; e != NULL;
+				e = e->preceding) {
+			e->last_elsif->condition = inline_expr(e->last_elsif->condition);
+			inline_stmts(e->last_elsif->body);
+		}
+		inline_stmts(if_stmt->else_body);
+		break;
+	}
+	case AST_RETURN: {
+		ast_return *ret = static_cast<ast_return *>(stmt);
+		if (ret->value != NULL) {
+			ret->value = inline_expr(ret->value);
+		}
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+void ast_inliner::inline_exprs(ast_expr_list *list) {
+	for (ast_expr_list *l = list; l != NULL; l = l->preceding) {
+		l->last_expr = inline_expr(l->last_expr);
+	}
+}
+
+ast_expression *ast_inliner::inline_expr(ast_expression *expr) {
+	if (optimizer->is_binop(expr)) {
+		ast_binaryoperation *binop = expr->get_ast_binaryoperation();
+		binop->left = inline_expr(binop->left);
+		binop->right = inline_expr(binop->right);
+		return expr;
+	}
+	if (optimizer->is_binrel(expr)) {
+		ast_binaryrelation *binrel = expr->get_ast_binaryrelation();
+		binrel->left = inline_expr(binrel->left);
+		binrel->right = inline_expr(binrel->right);
+		return expr;
+	}
+
+	switch (expr->tag) {
+	case AST_INDEXED: {
+		ast_indexed *indexed = static_cast<ast_indexed *>(expr);
+		indexed->index = inline_expr(indexed->index);
+		return expr;
+	}
+	case AST_FUNCTIONCALL: {
+		ast_functioncall *call = static_cast<ast_functioncall *>(expr);
+		ast_stmt_list *stmts;
+		ast_expression *value;
+		inline_exprs(call->parameter_list);
+		if (expand(call->pos, call->id, call->parameter_list, &stmts, &value)) {
+			return new ast_inlinedcall(call->pos, call->id->sym_p, stmts,
+					value);
+		}
+		return expr;
+	}
+	case AST_UMINUS:
+		expr->get_ast_uminus()->expr = inline_expr(expr->get_ast_uminus()->expr);
+		return expr;
+	case AST_NOT:
+		expr->get_ast_not()->expr = inline_expr(expr->get_ast_not()->expr);
+		return expr;
+	case AST_CAST:
+		expr->get_ast_cast()->expr = inline_expr(expr->get_ast_cast()->expr);
+		return expr;
+	default:
+		return expr;
+	}
+}
+
+/* Inlines the calls in the body of the procedure being compiled. The
+ symbol table has a fixed size, and a program which compiles without
+ inlining must still compile with it. The temporaries of the procedure are
+ forgotten once its code has been generated, so it is enough that those
+ of the copies fit next to the ones the procedure needs anyway, at most one
+ per expression node. The few the quad optimizer adds are made up for by
+ the nodes folded away. Calls are kept once the copies wouldn't fit. */
+void ast_inliner::do_inline(ast_stmt_list *body) {
+	sym_tab->forget_temp_vars();
+	set<sym_index> ids;
+	budget = sym_tab->free_symbols() - count_stmts(body, ids);
+	if (threshold > 0) {
+		inline_stmts(body);
+	}
+}
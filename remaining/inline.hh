@@ -0,0 +1,98 @@
+#ifndef __INLINE_HH__
+#define __INLINE_HH__
+
+#include <map>
+#include <vector>
+
+#include "ast.hh"
+
+/*** This class performs inlining on the AST. The bodies of small procedures
+ and functions are kept after they have been compiled, and calls to them
+ from procedures compiled later on are replaced by a copy of the body, with
+ the parameters and local variables turned into temporary variables of the
+ caller. Since nested procedures are compiled before their parents, the
+ bodies that get copied have already had their own calls inlined. ***/
+
+class ast_inliner;
+
+// Defined in inline.cc.
+extern ast_inliner *inliner;
+
+// The default maximum size, in AST nodes, of a body that may be inlined.
+const int DEFAULT_INLINE_THRESHOLD = 40;
+
+class ast_inliner {
+private:
+	// A body that may be inlined. Every return in it is the last statement
+	// of the body, or of an arm of an if statement which is itself in such
+	// a position. See normalize().
+	struct inline_body {
+		ast_stmt_list *body;
+		int size;
+		int temps;
+	};
+
+	// The procedures and functions that may be inlined.
+	map<sym_index, inline_body> bodies;
+
+	// The block level of the parameters and local variables of the body
+	// being copied, and the temporaries replacing them in the caller.
+	// When copying a body in remember(), body_level is -1 and no symbols
+	// are replaced.
+	block_level body_level;
+	map<symbol *, sym_index> renamed;
+
+	// Where the value of a return statement is assigned when a function
+	// body is copied into a caller. NULL_SYM for procedures, and for
+	// functions which only return at the very end.
+	sym_index result;
+
+	// How many more symbols the copies in the caller may need, see
+	// do_inline().
+	sym_index budget;
+
+	// Checks that a body can be inlined at all, and counts its nodes.
+	bool scan_stmts(ast_stmt_list *, sym_index, int *);
+	bool scan_stmt(ast_statement *, sym_index, int *);
+	bool scan_expr(ast_expression *, sym_index, int *);
+
+	// Moves all return statements into tail position.
+	bool normalize(vector<ast_statement *> &);
+	bool contains_return(ast_stmt_list *);
+	bool outer_variable(ast_expression *);
+
+	// Copying of AST nodes.
+	ast_stmt_list *clone_stmts(ast_stmt_list *);
+	ast_statement *clone_stmt(ast_statement *);
+	ast_expression *clone_expr(ast_expression *);
+	ast_lvalue *clone_lvalue(ast_lvalue *);
+	ast_id *clone_id(ast_id *);
+	ast_expr_list *clone_exprs(ast_expr_list *);
+
+	// Builds the statements replacing a call, and for functions the
+	// expression giving its value.
+	bool expand(position_information *, ast_id *, ast_expr_list *,
+			ast_stmt_list **, ast_expression **);
+
+	// Walks the caller's body looking for calls to inline.
+	void inline_stmts(ast_stmt_list *);
+	void inline_stmt(ast_statement *);
+	ast_expression *inline_expr(ast_expression *);
+	void inline_exprs(ast_expr_list *);
+
+public:
+	// Bodies larger than this are never inlined. 0 disables inlining.
+	int threshold;
+
+	ast_inliner();
+
+	// Called with the body of a procedure or function once it has been
+	// optimized. Keeps a copy of it if it may be inlined later on.
+	void remember(sym_index, ast_stmt_list *);
+
+	// Replaces the calls in a body by the bodies remembered so far, and
+	// prints a line about each call it inlines.
+	void do_inline(ast_stmt_list *);
+};
+
+#endif
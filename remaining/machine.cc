@@ -0,0 +1,726 @@
+#include <ctype.h>
+#include <stdlib.h>
+#include <sstream>
+
+#include "error.hh"
+#include "machine.hh"
+
+/*** This file contains the machine instruction list and its peephole
+ optimizer, see machine.hh. ***/
+
+static const char *register_names[NR_REGISTERS] = { "rax", "rcx", "rdx",
+		"rbx", "rsi", "rdi", "r8", "r9", "r10", "r11", "r12", "r13", "r14",
+		"r15", "rsp", "rbp", "rip", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4",
+		"xmm5", "xmm6", "xmm7", "xmm8", "xmm9", "xmm10", "xmm11", "xmm12",
+		"xmm13", "xmm14", "xmm15" };
+
+string register_name(register_type r)
+{
+	return register_names[r];
+}
+
+/* Returns the register named, or NR_REGISTERS. */
+static register_type find_register(const string &name)
+{
+	for (int r = 0; r < NR_REGISTERS; r++) {
+		if (name == register_names[r]) {
+			return register_type(r);
+		}
+	}
+	return NR_REGISTERS;
+}
+
+/* Reads a whole string as a decimal integer. */
+static bool read_integer(const string &s, long *value)
+{
+	char *end;
+
+	if (s.empty() || (s[0] != '-' && !isdigit(s[0]))) {
+		return false;
+	}
+	*value = strtol(s.c_str(), &end, 10);
+	return *end == '\0';
+}
+
+operand::operand(operand_kind kind, register_type reg, long value) :
+	kind(kind),
+	reg(reg),
+	value(value),
+	label(false),
+	qword(false)
+{
+}
+
+/* Operands are the same if they are written the same, but for whether
+ memory operands are written with their size. */
+bool operand::operator==(const operand &o) const
+{
+	return kind == o.kind && reg == o.reg && value == o.value
+			&& label == o.label && name == o.name;
+}
+
+/* Reads an operand as the code generator writes them. Returns false if it
+ is a memory operand not understood. */
+static bool read_operand(string s, operand &o)
+{
+	long value;
+
+	if (s.compare(0, 10, "qword ptr ") == 0) {
+		s = s.substr(10);
+		o.qword = true;
+	}
+	if (s[0] == '[' && s[s.size() - 1] == ']') {
+		s = s.substr(1, s.size() - 2);
+		size_t sign = s.find_first_of("+-");
+		o.kind = OPERAND_MEMORY;
+		o.reg = find_register(s.substr(0, sign));
+		o.value = 0;
+		if (o.reg == NR_REGISTERS) {
+			return false;
+		}
+		if (sign == string::npos) {
+			return true;
+		}
+		if (s.compare(sign, 2, "+L") == 0) {
+			o.label = true;
+			return read_integer(s.substr(sign + 2), &o.value);
+		}
+		return read_integer(s.substr(s[sign] == '+' ? sign + 1 : sign),
+				&o.value);
+	}
+	if (o.qword) {
+		return false;
+	}
+	if (s.compare(0, 3, "ST(") == 0 && s[s.size() - 1] == ')'
+			&& read_integer(s.substr(3, s.size() - 4), &value)) {
+		o.kind = OPERAND_FPU;
+		o.value = value;
+	} else if (s[0] == 'L' && read_integer(s.substr(1), &value)) {
+		o.kind = OPERAND_LABEL;
+		o.value = value;
+	} else if (read_integer(s, &value)) {
+		o.kind = OPERAND_IMMEDIATE;
+		o.value = value;
+	} else if (find_register(s) != NR_REGISTERS) {
+		o.kind = OPERAND_REGISTER;
+		o.reg = find_register(s);
+	} else {
+		o.kind = OPERAND_NAME;
+		o.name = s;
+	}
+	return true;
+}
+
+ostream &operator<<(ostream &o, const operand &a)
+{
+	switch (a.kind) {
+	case OPERAND_REGISTER:
+		return o << register_names[a.reg];
+	case OPERAND_IMMEDIATE:
+		return o << a.value;
+	case OPERAND_MEMORY:
+		if (a.qword) {
+			o << "qword ptr ";
+		}
+		o << "[" << register_names[a.reg];
+		if (a.label) {
+			o << "+L" << a.value;
+		} else if (a.value > 0) {
+			o << "+" << a.value;
+		} else if (a.value < 0) {
+			o << a.value;
+		}
+		return o << "]";
+	case OPERAND_LABEL:
+		return o << "L" << a.value;
+	case OPERAND_FPU:
+		return o << "ST(" << a.value << ")";
+	case OPERAND_NAME:
+		return o << a.name;
+	}
+	return o;
+}
+
+instruction::instruction(line_kind kind) :
+	kind(kind),
+	label(-1),
+	indented(false)
+{
+}
+
+/* Returns true for an instruction with a mnemonic and number of operands. */
+bool instruction::is(const string &mnemonic, int count) const
+{
+	return kind == LINE_INSTRUCTION && op == mnemonic
+			&& (int) operands.size() == count;
+}
+
+/* Reads a line of assembler code. Instructions are written after two tabs,
+ with a tab between the mnemonic and the operands, and labels at the start
+ of the line or after two tabs, maybe followed by a comment. An indented
+ line that is not read back is fatal, so that code the peephole optimizer
+ cannot see is not passed over in silence. */
+static instruction read_line(const string &line)
+{
+	instruction text(LINE_TEXT);
+	string s = line;
+	long value;
+
+	text.text = line;
+	bool indented = s.compare(0, 2, "\t\t") == 0;
+	if (indented) {
+		s = s.substr(2);
+	}
+	if (s.empty() || s[0] == '\t' || s[0] == '#') {
+		return text;
+	}
+
+	size_t colon = s.find(':');
+	if (s[0] == 'L' && colon != string::npos
+			&& read_integer(s.substr(1, colon - 1), &value)) {
+		instruction label(LINE_LABEL);
+		label.label = value;
+		label.indented = indented;
+		label.text = s.substr(colon + 1);
+		size_t comment = label.text.find_first_not_of('\t');
+		if (comment != string::npos && label.text[comment] != '#') {
+			if (indented) {
+				fatal("could not read back the line " + line);
+			}
+			return text;
+		}
+		return label;
+	}
+	if (!indented) {
+		return text;
+	}
+
+	instruction ins(LINE_INSTRUCTION);
+	size_t tab = s.find('\t');
+	ins.op = s.substr(0, tab);
+	if (tab == string::npos) {
+		return ins;
+	}
+	s = s.substr(tab + 1);
+	tab = s.find('\t');
+	if (tab != string::npos) {
+		ins.text = s.substr(tab);
+		s = s.substr(0, tab);
+	}
+	while (true) {
+		size_t comma = s.find(", ");
+		operand o(OPERAND_NAME, NR_REGISTERS, 0);
+		if (!read_operand(s.substr(0, comma), o)) {
+			fatal("could not read back the line " + line);
+		}
+		ins.operands.push_back(o);
+		if (comma == string::npos) {
+			break;
+		}
+		s = s.substr(comma + 2);
+	}
+	return ins;
+}
+
+ostream &operator<<(ostream &o, const instruction &ins)
+{
+	switch (ins.kind) {
+	case LINE_INSTRUCTION:
+		o << "\t\t" << ins.op;
+		for (unsigned int i = 0; i < ins.operands.size(); i++) {
+			o << (i == 0 ? "\t" : ", ") << ins.operands[i];
+		}
+		break;
+	case LINE_LABEL:
+		o << (ins.indented ? "\t\t" : "") << "L" << ins.label << ":";
+		break;
+	case LINE_TEXT:
+		break;
+	}
+	return o << ins.text;
+}
+
+instruction_list::instruction_list(const string &code)
+{
+	istringstream in(code);
+	string line;
+
+	while (getline(in, line)) {
+		lines.push_back(read_line(line));
+	}
+}
+
+int instruction_list::size()
+{
+	return lines.size();
+}
+
+instruction &instruction_list::get(int i)
+{
+	return lines[i];
+}
+
+ostream &operator<<(ostream &o, instruction_list &code)
+{
+	for (int i = 0; i < code.size(); i++) {
+		o << code.get(i) << "\n";
+	}
+	return o;
+}
+
+/* Returns true for a line that isn't code, like a trace comment. */
+bool instruction_list::comment(int i)
+{
+	const string &text = lines[i].text;
+	return lines[i].kind == LINE_TEXT && (text.compare(0, 2, "\t\t") != 0
+			|| text.size() == 2 || text[2] == '#');
+}
+
+/* Returns the index of the line of code after line i, or the size of the
+ list. */
+int instruction_list::next(int i)
+{
+	for (i++; i < size() && comment(i); i++)
+		;
+	return i;
+}
+
+static bool conditional_jump(const instruction &ins)
+{
+	return ins.kind == LINE_INSTRUCTION && ins.op[0] == 'j' && ins.op != "jmp";
+}
+
+/* Copies a register into another one, of any kind. */
+static instruction register_move(register_type dest, register_type src)
+{
+	instruction move(LINE_INSTRUCTION);
+	move.op = dest < XMM0 && src < XMM0 ? "mov"
+			: dest >= XMM0 && src >= XMM0 ? "movapd" : "movq";
+	move.operands.push_back(operand(OPERAND_REGISTER, dest, 0));
+	move.operands.push_back(operand(OPERAND_REGISTER, src, 0));
+	return move;
+}
+
+/* Returns true for a load of a register from memory, or a store of one into
+ memory. */
+static bool load(const instruction &ins)
+{
+	return (ins.is("mov", 2) || ins.is("movsd", 2))
+			&& ins.operands[0].kind == OPERAND_REGISTER
+			&& ins.operands[1].kind == OPERAND_MEMORY;
+}
+
+static bool store(const instruction &ins)
+{
+	return (ins.is("mov", 2) || ins.is("movsd", 2))
+			&& ins.operands[0].kind == OPERAND_MEMORY
+			&& ins.operands[1].kind == OPERAND_REGISTER;
+}
+
+/* Returns true for a move from one register to another of the same kind. */
+static bool register_copy(const instruction &ins)
+{
+	return (ins.is("mov", 2) || ins.is("movapd", 2))
+			&& ins.operands[0].kind == OPERAND_REGISTER
+			&& ins.operands[1].kind == OPERAND_REGISTER;
+}
+
+static register_set bit(register_type r)
+{
+	return 1UL << r;
+}
+
+static const register_set all_registers = (1UL << NR_REGISTERS) - 1;
+
+/* Finds the registers an instruction reads and those it may change. Calls
+ are taken to read and change all of them, and a return to read those which
+ hold the value returned or must be kept for the caller. */
+static void effects(const instruction &ins, register_set &read,
+		register_set &written)
+{
+	const string &op = ins.op;
+	const vector<operand> &args = ins.operands;
+
+	read = 0;
+	written = 0;
+	for (unsigned int a = 0; a < args.size(); a++) {
+		if (args[a].kind == OPERAND_MEMORY) {
+			read |= bit(args[a].reg);
+		}
+	}
+
+	if (op == "call") {
+		read = written = all_registers;
+	} else if (op == "ret") {
+		read |= bit(RAX) | bit(XMM0) | bit(RBX) | bit(R12) | bit(R13)
+				| bit(R14) | bit(R15) | bit(RSP) | bit(RBP);
+		written |= bit(RSP);
+	} else if (op == "leave") {
+		read |= bit(RBP);
+		written |= bit(RSP) | bit(RBP);
+	} else if (op == "push" || op == "pop") {
+		read |= bit(RSP);
+		written |= bit(RSP);
+		if (!args.empty() && args[0].kind == OPERAND_REGISTER) {
+			(op == "push" ? read : written) |= bit(args[0].reg);
+		}
+	} else if (op == "cqo") {
+		read |= bit(RAX);
+		written |= bit(RDX);
+	} else if (op == "idiv" || (op == "imul" && args.size() == 1)) {
+		read |= bit(RAX) | bit(RDX);
+		written |= bit(RAX) | bit(RDX);
+		for (unsigned int a = 0; a < args.size(); a++) {
+			if (args[a].kind == OPERAND_REGISTER) {
+				read |= bit(args[a].reg);
+			}
+		}
+	} else if (op[0] == 'j' || op[0] == '.') {
+		// Jumps only read the flags.
+	} else {
+		// The first operand is changed, and read unless it is just set.
+		bool set = op == "mov" || op == "movq" || op == "movapd"
+				|| op == "movsd" || op == "lea" || args.size() == 3;
+		bool compare = op == "cmp" || op == "test" || op == "ucomisd";
+		for (unsigned int a = 0; a < args.size(); a++) {
+			if (args[a].kind != OPERAND_REGISTER) {
+				continue;
+			}
+			if (a == 0 && !compare) {
+				written |= bit(args[a].reg);
+			}
+			if (a > 0 || !set) {
+				read |= bit(args[a].reg);
+			}
+		}
+	}
+}
+
+/* Finds the registers which may be read after each line before they are
+ changed. */
+void instruction_list::find_live(vector<register_set> &live_out)
+{
+	map<long, int> labels;
+	vector<register_set> live_in(size(), 0);
+	bool changed = true;
+
+	for (int i = 0; i < size(); i++) {
+		if (lines[i].kind == LINE_LABEL) {
+			labels[lines[i].label] = i;
+		}
+	}
+	live_out.assign(size(), 0);
+	while (changed) {
+		changed = false;
+		for (int i = size() - 1; i >= 0; i--) {
+			instruction &ins = lines[i];
+			register_set out = 0;
+			register_set read = 0;
+			register_set written = 0;
+
+			if (ins.kind == LINE_INSTRUCTION && !ins.operands.empty()
+					&& ins.operands[0].kind == OPERAND_LABEL
+					&& ins.op[0] == 'j') {
+				out = labels.find(ins.operands[0].value) == labels.end()
+						? all_registers : live_in[labels[ins.operands[0].value]];
+			}
+			if (!ins.is("jmp", 1) && !ins.is("ret", 0) && i + 1 < size()) {
+				out |= live_in[i + 1];
+			}
+			if (ins.kind == LINE_INSTRUCTION) {
+				effects(ins, read, written);
+			} else if (!comment(i) && ins.kind == LINE_TEXT) {
+				read = all_registers;
+			}
+			register_set in = read | (out & ~written);
+			if (in != live_in[i] || out != live_out[i]) {
+				live_in[i] = in;
+				live_out[i] = out;
+				changed = true;
+			}
+		}
+	}
+}
+
+/* Removes a move of a register into itself. */
+bool instruction_list::self_move(int i)
+{
+	if (!register_copy(lines[i])
+			|| lines[i].operands[0].reg != lines[i].operands[1].reg) {
+		return false;
+	}
+	lines.erase(lines.begin() + i);
+	return true;
+}
+
+/* Removes a jump to the label right after it. */
+bool instruction_list::jump_to_next(int i)
+{
+	if (!(lines[i].is("jmp", 1) || conditional_jump(lines[i]))
+			|| lines[i].operands[0].kind != OPERAND_LABEL) {
+		return false;
+	}
+	for (int j = next(i); j < size() && lines[j].kind == LINE_LABEL;
+			j = next(j)) {
+		if (lines[j].label == lines[i].operands[0].value) {
+			lines.erase(lines.begin() + i);
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Replaces the load of what was just stored by a register move, or removes
+ it if it is into the register stored. */
+bool instruction_list::store_reload(int i)
+{
+	int j = next(i);
+
+	if (!store(lines[i]) || j == size() || !load(lines[j])
+			|| lines[j].operands[1] != lines[i].operands[0]) {
+		return false;
+	}
+	register_type src = lines[i].operands[1].reg;
+	register_type dest = lines[j].operands[0].reg;
+	if (src == dest) {
+		lines.erase(lines.begin() + j);
+	} else {
+		string text = lines[j].text;
+		lines[j] = register_move(dest, src);
+		lines[j].text = text;
+	}
+	return true;
+}
+
+/* Removes a load into a register already holding what is loaded, or a move
+ between two registers holding the same. What each register holds is the
+ line it was last loaded, stored or copied by, tracked from the label
+ before; given is that, up to line i. Stores may change any memory, except
+ for the slots of the display or static link, whose number is given. */
+bool instruction_list::redundant_load(int i, int display,
+		vector<int> &given)
+{
+	instruction &ins = lines[i];
+	register_set read;
+	register_set written;
+
+	if (ins.kind == LINE_LABEL || (ins.kind == LINE_TEXT && !comment(i))) {
+		given.assign(NR_REGISTERS, -1);
+		return false;
+	}
+	if (ins.kind != LINE_INSTRUCTION) {
+		return false;
+	}
+
+	if (load(ins)) {
+		register_type dest = ins.operands[0].reg;
+		if (given[dest] != -1 && !register_copy(lines[given[dest]])
+				&& lines[given[dest]].operands[store(lines[given[dest]])
+				? 0 : 1] == ins.operands[1]) {
+			lines.erase(lines.begin() + i);
+			return true;
+		}
+	}
+	if (register_copy(ins)) {
+		register_type dest = ins.operands[0].reg;
+		register_type src = ins.operands[1].reg;
+		if ((given[dest] != -1 && register_copy(lines[given[dest]])
+				&& lines[given[dest]].operands[1].reg == src)
+				|| (given[src] != -1 && register_copy(lines[given[src]])
+				&& lines[given[src]].operands[1].reg == dest)) {
+			lines.erase(lines.begin() + i);
+			return true;
+		}
+	}
+
+	// Forget what the registers changed hold, and what is held by the
+	// registers they were loaded from, and what memory that is stored into
+	// may hold.
+	effects(ins, read, written);
+	bool stores = ins.op == "call" || (!ins.operands.empty()
+			&& ins.operands[0].kind == OPERAND_MEMORY && ins.op != "push");
+	for (int r = 0; r < NR_REGISTERS; r++) {
+		if (given[r] == -1) {
+			continue;
+		}
+		instruction &g = lines[given[r]];
+		const operand &held = g.operands[store(g) ? 0 : 1];
+		bool display_slot = held.kind == OPERAND_MEMORY && held.reg == RBP
+				&& !held.label && held.value < 0
+				&& held.value >= -STACK_WIDTH * display;
+		if ((written & (bit(register_type(r)) | bit(held.reg)))
+				|| (stores && held.kind == OPERAND_MEMORY && !display_slot)) {
+			given[r] = -1;
+		}
+	}
+
+	if ((load(ins) && ins.operands[1].reg != ins.operands[0].reg)
+			|| register_copy(ins)) {
+		given[ins.operands[0].reg] = i;
+	} else if (store(ins)) {
+		given[ins.operands[1].reg] = i;
+	}
+	return false;
+}
+
+/* Returns true for an instruction which leaves the flags alone. */
+static bool keeps_flags(const instruction &ins)
+{
+	const string &op = ins.op;
+	return op == "mov" || op == "movq" || op == "movsd" || op == "movapd"
+			|| op == "lea" || op == "push" || op == "pop";
+}
+
+/* Removes a compare of a register with 0 when the flags are already set by
+ the last instruction changing the register. The conditional jumps after it
+ must only test for zero, or sign, unless the instruction also clears the
+ overflow and carry flags. */
+bool instruction_list::redundant_compare(int i)
+{
+	if (!lines[i].is("cmp", 2)
+			|| lines[i].operands[0].kind != OPERAND_REGISTER
+			|| lines[i].operands[1].kind != OPERAND_IMMEDIATE
+			|| lines[i].operands[1].value != 0) {
+		return false;
+	}
+	register_type r = lines[i].operands[0].reg;
+
+	int k;
+	for (k = i - 1; k >= 0; k--) {
+		if (comment(k)) {
+			continue;
+		}
+		if (lines[k].kind != LINE_INSTRUCTION) {
+			return false;
+		}
+		register_set read;
+		register_set written;
+		effects(lines[k], read, written);
+		if ((written & bit(r)) || !keeps_flags(lines[k])) {
+			break;
+		}
+	}
+	if (k < 0 || lines[k].operands.empty()
+			|| lines[k].operands[0].kind != OPERAND_REGISTER
+			|| lines[k].operands[0].reg != r) {
+		return false;
+	}
+	const string &op = lines[k].op;
+	bool logic = op == "and" || op == "or" || op == "xor";
+	if (!logic && op != "add" && op != "sub" && op != "neg") {
+		return false;
+	}
+
+	int j;
+	for (j = next(i); j < size() && conditional_jump(lines[j]); j = next(j)) {
+		const string &jump = lines[j].op;
+		if (!logic && jump != "je" && jump != "jne" && jump != "js"
+				&& jump != "jns") {
+			return false;
+		}
+	}
+	if (j == next(i)) {
+		return false;
+	}
+	lines.erase(lines.begin() + i);
+	return true;
+}
+
+/* Makes the instruction after a move of a register, integer or memory
+ operand into a general register read the operand itself rather than the
+ register, if it can. The move may then be removed, see dead_move(). */
+bool instruction_list::forward_copy(int i)
+{
+	int j = next(i);
+
+	if (!lines[i].is("mov", 2) || lines[i].operands[0].kind != OPERAND_REGISTER
+			|| j == size() || lines[j].kind != LINE_INSTRUCTION) {
+		return false;
+	}
+	register_type r = lines[i].operands[0].reg;
+	const operand &src = lines[i].operands[1];
+	instruction &use = lines[j];
+	const string &op = use.op;
+	unsigned int a = use.is("push", 1) ? 0 : 1;
+
+	if (!use.is("push", 1) && !((op == "mov" || op == "add" || op == "sub"
+			|| op == "cmp" || op == "and" || op == "or" || op == "xor"
+			|| op == "imul" || op == "test") && use.operands.size() == 2)) {
+		return false;
+	}
+	if (use.operands[a].kind != OPERAND_REGISTER || use.operands[a].reg != r
+			|| use.operands[a] == src) {
+		return false;
+	}
+	bool fits = src.value >= -2147483648L && src.value <= 2147483647L;
+	switch (src.kind) {
+	case OPERAND_REGISTER:
+		if (src.reg >= XMM0 || src.reg == RIP) {
+			return false;
+		}
+		break;
+	case OPERAND_IMMEDIATE:
+		if (!fits && !(op == "mov"
+				&& use.operands[0].kind == OPERAND_REGISTER)) {
+			return false;
+		}
+		break;
+	case OPERAND_MEMORY:
+		if (src.reg == r
+				|| (a == 1 && use.operands[0].kind != OPERAND_REGISTER)) {
+			return false;
+		}
+		break;
+	default:
+		return false;
+	}
+	use.operands[a] = src;
+	if (use.operands[0].kind == OPERAND_MEMORY
+			&& (a == 0 || src.kind == OPERAND_IMMEDIATE)) {
+		// The size is no longer given by a register.
+		use.operands[0].qword = true;
+	}
+	return true;
+}
+
+void instruction_list::peephole(int display)
+{
+	bool changed = true;
+
+	while (changed) {
+		changed = false;
+		for (int i = 0; i < size(); i++) {
+			if (self_move(i) || jump_to_next(i) || store_reload(i)
+					|| redundant_compare(i)
+					|| forward_copy(i)) {
+				changed = true;
+			}
+		}
+
+		vector<int> given(NR_REGISTERS, -1);
+		for (int i = 0; i < size(); i++) {
+			if (redundant_load(i, display, given)) {
+				changed = true;
+				i--;
+			}
+		}
+
+		// Remove the moves into registers not read before they change
+		// again, last first so that the liveness found stays right.
+		vector<register_set> live_out;
+		find_live(live_out);
+		for (int i = size() - 1; i >= 0; i--) {
+			const instruction &ins = lines[i];
+			if (ins.kind == LINE_INSTRUCTION && (ins.op == "mov"
+					|| ins.op == "movq" || ins.op == "movapd"
+					|| ins.op == "movsd" || ins.op == "lea")
+					&& ins.operands.size() == 2
+					&& ins.operands[0].kind == OPERAND_REGISTER
+					&& ins.operands[0].reg != RSP && ins.operands[0].reg != RBP
+					&& !(live_out[i] & bit(ins.operands[0].reg))) {
+				lines.erase(lines.begin() + i);
+				changed = true;
+			}
+		}
+	}
+}
@@ -0,0 +1,126 @@
+#ifndef __MACHINE_HH__
+#define __MACHINE_HH__
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "codegen.hh"
+
+using namespace std;
+
+/*** The machine instructions of a procedure. The code generator writes the
+ assembler code of each procedure as text, which is read back into a list of
+ instructions with their operands, improved by a peephole optimizer from
+ optimization level 1 and printed to the assembler file. Lines which aren't
+ instructions or labels, like the trace comments, are kept as they are. ***/
+
+// Returns the name of a register in the assembler code.
+string register_name(register_type);
+
+/* The kinds of operands. */
+typedef enum {
+	OPERAND_REGISTER,   // A register.
+	OPERAND_IMMEDIATE,  // An integer.
+	OPERAND_MEMORY,     // [base+displacement] or [rip+Llabel].
+	OPERAND_LABEL,      // Llabel, the target of a jump or call.
+	OPERAND_FPU,        // ST(n), a register of the FPU stack.
+	OPERAND_NAME        // Anything else, like the section of a directive.
+} operand_kind;
+
+class operand
+{
+public:
+	operand_kind kind;
+
+	// The register, or the base register of a memory operand.
+	register_type reg;
+
+	// The integer, the displacement of a memory operand, the label number
+	// or the FPU register number.
+	long value;
+
+	// True for memory operands addressing a label rather than a
+	// displacement, and for those written with "qword ptr".
+	bool label;
+	bool qword;
+
+	string name;
+
+	operand(operand_kind, register_type, long);
+
+	bool operator==(const operand &) const;
+	bool operator!=(const operand &o) const {
+		return !(*this == o);
+	}
+};
+
+ostream &operator<<(ostream &, const operand &);
+
+/* The kinds of lines. */
+typedef enum {
+	LINE_INSTRUCTION,   // An instruction or assembler directive.
+	LINE_LABEL,         // Llabel:
+	LINE_TEXT           // A comment, or anything else not understood.
+} line_kind;
+
+class instruction
+{
+public:
+	line_kind kind;
+
+	// The mnemonic or directive, and its operands.
+	string op;
+	vector<operand> operands;
+
+	// The label number, and whether it is indented like an instruction.
+	int label;
+	bool indented;
+
+	// The text following the instruction or label, like the name of the
+	// procedure called, or the whole line if it is text.
+	string text;
+
+	instruction(line_kind);
+
+	bool is(const string &, int) const;
+};
+
+ostream &operator<<(ostream &, const instruction &);
+
+// A set of registers, one bit each.
+typedef unsigned long register_set;
+
+class instruction_list
+{
+private:
+	vector<instruction> lines;
+
+	bool comment(int);
+	int next(int);
+	void find_live(vector<register_set> &);
+	bool self_move(int);
+	bool jump_to_next(int);
+	bool store_reload(int);
+	bool redundant_load(int, int, vector<int> &);
+	bool redundant_compare(int);
+	bool forward_copy(int);
+
+public:
+	// Reads the lines of assembler code written by the code generator.
+	instruction_list(const string &);
+
+	int size();
+	instruction &get(int);
+
+	// Runs the peephole optimizer until it finds nothing more to do. The
+	// argument is the number of slots right below RBP holding the display
+	// or static link, which the code stores nothing into.
+	void peephole(int);
+
+	friend ostream &operator<<(ostream &, instruction_list &);
+};
+
+ostream &operator<<(ostream &, instruction_list &);
+
+#endif
@@ -5,6 +5,8 @@
 #include <unistd.h>
 
 #include "ast.hh"
+#include "codegen.hh"
+#include "inline.hh"
 #include "parser.hh"
 
 using namespace std;
@@ -14,22 +16,62 @@ extern bool yydebug;
 bool assembler_trace = false;
 bool print_ast = false;
 bool print_quads = false;
+bool print_cfg = false;
 bool typecheck = true;
 bool optimize = true;
+int optimize_level = 0;
+bool static_links = false;
 bool quads = true;
 bool assembler = true;
+bool object_code = false;
+bool executable_code = false;
 
 void usage(char *program_name)
 {
     cerr << "Usage:\n"
-         << program_name << " [-acdfpqsty] inputfile\n"
+         << program_name << " [-abcdefglpqsty] [-O level] [-i size] [-o outfile]"
+         << " inputfile\n"
          << program_name << " [-h?]\n"
          << "Options:\n"
          << "  -h, -?            Shows this message.\n"
          << "  -a                Print AST (abstract syntax tree).\n"
+         << "  -b                Write an ELF object file rather than\n"
+         << "                    assembler code.\n"
          << "  -c                Disable type checking.\n"
          << "  -d                Turn on parser debugging.\n"
+         << "  -e                Write a static ELF executable, which needs\n"
+         << "                    neither linking nor the C library, rather\n"
+         << "                    than assembler code.\n"
          << "  -f                Don't optimize.\n"
+         << "  -g                Print control flow graphs.\n"
+         << "  -O level          Optimization level. 0 (default) gives output\n"
+         << "                    matching the trace files, 1 also propagates\n"
+         << "                    declared constants, folds relations, unary\n"
+         << "                    operators and casts, simplifies algebraic\n"
+         << "                    identities, turns multiplication, div and mod\n"
+         << "                    by powers of two into shifts and masks, does\n"
+         << "                    other constant divisions by multiplication,\n"
+         << "                    removes if and while branches that can never\n"
+         << "                    be taken, and jumps on relations, and, or and\n"
+         << "                    not in conditions as soon as the result is\n"
+         << "                    known, computes reals with SSE instead of\n"
+         << "                    the x87 FPU, and sets up no frame for\n"
+         << "                    procedures calling nothing. 2 also inlines\n"
+         << "                    small procedures and functions, and removes\n"
+         << "                    common subexpressions, repeated array loads,\n"
+         << "                    copies, unreachable code and unused results\n"
+         << "                    from the quads, moves loop invariant quads out\n"
+         << "                    of loops, steps addresses through arrays\n"
+         << "                    indexed by induction variables, keeps\n"
+         << "                    variables in registers, and passes arguments\n"
+         << "                    in registers. 3 also propagates constants\n"
+         << "                    through variables and branches in SSA form.\n"
+         << "  -i size           Only inline bodies of at most size AST nodes\n"
+         << "                    (default 40). 0 turns inlining off.\n"
+         << "  -l                Link frames by static links instead of\n"
+         << "                    copying the display on each call.\n"
+         << "  -o outfile        Write the assembler code, object file or\n"
+         << "                    executable to outfile rather than d.out.\n"
          << "  -p                Don't generate quads.\n"
          << "  -q                Print quad lists.\n"
          << "  -s                Don't generate assembler code.\n"
@@ -41,7 +83,7 @@ void usage(char *program_name)
 
 int main(int argc, char **argv)
 {
-    char options[] = "acdfpqstyh?";
+    char options[] = "abcdefgO:i:lo:pqstyh?";
     int option;
     bool print_symtab = false;
 
@@ -57,6 +99,10 @@ int main(int argc, char **argv)
             cout << "An AST will be printed for each block.\n" << flush;
             print_ast = true;
             break;
+        case 'b':
+            cout << "An object file will be written.\n" << flush;
+            object_code = true;
+            break;
         case 'c':
             cout << "No type checking will be performed.\n" << flush;
             typecheck = false;
@@ -65,10 +111,39 @@ int main(int argc, char **argv)
             cout << "Bison debugging turned on.\n" << flush;
             yydebug = true;
             break;
+        case 'e':
+            cout << "An executable will be written.\n" << flush;
+            object_code = true;
+            executable_code = true;
+            break;
         case 'f':
             cout << "No optimization will be done.\n" << flush;
             optimize = false;
             break;
+        case 'g':
+            cout << "A control flow graph will be printed for each block.\n"
+                 << flush;
+            print_cfg = true;
+            break;
+        case 'O':
+            optimize_level = atoi(optarg);
+            if (optimize_level < 0) {
+                usage(argv[0]);
+            }
+            cout << "Optimization level " << optimize_level << ".\n" << flush;
+            break;
+        case 'i':
+            inliner->threshold = atoi(optarg);
+            cout << "Inlining threshold " << inliner->threshold << ".\n"
+                 << flush;
+            break;
+        case 'l':
+            cout << "Frames will be linked by static links.\n" << flush;
+            static_links = true;
+            break;
+        case 'o':
+            code_gen->object_file_name = optarg;
+            break;
         case 'p':
             cout << "No quads will be generated.\n" << flush;
             quads = false;
@@ -123,6 +198,9 @@ int main(int argc, char **argv)
         sym_tab->print(1);
     }
 
+    // Write the rest of the assembler code.
+    delete code_gen;
+
     exit(error_count);
 }
 
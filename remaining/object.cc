@@ -0,0 +1,899 @@
+#include <elf.h>
+#include <string.h>
+#include <map>
+#include <sstream>
+
+#include "object.hh"
+#include "error.hh"
+
+/*** This file contains the encoding of machine instructions and the writing
+ of the object file, see object.hh. The encodings are the ones GNU as picks
+ for the same assembler code, with jumps as short as they can be. ***/
+
+/* The run-time support, as in diesel_glue.s, which goes first in the
+ program. Its start is main in an object file, and the entry point of an
+ executable. The control words are read and written through a quadword, of
+ which fnstcw, fldcw, stmxcsr and ldmxcsr only touch the low bytes. */
+static const char *startup_support =
+		"\t\tenter\t8, 0\n"
+		"\t\tfnstcw\t[rbp-8]\n"
+		"\t\tor\tqword ptr [rbp-8], 3072\n"
+		"\t\tfldcw\t[rbp-8]\n"
+		"\t\tstmxcsr\t[rbp-8]\n"
+		"\t\tor\tqword ptr [rbp-8], 24576\n"
+		"\t\tldmxcsr\t[rbp-8]\n"
+		"\t\tleave\n"
+		"\t\tenter\t0, 0\n"
+		"\t\tcall\tL3\n"
+		"\t\tleave\n";
+
+/* Returning from main, and reading and writing characters by the C library
+ and diesel_rts.c, in an object file. The int getchar() returns is sign
+ extended, so that the end of the input is -1 as in an executable. */
+static const char *library_support =
+		"\t\tmov\trax, 0\n"
+		"\t\tret\n"
+		"L0:\n"
+		"\t\tcall\tgetchar\n"
+		"\t\tcdqe\n"
+		"\t\tret\n"
+		"L1:\n"
+		"\t\tmov\trdi, qword ptr [rsp+8]\n"
+		"\t\tcall\tmyputchar\n"
+		"\t\tret\n";
+
+/* Exiting, and reading and writing characters by system calls, in an
+ executable. A character is read into a quadword on the stack, which is -1
+ unless one was read. The character written is the low byte of the argument.
+ Writes aren't buffered, like those of myputchar(). */
+static const char *system_support =
+		"\t\tmov\trax, 60\n"
+		"\t\tmov\trdi, 0\n"
+		"\t\tsyscall\n"
+		"L0:\n"
+		"\t\tpush\t0\n"
+		"\t\tmov\trax, 0\n"
+		"\t\tmov\trdi, 0\n"
+		"\t\tmov\trsi, rsp\n"
+		"\t\tmov\trdx, 1\n"
+		"\t\tsyscall\n"
+		"\t\tmov\trcx, -1\n"
+		"\t\tcmp\trax, 1\n"
+		"\t\tpop\trax\n"
+		"\t\tcmovne\trax, rcx\n"
+		"\t\tret\n"
+		"L1:\n"
+		"\t\tmov\trax, 1\n"
+		"\t\tmov\trdi, 1\n"
+		"\t\tlea\trsi, [rsp+8]\n"
+		"\t\tmov\trdx, 1\n"
+		"\t\tsyscall\n"
+		"\t\tret\n";
+
+static const char *trunc_support =
+		"L2:\n"
+		"\t\tcvttsd2si\trax, qword ptr [rsp+8]\n"
+		"\t\tret\n";
+
+/* Where an executable is loaded, and the size of its pages. */
+static const long EXECUTABLE_BASE = 0x400000;
+static const long PAGE_SIZE = 0x1000;
+
+/* The number of each register in the instruction encodings. */
+static const int register_numbers[NR_REGISTERS] = { 0, 1, 2, 3, 6, 7, 8, 9,
+		10, 11, 12, 13, 14, 15, 4, 5, -1, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11,
+		12, 13, 14, 15 };
+
+/* The sections of the object file, in the order of their section headers. */
+typedef enum {
+	SECTION_NULL,
+	SECTION_TEXT,
+	SECTION_RELA_TEXT,
+	SECTION_DATA,
+	SECTION_RODATA,
+	SECTION_NOTE,
+	SECTION_SYMTAB,
+	SECTION_STRTAB,
+	SECTION_SHSTRTAB,
+	NR_SECTIONS
+} section_type;
+
+static const char *section_names[NR_SECTIONS] = { "", ".text", ".rela.text",
+		".data", ".rodata", ".note.GNU-stack", ".symtab", ".strtab",
+		".shstrtab" };
+
+/* The symbols for the sections code and data refer to, and the first global
+ symbol, main. */
+static const int SYMBOL_TEXT = 1;
+static const int SYMBOL_DATA = 2;
+static const int SYMBOL_RODATA = 3;
+static const int SYMBOL_MAIN = 4;
+
+/* What the displacement of an instruction refers to. */
+typedef enum {
+	REFERENCE_NONE,
+	REFERENCE_LABEL,    // A label, relative to the end of the instruction.
+	REFERENCE_NAME      // A procedure outside of the program.
+} reference_kind;
+
+/* The machine code of a line. */
+class encoding
+{
+public:
+	vector<unsigned char> bytes;
+
+	// The displacement to fill in, where it is and its size.
+	reference_kind reference;
+	int position;
+	int size;
+	long label;
+	string name;
+
+	// The alignment asked for by .align, or 0.
+	int align;
+
+	encoding() :
+		reference(REFERENCE_NONE),
+		position(0),
+		size(0),
+		label(0),
+		align(0)
+	{
+	}
+
+	void byte(int b) {
+		bytes.push_back(b);
+	}
+
+	// Appends an integer of a size in bytes, least significant byte first.
+	void integer(long value, int size) {
+		for (int i = 0; i < size; i++) {
+			bytes.push_back((value >> (8 * i)) & 0xff);
+		}
+	}
+
+	// Appends a displacement to fill in when the program is laid out.
+	void displacement(reference_kind kind, int displacement_size) {
+		reference = kind;
+		position = bytes.size();
+		size = displacement_size;
+		integer(0, displacement_size);
+	}
+};
+
+static bool fits_byte(long value)
+{
+	return value >= -128 && value <= 127;
+}
+
+static bool fits_int(long value)
+{
+	return value >= -2147483648L && value <= 2147483647L;
+}
+
+static bool general(const operand &o)
+{
+	return o.kind == OPERAND_REGISTER && o.reg < XMM0 && o.reg != RIP;
+}
+
+static bool sse(const operand &o)
+{
+	return o.kind == OPERAND_REGISTER && o.reg >= XMM0;
+}
+
+static bool memory(const operand &o)
+{
+	return o.kind == OPERAND_MEMORY;
+}
+
+static bool immediate(const operand &o)
+{
+	return o.kind == OPERAND_IMMEDIATE;
+}
+
+static int number(const operand &o)
+{
+	return register_numbers[o.reg];
+}
+
+/* Appends an instruction addressing a register or memory operand by a ModRM
+ byte: a mandatory prefix unless 0, a REX prefix when needed, the opcode and
+ the ModRM byte with reg in its reg field, followed by a SIB byte and the
+ displacement if needed. */
+static void modrm(encoding &e, int prefix, bool wide, const vector<int> &opcode,
+		int reg, const operand &rm)
+{
+	int base = rm.label ? 0 : number(rm);
+	int rex = (wide ? 8 : 0) | (reg & 8 ? 4 : 0) | (base & 8 ? 1 : 0);
+
+	if (prefix != 0) {
+		e.byte(prefix);
+	}
+	if (rex != 0) {
+		e.byte(0x40 | rex);
+	}
+	for (unsigned int i = 0; i < opcode.size(); i++) {
+		e.byte(opcode[i]);
+	}
+	reg = (reg & 7) << 3;
+	base &= 7;
+
+	if (rm.kind == OPERAND_REGISTER) {
+		e.byte(0xc0 | reg | base);
+	} else if (rm.label) {
+		e.byte(0x05 | reg);
+		e.label = rm.value;
+		e.displacement(REFERENCE_LABEL, 4);
+	} else if (rm.value == 0 && base != 5) {
+		e.byte(reg | base);
+		if (base == 4) {
+			e.byte(0x24);
+		}
+	} else {
+		bool small = fits_byte(rm.value);
+		e.byte((small ? 0x40 : 0x80) | reg | base);
+		if (base == 4) {
+			e.byte(0x24);
+		}
+		e.integer(rm.value, small ? 1 : 4);
+	}
+}
+
+/* An instruction taking an operation from the reg field of its ModRM byte. */
+static void modrm(encoding &e, int prefix, bool wide, const vector<int> &opcode,
+		int reg, const operand &rm, long value, int size)
+{
+	modrm(e, prefix, wide, opcode, reg, rm);
+	e.integer(value, size);
+}
+
+/* The arithmetic operations with the same encodings, by the number they
+ have in the reg field of their ModRM byte. */
+static const char *arithmetic[] = { "add", "or", "adc", "sbb", "and", "sub",
+		"xor", "cmp", NULL };
+
+/* The conditional jumps, by their condition code. */
+static const char *conditions[] = { "jo", "jno", "jb", "jae", "je", "jne",
+		"jbe", "ja", "js", "jns", "jp", "jnp", "jl", "jge", "jle", "jg", NULL };
+
+/* The shifts, by the number they have in the reg field. */
+static const char *shifts[] = { "rol", "ror", "rcl", "rcr", "shl", "shr",
+		"sal", "sar", NULL };
+
+static int find(const char *table[], const string &op)
+{
+	for (int i = 0; table[i] != NULL; i++) {
+		if (op == table[i]) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/* Encodes a line, with a jump to a label by a 32-bit displacement if long
+ is true, or an 8-bit displacement. Returns false for instructions which
+ the code generator doesn't produce. Directives only set the alignment or
+ give data, the sections are found by object_file::write(). */
+static bool encode(const instruction &ins, bool long_jump, encoding &e)
+{
+	const string &op = ins.op;
+	const vector<operand> &a = ins.operands;
+	int n = a.size();
+	int code;
+
+	if (ins.kind != LINE_INSTRUCTION) {
+		return false;
+	}
+	if (op == ".text" || op == ".data" || op == ".section") {
+		return true;
+	}
+	if (op == ".align" && n == 1 && immediate(a[0])) {
+		e.align = a[0].value;
+		return true;
+	}
+	if (op == ".quad" && n == 1 && immediate(a[0])) {
+		e.integer(a[0].value, 8);
+		return true;
+	}
+
+	if (op == "mov" && n == 2) {
+		if (general(a[0]) && general(a[1])) {
+			modrm(e, 0, true, {0x89}, number(a[1]), a[0]);
+		} else if (general(a[0]) && memory(a[1])) {
+			modrm(e, 0, true, {0x8b}, number(a[0]), a[1]);
+		} else if (memory(a[0]) && general(a[1])) {
+			modrm(e, 0, true, {0x89}, number(a[1]), a[0]);
+		} else if ((general(a[0]) || memory(a[0])) && immediate(a[1])
+				&& fits_int(a[1].value)) {
+			modrm(e, 0, true, {0xc7}, 0, a[0], a[1].value, 4);
+		} else if (general(a[0]) && immediate(a[1])) {
+			e.byte(number(a[0]) & 8 ? 0x49 : 0x48);
+			e.byte(0xb8 | (number(a[0]) & 7));
+			e.integer(a[1].value, 8);
+		} else {
+			return false;
+		}
+		return true;
+	}
+
+	if ((code = find(arithmetic, op)) != -1 && n == 2) {
+		if (general(a[1]) && (general(a[0]) || memory(a[0]))) {
+			modrm(e, 0, true, {8 * code + 1}, number(a[1]), a[0]);
+		} else if (general(a[0]) && memory(a[1])) {
+			modrm(e, 0, true, {8 * code + 3}, number(a[0]), a[1]);
+		} else if ((general(a[0]) || memory(a[0])) && immediate(a[1])
+				&& fits_int(a[1].value)) {
+			if (fits_byte(a[1].value)) {
+				modrm(e, 0, true, {0x83}, code, a[0], a[1].value, 1);
+			} else if (general(a[0]) && a[0].reg == RAX) {
+				e.byte(0x48);
+				e.byte(8 * code + 5);
+				e.integer(a[1].value, 4);
+			} else {
+				modrm(e, 0, true, {0x81}, code, a[0], a[1].value, 4);
+			}
+		} else {
+			return false;
+		}
+		return true;
+	}
+
+	if (op == "test" && n == 2 && general(a[1])
+			&& (general(a[0]) || memory(a[0]))) {
+		modrm(e, 0, true, {0x85}, number(a[1]), a[0]);
+		return true;
+	}
+
+	if (op == "imul") {
+		if (n == 1 && (general(a[0]) || memory(a[0]))) {
+			modrm(e, 0, true, {0xf7}, 5, a[0]);
+		} else if (n == 2 && general(a[0])
+				&& (general(a[1]) || memory(a[1]))) {
+			modrm(e, 0, true, {0x0f, 0xaf}, number(a[0]), a[1]);
+		} else if ((n == 2 || n == 3) && general(a[0])
+				&& (general(a[n - 2]) || memory(a[n - 2]))
+				&& immediate(a[n - 1]) && fits_int(a[n - 1].value)) {
+			long value = a[n - 1].value;
+			if (fits_byte(value)) {
+				modrm(e, 0, true, {0x6b}, number(a[0]), a[n - 2], value, 1);
+			} else {
+				modrm(e, 0, true, {0x69}, number(a[0]), a[n - 2], value, 4);
+			}
+		} else {
+			return false;
+		}
+		return true;
+	}
+
+	// The dividend is in RDX:RAX, and may be named as the first operand.
+	if ((op == "idiv" || op == "div" || op == "neg" || op == "not")
+			&& (n == 1 || (n == 2 && (op == "idiv" || op == "div")
+			&& general(a[0]) && a[0].reg == RAX))
+			&& (general(a[n - 1]) || memory(a[n - 1]))) {
+		code = op == "idiv" ? 7 : op == "div" ? 6 : op == "neg" ? 3 : 2;
+		modrm(e, 0, true, {0xf7}, code, a[n - 1]);
+		return true;
+	}
+
+	if ((code = find(shifts, op)) != -1 && n == 2
+			&& (general(a[0]) || memory(a[0])) && immediate(a[1])) {
+		if (a[1].value == 1) {
+			modrm(e, 0, true, {0xd1}, code, a[0]);
+		} else {
+			modrm(e, 0, true, {0xc1}, code, a[0], a[1].value, 1);
+		}
+		return true;
+	}
+
+	if (op == "btc" && n == 2 && (general(a[0]) || memory(a[0]))
+			&& immediate(a[1])) {
+		modrm(e, 0, true, {0x0f, 0xba}, 7, a[0], a[1].value, 1);
+		return true;
+	}
+
+	if (op == "lea" && n == 2 && general(a[0]) && memory(a[1])) {
+		modrm(e, 0, true, {0x8d}, number(a[0]), a[1]);
+		return true;
+	}
+
+	if ((op == "push" || op == "pop") && n == 1 && general(a[0])) {
+		if (number(a[0]) & 8) {
+			e.byte(0x41);
+		}
+		e.byte((op == "push" ? 0x50 : 0x58) | (number(a[0]) & 7));
+		return true;
+	}
+	if (op == "push" && n == 1 && immediate(a[0]) && fits_int(a[0].value)) {
+		if (fits_byte(a[0].value)) {
+			e.byte(0x6a);
+			e.integer(a[0].value, 1);
+		} else {
+			e.byte(0x68);
+			e.integer(a[0].value, 4);
+		}
+		return true;
+	}
+	if (op == "push" && n == 1 && memory(a[0])) {
+		modrm(e, 0, false, {0xff}, 6, a[0]);
+		return true;
+	}
+	if (op == "pop" && n == 1 && memory(a[0])) {
+		modrm(e, 0, false, {0x8f}, 0, a[0]);
+		return true;
+	}
+
+	if (op == "enter" && n == 2 && immediate(a[0]) && immediate(a[1])) {
+		e.byte(0xc8);
+		e.integer(a[0].value, 2);
+		e.integer(a[1].value, 1);
+		return true;
+	}
+
+	if (n == 0) {
+		static const struct {
+			const char *op;
+			int bytes[2];
+		} single[] = { { "ret", { 0xc3 } }, { "leave", { 0xc9 } },
+				{ "cqo", { 0x48, 0x99 } }, { "faddp", { 0xde, 0xc1 } },
+				{ "fmulp", { 0xde, 0xc9 } }, { "fsubp", { 0xde, 0xe9 } },
+				{ "fdivp", { 0xde, 0xf9 } }, { "fchs", { 0xd9, 0xe0 } },
+				{ "syscall", { 0x0f, 0x05 } }, { "cdqe", { 0x48, 0x98 } },
+				{ NULL, { 0 } } };
+		for (int i = 0; single[i].op != NULL; i++) {
+			if (op == single[i].op) {
+				e.byte(single[i].bytes[0]);
+				if (single[i].bytes[1] != 0) {
+					e.byte(single[i].bytes[1]);
+				}
+				return true;
+			}
+		}
+		return false;
+	}
+
+	if (op == "call" && n == 1 && (a[0].kind == OPERAND_LABEL
+			|| a[0].kind == OPERAND_NAME)) {
+		e.byte(0xe8);
+		if (a[0].kind == OPERAND_LABEL) {
+			e.label = a[0].value;
+			e.displacement(REFERENCE_LABEL, 4);
+		} else {
+			e.name = a[0].name;
+			e.displacement(REFERENCE_NAME, 4);
+		}
+		return true;
+	}
+	if (op.compare(0, 4, "cmov") == 0
+			&& (code = find(conditions, "j" + op.substr(4))) != -1 && n == 2
+			&& general(a[0]) && (general(a[1]) || memory(a[1]))) {
+		modrm(e, 0, true, {0x0f, 0x40 | code}, number(a[0]), a[1]);
+		return true;
+	}
+	if (op == "jmp" && n == 1 && a[0].kind == OPERAND_LABEL) {
+		e.byte(long_jump ? 0xe9 : 0xeb);
+		e.label = a[0].value;
+		e.displacement(REFERENCE_LABEL, long_jump ? 4 : 1);
+		return true;
+	}
+	if ((code = find(conditions, op)) != -1 && n == 1
+			&& a[0].kind == OPERAND_LABEL) {
+		if (long_jump) {
+			e.byte(0x0f);
+			e.byte(0x80 | code);
+		} else {
+			e.byte(0x70 | code);
+		}
+		e.label = a[0].value;
+		e.displacement(REFERENCE_LABEL, long_jump ? 4 : 1);
+		return true;
+	}
+
+	// SSE instructions, with the register operand first but for stores.
+	if (n == 2 && sse(a[0]) && (sse(a[1]) || memory(a[1]))) {
+		static const struct {
+			const char *op;
+			int prefix;
+			int opcode;
+		} instructions[] = { { "addsd", 0xf2, 0x58 }, { "mulsd", 0xf2, 0x59 },
+				{ "subsd", 0xf2, 0x5c }, { "divsd", 0xf2, 0x5e },
+				{ "sqrtsd", 0xf2, 0x51 }, { "movsd", 0xf2, 0x10 },
+				{ "movapd", 0x66, 0x28 }, { "ucomisd", 0x66, 0x2e },
+				{ "xorpd", 0x66, 0x57 }, { NULL, 0, 0 } };
+		for (int i = 0; instructions[i].op != NULL; i++) {
+			if (op == instructions[i].op) {
+				modrm(e, instructions[i].prefix, false,
+						{0x0f, instructions[i].opcode}, number(a[0]), a[1]);
+				return true;
+			}
+		}
+	}
+	if (op == "movsd" && n == 2 && memory(a[0]) && sse(a[1])) {
+		modrm(e, 0xf2, false, {0x0f, 0x11}, number(a[1]), a[0]);
+		return true;
+	}
+	if (op == "cvtsi2sd" && n == 2 && sse(a[0])
+			&& (general(a[1]) || memory(a[1]))) {
+		modrm(e, 0xf2, true, {0x0f, 0x2a}, number(a[0]), a[1]);
+		return true;
+	}
+	if (op == "cvttsd2si" && n == 2 && general(a[0])
+			&& (sse(a[1]) || memory(a[1]))) {
+		modrm(e, 0xf2, true, {0x0f, 0x2c}, number(a[0]), a[1]);
+		return true;
+	}
+	if (op == "movq" && n == 2 && general(a[0]) && sse(a[1])) {
+		modrm(e, 0x66, true, {0x0f, 0x7e}, number(a[1]), a[0]);
+		return true;
+	}
+	if (op == "movq" && n == 2 && sse(a[0]) && general(a[1])) {
+		modrm(e, 0x66, true, {0x0f, 0x6e}, number(a[0]), a[1]);
+		return true;
+	}
+
+	// x87 instructions, on quadwords in memory.
+	if (n == 1 && memory(a[0])) {
+		static const struct {
+			const char *op;
+			vector<int> opcode;
+			int reg;
+		} instructions[] = { { "fild", {0xdf}, 5 }, { "fld", {0xdd}, 0 },
+				{ "fstp", {0xdd}, 3 }, { "fnstcw", {0xd9}, 7 },
+				{ "fldcw", {0xd9}, 5 }, { "stmxcsr", {0x0f, 0xae}, 3 },
+				{ "ldmxcsr", {0x0f, 0xae}, 2 }, { NULL, {}, 0 } };
+		for (int i = 0; instructions[i].op != NULL; i++) {
+			if (op == instructions[i].op) {
+				modrm(e, 0, false, instructions[i].opcode, instructions[i].reg,
+						a[0]);
+				return true;
+			}
+		}
+		return false;
+	}
+	if ((op == "fld" || op == "fstp") && n == 1
+			&& a[0].kind == OPERAND_FPU) {
+		e.byte(op == "fld" ? 0xd9 : 0xdd);
+		e.byte((op == "fld" ? 0xc0 : 0xd8) | a[0].value);
+		return true;
+	}
+	if (op == "fcomip" && n == 2 && a[0].kind == OPERAND_FPU
+			&& a[0].value == 0 && a[1].kind == OPERAND_FPU) {
+		e.byte(0xdf);
+		e.byte(0xf0 | a[1].value);
+		return true;
+	}
+
+	return false;
+}
+
+void object_file::add(instruction_list &code)
+{
+	for (int i = 0; i < code.size(); i++) {
+		lines.push_back(code.get(i));
+	}
+}
+
+/* Appends the bytes of a section to the file, aligned, and fills in its
+ offset and size in its section header. */
+static void append(vector<char> &file, Elf64_Shdr &header, const void *data,
+		long size)
+{
+	long align = header.sh_addralign > 1 ? header.sh_addralign : 1;
+
+	file.resize((file.size() + align - 1) / align * align);
+	header.sh_offset = file.size();
+	header.sh_size = size;
+	file.insert(file.end(), (const char *) data, (const char *) data + size);
+}
+
+/* Lays out the sections of the program after the run-time support, with
+ the jumps made long where their labels are too far off for a byte, then
+ encodes it. Writes the object file with its symbol table and relocations,
+ or the executable with its program headers. */
+void object_file::write(ostream &o, bool executable)
+{
+	instruction_list support(string(startup_support) + (executable
+			? system_support : library_support) + trunc_support);
+	vector<instruction> first;
+	for (int i = 0; i < support.size(); i++) {
+		first.push_back(support.get(i));
+	}
+	lines.insert(lines.begin(), first.begin(), first.end());
+
+	int count = lines.size();
+	vector<encoding> code(count);
+	vector<section_type> section(count);
+	vector<long> offset(count);
+	vector<bool> long_jump(count, false);
+	map<long, int> labels;
+	bool changed = true;
+
+	section_type current = SECTION_TEXT;
+	for (int i = 0; i < count; i++) {
+		const instruction &ins = lines[i];
+		if (ins.is(".text", 0)) {
+			current = SECTION_TEXT;
+		} else if (ins.is(".data", 0)) {
+			current = SECTION_DATA;
+		} else if (ins.is(".section", 1)) {
+			string name = ins.operands[0].name;
+			current = name == ".text" ? SECTION_TEXT
+					: name == ".data" ? SECTION_DATA
+					: name == ".rodata" ? SECTION_RODATA : SECTION_NULL;
+			if (current == SECTION_NULL) {
+				fatal("object_file::write(): unknown section " + name);
+			}
+		} else if (ins.kind == LINE_LABEL) {
+			labels[ins.label] = i;
+		} else if (ins.kind == LINE_TEXT && !(ins.text.compare(0, 2, "\t\t")
+				== 0 && ins.text.size() > 2 && ins.text[2] != '#')) {
+			// A comment.
+		} else if (!encode(ins, false, code[i])) {
+			ostringstream line;
+			line << ins;
+			fatal("object_file::write(): can't encode \"" + line.str()
+					+ "\"");
+		}
+		section[i] = current;
+	}
+
+	// Jumps are short until they have been found to be too far from their
+	// labels. As jumps only get longer, this ends.
+	vector<long> sizes;
+	while (changed) {
+		sizes.assign(NR_SECTIONS, 0);
+		for (int i = 0; i < count; i++) {
+			long &size = sizes[section[i]];
+			if (code[i].align > 1) {
+				size = (size + code[i].align - 1) / code[i].align
+						* code[i].align;
+			}
+			offset[i] = size;
+			size += code[i].bytes.size();
+		}
+
+		changed = false;
+		for (int i = 0; i < count; i++) {
+			encoding &e = code[i];
+			if (e.reference != REFERENCE_LABEL || e.size != 1) {
+				continue;
+			}
+			if (labels.find(e.label) == labels.end()) {
+				fatal("object_file::write(): undefined label");
+			}
+			long to = offset[labels[e.label]];
+			if (!fits_byte(to - offset[i] - (long) e.bytes.size())) {
+				long_jump[i] = true;
+				code[i] = encoding();
+				encode(lines[i], true, code[i]);
+				changed = true;
+			}
+		}
+	}
+
+	// An executable is loaded with its headers, followed by the code and
+	// the constants. Any data are in pages of their own, which can be
+	// written.
+	int segments = sizes[SECTION_DATA] > 0 ? 3 : 2;
+	vector<long> position(NR_SECTIONS, 0);
+	vector<long> address(NR_SECTIONS, 0);
+	if (executable) {
+		position[SECTION_TEXT] = (sizeof(Elf64_Ehdr)
+				+ segments * sizeof(Elf64_Phdr) + 15) / 16 * 16;
+		position[SECTION_RODATA] = (position[SECTION_TEXT]
+				+ sizes[SECTION_TEXT] + 7) / 8 * 8;
+		position[SECTION_DATA] = (position[SECTION_RODATA]
+				+ sizes[SECTION_RODATA] + PAGE_SIZE - 1) / PAGE_SIZE
+				* PAGE_SIZE;
+		for (int s = 0; s < NR_SECTIONS; s++) {
+			address[s] = EXECUTABLE_BASE + position[s];
+		}
+	}
+
+	// Fill in the displacements. Those to other sections and to procedures
+	// outside the program are left to the linker in an object file.
+	vector<unsigned char> contents[NR_SECTIONS];
+	vector<Elf64_Rela> relocations;
+	vector<string> names;
+	string strings(1, '\0');
+	strings += "main";
+	strings += '\0';
+
+	for (int i = 0; i < count; i++) {
+		encoding &e = code[i];
+		vector<unsigned char> &bytes = contents[section[i]];
+		bytes.resize(offset[i], section[i] == SECTION_TEXT ? 0x90 : 0);
+
+		long end = offset[i] + e.bytes.size();
+		long value = 0;
+		if (e.reference != REFERENCE_NONE && section[i] != SECTION_TEXT) {
+			// Only code refers to labels and procedures.
+			fatal("object_file::write(): reference outside of .text");
+		}
+		if (e.reference == REFERENCE_LABEL) {
+			if (labels.find(e.label) == labels.end()) {
+				fatal("object_file::write(): undefined label");
+			}
+			int target = labels[e.label];
+			if (section[target] == section[i] || executable) {
+				value = address[section[target]] + offset[target]
+						- address[section[i]] - end;
+			} else {
+				Elf64_Rela relocation;
+				int symbol = section[target] == SECTION_TEXT ? SYMBOL_TEXT
+						: section[target] == SECTION_DATA ? SYMBOL_DATA
+						: SYMBOL_RODATA;
+				relocation.r_offset = offset[i] + e.position;
+				relocation.r_info = ELF64_R_INFO(symbol, R_X86_64_PC32);
+				relocation.r_addend = offset[target] - (end - e.position
+						- offset[i]);
+				relocations.push_back(relocation);
+			}
+		} else if (e.reference == REFERENCE_NAME && executable) {
+			fatal("object_file::write(): undefined procedure " + e.name);
+		} else if (e.reference == REFERENCE_NAME) {
+			unsigned int n;
+			for (n = 0; n < names.size() && names[n] != e.name; n++)
+				;
+			if (n == names.size()) {
+				names.push_back(e.name);
+			}
+			Elf64_Rela relocation;
+			relocation.r_offset = offset[i] + e.position;
+			relocation.r_info = ELF64_R_INFO(SYMBOL_MAIN + 1 + n,
+					R_X86_64_PLT32);
+			relocation.r_addend = -(end - e.position - offset[i]);
+			relocations.push_back(relocation);
+		}
+		if (e.reference != REFERENCE_NONE) {
+			if (e.size == 1 ? !fits_byte(value) : !fits_int(value)) {
+				fatal("object_file::write(): displacement out of range");
+			}
+			for (int b = 0; b < e.size; b++) {
+				e.bytes[e.position + b] = (value >> (8 * b)) & 0xff;
+			}
+		}
+		bytes.insert(bytes.end(), e.bytes.begin(), e.bytes.end());
+	}
+
+	if (executable) {
+		vector<char> file(segments == 3 ? position[SECTION_DATA]
+				+ sizes[SECTION_DATA] : position[SECTION_RODATA]
+				+ sizes[SECTION_RODATA]);
+		int loaded[] = { SECTION_TEXT, SECTION_RODATA, SECTION_DATA };
+		for (int s = 0; s < 3; s++) {
+			copy(contents[loaded[s]].begin(), contents[loaded[s]].end(),
+					file.begin() + position[loaded[s]]);
+		}
+
+		Elf64_Phdr headers[3];
+		memset(headers, 0, sizeof(headers));
+		headers[0].p_type = PT_LOAD;
+		headers[0].p_flags = PF_R | PF_X;
+		headers[0].p_vaddr = headers[0].p_paddr = EXECUTABLE_BASE;
+		headers[0].p_filesz = headers[0].p_memsz = position[SECTION_RODATA]
+				+ sizes[SECTION_RODATA];
+		headers[0].p_align = PAGE_SIZE;
+		headers[1].p_type = PT_GNU_STACK;
+		headers[1].p_flags = PF_R | PF_W;
+		headers[1].p_align = 16;
+		headers[2].p_type = PT_LOAD;
+		headers[2].p_flags = PF_R | PF_W;
+		headers[2].p_offset = position[SECTION_DATA];
+		headers[2].p_vaddr = headers[2].p_paddr = address[SECTION_DATA];
+		headers[2].p_filesz = headers[2].p_memsz = sizes[SECTION_DATA];
+		headers[2].p_align = PAGE_SIZE;
+		memcpy(&file[sizeof(Elf64_Ehdr)], headers,
+				segments * sizeof(Elf64_Phdr));
+
+		Elf64_Ehdr header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.e_ident, ELFMAG, SELFMAG);
+		header.e_ident[EI_CLASS] = ELFCLASS64;
+		header.e_ident[EI_DATA] = ELFDATA2LSB;
+		header.e_ident[EI_VERSION] = EV_CURRENT;
+		header.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+		header.e_type = ET_EXEC;
+		header.e_machine = EM_X86_64;
+		header.e_version = EV_CURRENT;
+		header.e_entry = address[SECTION_TEXT];
+		header.e_phoff = sizeof(Elf64_Ehdr);
+		header.e_ehsize = sizeof(Elf64_Ehdr);
+		header.e_phentsize = sizeof(Elf64_Phdr);
+		header.e_phnum = segments;
+		memcpy(&file[0], &header, sizeof(header));
+
+		o.write(&file[0], file.size());
+		return;
+	}
+
+	// The symbols: the sections, main at the start of the run-time support,
+	// and the procedures called outside of the program.
+	vector<Elf64_Sym> symbols(SYMBOL_MAIN + 1 + names.size());
+	memset(&symbols[0], 0, symbols.size() * sizeof(Elf64_Sym));
+	int symbol_sections[] = { SECTION_TEXT, SECTION_DATA, SECTION_RODATA };
+	for (int s = SYMBOL_TEXT; s <= SYMBOL_RODATA; s++) {
+		symbols[s].st_info = ELF64_ST_INFO(STB_LOCAL, STT_SECTION);
+		symbols[s].st_shndx = symbol_sections[s - SYMBOL_TEXT];
+	}
+	symbols[SYMBOL_MAIN].st_name = 1;
+	symbols[SYMBOL_MAIN].st_info = ELF64_ST_INFO(STB_GLOBAL, STT_NOTYPE);
+	symbols[SYMBOL_MAIN].st_shndx = SECTION_TEXT;
+	for (unsigned int n = 0; n < names.size(); n++) {
+		Elf64_Sym &symbol = symbols[SYMBOL_MAIN + 1 + n];
+		symbol.st_name = strings.size();
+		symbol.st_info = ELF64_ST_INFO(STB_GLOBAL, STT_NOTYPE);
+		symbol.st_shndx = SHN_UNDEF;
+		strings += names[n];
+		strings += '\0';
+	}
+
+	string section_strings(1, '\0');
+	Elf64_Shdr headers[NR_SECTIONS];
+	memset(headers, 0, sizeof(headers));
+	for (int s = SECTION_TEXT; s < NR_SECTIONS; s++) {
+		headers[s].sh_name = section_strings.size();
+		headers[s].sh_addralign = 1;
+		section_strings += section_names[s];
+		section_strings += '\0';
+	}
+	headers[SECTION_TEXT].sh_type = SHT_PROGBITS;
+	headers[SECTION_TEXT].sh_flags = SHF_ALLOC | SHF_EXECINSTR;
+	headers[SECTION_TEXT].sh_addralign = 16;
+	headers[SECTION_RELA_TEXT].sh_type = SHT_RELA;
+	headers[SECTION_RELA_TEXT].sh_flags = SHF_INFO_LINK;
+	headers[SECTION_RELA_TEXT].sh_link = SECTION_SYMTAB;
+	headers[SECTION_RELA_TEXT].sh_info = SECTION_TEXT;
+	headers[SECTION_RELA_TEXT].sh_addralign = 8;
+	headers[SECTION_RELA_TEXT].sh_entsize = sizeof(Elf64_Rela);
+	headers[SECTION_DATA].sh_type = SHT_PROGBITS;
+	headers[SECTION_DATA].sh_flags = SHF_ALLOC | SHF_WRITE;
+	headers[SECTION_DATA].sh_addralign = 8;
+	headers[SECTION_RODATA].sh_type = SHT_PROGBITS;
+	headers[SECTION_RODATA].sh_flags = SHF_ALLOC;
+	headers[SECTION_RODATA].sh_addralign = 8;
+	headers[SECTION_NOTE].sh_type = SHT_PROGBITS;
+	headers[SECTION_SYMTAB].sh_type = SHT_SYMTAB;
+	headers[SECTION_SYMTAB].sh_link = SECTION_STRTAB;
+	headers[SECTION_SYMTAB].sh_info = SYMBOL_MAIN;
+	headers[SECTION_SYMTAB].sh_addralign = 8;
+	headers[SECTION_SYMTAB].sh_entsize = sizeof(Elf64_Sym);
+	headers[SECTION_STRTAB].sh_type = SHT_STRTAB;
+	headers[SECTION_SHSTRTAB].sh_type = SHT_STRTAB;
+
+	vector<char> file(sizeof(Elf64_Ehdr));
+	append(file, headers[SECTION_TEXT], contents[SECTION_TEXT].data(),
+			contents[SECTION_TEXT].size());
+	append(file, headers[SECTION_DATA], contents[SECTION_DATA].data(),
+			contents[SECTION_DATA].size());
+	append(file, headers[SECTION_RODATA], contents[SECTION_RODATA].data(),
+			contents[SECTION_RODATA].size());
+	append(file, headers[SECTION_NOTE], NULL, 0);
+	append(file, headers[SECTION_SYMTAB], symbols.data(),
+			symbols.size() * sizeof(Elf64_Sym));
+	append(file, headers[SECTION_STRTAB], strings.data(), strings.size());
+	append(file, headers[SECTION_RELA_TEXT], relocations.data(),
+			relocations.size() * sizeof(Elf64_Rela));
+	append(file, headers[SECTION_SHSTRTAB], section_strings.data(),
+			section_strings.size());
+	file.resize((file.size() + 7) / 8 * 8);
+
+	Elf64_Ehdr header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.e_ident, ELFMAG, SELFMAG);
+	header.e_ident[EI_CLASS] = ELFCLASS64;
+	header.e_ident[EI_DATA] = ELFDATA2LSB;
+	header.e_ident[EI_VERSION] = EV_CURRENT;
+	header.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+	header.e_type = ET_REL;
+	header.e_machine = EM_X86_64;
+	header.e_version = EV_CURRENT;
+	header.e_shoff = file.size();
+	header.e_ehsize = sizeof(Elf64_Ehdr);
+	header.e_shentsize = sizeof(Elf64_Shdr);
+	header.e_shnum = NR_SECTIONS;
+	header.e_shstrndx = SECTION_SHSTRTAB;
+	memcpy(&file[0], &header, sizeof(header));
+
+	o.write(&file[0], file.size());
+	o.write((const char *) headers, sizeof(headers));
+}
@@ -0,0 +1,39 @@
+#ifndef __OBJECT_HH__
+#define __OBJECT_HH__
+
+#include <iostream>
+#include <vector>
+
+#include "machine.hh"
+
+using namespace std;
+
+/*** An ELF64 relocatable object file, which the code generator writes
+ instead of the assembler code with the -b option, or a static ELF64
+ executable with the -e option. The machine instructions of the procedures
+ are kept until the whole program has been generated, and then encoded into
+ machine code, after the run-time support otherwise found in diesel_glue.s.
+ The code of the procedures goes into the .text section, and their real
+ constants into .rodata. In an object file, calls to the C library and
+ diesel_rts.c are left to the linker by relocations, as is the loading of
+ constants. An executable needs no linking, as its run-time support reads
+ and writes characters by system calls. Lines which aren't code, like the
+ trace comments, are skipped. ***/
+
+class object_file
+{
+private:
+	// The lines of the program. The run-time support goes before them,
+	// see write().
+	vector<instruction> lines;
+
+public:
+	// Adds the instructions of a procedure.
+	void add(instruction_list &);
+
+	// Encodes the program, and writes the object file, or a static
+	// executable if the argument is true.
+	void write(ostream &, bool);
+};
+
+#endif
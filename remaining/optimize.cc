@@ -1,4 +1,9 @@
+#include <climits>
+#include <vector>
+#include <algorithm>
+
 #include "optimize.hh"
+#include "inline.hh"
 
 /*** This file contains all code pertaining to AST optimisation. It currently
  implements a simple optimisation called "constant folding". Most of the
@@ -8,12 +13,25 @@
 
 ast_optimizer *optimizer = new ast_optimizer();
 
+// Defined in main.cc.
+extern int optimize_level;
+
 /* The optimizer's interface method. Starts a recursive optimize call down
- the AST nodes, searching for binary operators with constant children. */
+ the AST nodes, searching for binary operators with constant children.
+ From optimization level 2, calls to small procedures and functions are
+ inlined first, and the optimized body is handed to the inliner so that
+ the procedure being compiled can be inlined in turn. The scope of the
+ procedure is still open here, so it is the current environment. */
 void ast_optimizer::do_optimize(ast_stmt_list *body) {
+	if (optimize_level >= 2) {
+		inliner->do_inline(body);
+	}
 	if (body != NULL) {
 		body->optimize();
 	}
+	if (optimize_level >= 2) {
+		inliner->remember(sym_tab->current_environment(), body);
+	}
 }
 
 /* Returns 1 if an AST expression is a subclass of ast_binaryoperation,
@@ -71,6 +89,9 @@ void ast_stmt_list::optimize() {
 	}
 	if (last_stmt != NULL) {
 		last_stmt->optimize();
+		if (optimize_level >= 1) {
+			optimizer->prune_statement(this);
+		}
 	}
 }
 
@@ -81,7 +102,12 @@ void ast_expr_list::optimize() {
 		preceding->optimize();
 	}
 	if (last_expr != NULL) {
-		last_expr->optimize();
+		if (optimize_level >= 1) {
+			// fold_constants() visits the whole expression by itself.
+			last_expr = optimizer->fold_constants(last_expr);
+		} else {
+			last_expr->optimize();
+		}
 	}
 }
 
@@ -131,40 +157,432 @@ double fold_mod(double a, double b) {
 	return (int)a % (int)b;
 }
 
+/* Returns true if an AST expression is a subclass of ast_binaryrelation. */
+bool ast_optimizer::is_binrel(ast_expression *node) {
+	switch (node->tag) {
+	case AST_EQUAL:
+	case AST_NOTEQUAL:
+	case AST_LESSTHAN:
+	case AST_GREATERTHAN:
+		return true;
+	default:
+		return false;
+	}
+}
+
 /* This convenience method is used to apply constant folding to all
  binary operations. It returns either the resulting optimized node or the
- original node if no optimization could be performed. */
+ original node if no optimization could be performed. From optimization
+ level 1 relations, unary operators and casts are folded as well, and the
+ children of array references and function calls are visited. */
 ast_expression *ast_optimizer::fold_constants(ast_expression *node) {
+	if (node == NULL)
+		return NULL;
+
 	if (node->tag == AST_ID)
 		return optimizer->fold_ast_const(node);
 
-	if (node != NULL && is_binop(node)) {
+	if (is_binop(node)) {
 		ast_binaryoperation* binop = node->get_ast_binaryoperation();
 		binop->left = optimizer->fold_constants(binop->left);
 		binop->right = optimizer->fold_constants(binop->right);
 
+		if (optimize_level >= 1 && binop->type == integer_type) {
+			ast_expression *folded = fold_int_binop(node, binop);
+			return folded != node ? folded : simplify_int_binop(node, binop);
+		}
+
+		ast_expression *folded;
 		switch (binop->tag) {
 		case AST_ADD:
-			return fold_binop(node, binop, fold_add);
+			folded = fold_binop(node, binop, fold_add);
+			break;
 		case AST_SUB:
-			return fold_binop(node, binop, fold_sub);
+			folded = fold_binop(node, binop, fold_sub);
+			break;
 		case AST_MULT:
-			return fold_binop(node, binop, fold_mult);
+			folded = fold_binop(node, binop, fold_mult);
+			break;
 		case AST_DIVIDE:
-			return fold_binop(node, binop, fold_div);
+			folded = fold_binop(node, binop, fold_div);
+			break;
 		case AST_IDIV:
-			return fold_binop(node, binop, fold_div);
+			folded = fold_binop(node, binop, fold_div);
+			break;
 		case AST_OR:
-			return fold_binop(node, binop, fold_or);
+			folded = fold_binop(node, binop, fold_or);
+			break;
 		case AST_AND:
-			return fold_binop(node, binop, fold_and);
+			folded = fold_binop(node, binop, fold_and);
+			break;
 		case AST_MOD:
-			return fold_binop(node, binop, fold_mod);
+			folded = fold_binop(node, binop, fold_mod);
+			break;
+		default:
+			return node;
+		}
+
+		if (optimize_level >= 1 && folded == node)
+			return simplify_real_binop(node, binop);
+		return folded;
+	}
+
+	// Level 0 stops here, to keep the output identical to the trace files.
+	if (optimize_level < 1)
+		return node;
+
+	if (is_binrel(node)) {
+		ast_binaryrelation *binrel = node->get_ast_binaryrelation();
+		binrel->left = optimizer->fold_constants(binrel->left);
+		binrel->right = optimizer->fold_constants(binrel->right);
+		return fold_binrel(node, binrel);
+	}
+
+	switch (node->tag) {
+	case AST_UMINUS:
+	case AST_NOT:
+	case AST_CAST:
+		return fold_unary(node);
+	case AST_INDEXED:
+	case AST_FUNCTIONCALL:
+	case AST_INLINEDCALL:
+		// These can't be folded themselves, but their index, parameters
+		// and bodies can.
+		node->optimize();
+		return node;
+	default:
+		//Couldn't optimize
+		return node;
+	}
+}
+
+/* Arithmetic on longs that wraps around like the generated code does,
+ instead of being undefined on overflow in C++. */
+static long wrap_add(long a, long b) {
+	return (long) ((unsigned long) a + (unsigned long) b);
+}
+
+static long wrap_mult(long a, long b) {
+	return (long) ((unsigned long) a * (unsigned long) b);
+}
+
+/* Integer version of fold_binop(). Working on longs directly means large
+ values don't lose precision on the way through a double. Division by zero
+ is left for the program to discover at run time. */
+ast_expression *ast_optimizer::fold_int_binop(ast_expression *node,
+		ast_binaryoperation *binop) {
+	ast_integer *left = binop->left->get_ast_integer();
+	ast_integer *right = binop->right->get_ast_integer();
+	if (left == NULL || right == NULL)
+		return node;
+
+	long a = left->value;
+	long b = right->value;
+	long result;
+
+	switch (binop->tag) {
+	case AST_ADD:
+		result = wrap_add(a, b);
+		break;
+	case AST_SUB:
+		result = wrap_add(a, (long) (0UL - (unsigned long) b));
+		break;
+	case AST_MULT:
+		result = wrap_mult(a, b);
+		break;
+	case AST_OR:
+		result = (a != 0) || (b != 0);
+		break;
+	case AST_AND:
+		result = (a != 0) && (b != 0);
+		break;
+	case AST_IDIV:
+	case AST_MOD:
+		if (b == 0 || (b == -1 && a == LONG_MIN))
+			return node;
+		result = (binop->tag == AST_IDIV) ? a / b : a % b;
+		break;
+	default:
+		return node;
+	}
+
+	return new ast_integer(binop->pos, result);
+}
+
+/* Returns true if evaluating an expression can't have side effects, ie, it
+ doesn't contain any function calls. Only such expressions may be dropped
+ by the simplifications below. */
+bool ast_optimizer::is_pure(ast_expression *node) {
+	if (node == NULL)
+		return true;
+
+	if (is_binop(node)) {
+		ast_binaryoperation *binop = node->get_ast_binaryoperation();
+		return is_pure(binop->left) && is_pure(binop->right);
+	}
+	if (is_binrel(node)) {
+		ast_binaryrelation *binrel = node->get_ast_binaryrelation();
+		return is_pure(binrel->left) && is_pure(binrel->right);
+	}
+
+	switch (node->tag) {
+	case AST_ID:
+	case AST_INTEGER:
+	case AST_REAL:
+		return true;
+	case AST_INDEXED:
+		return is_pure(static_cast<ast_indexed *>(node)->index);
+	case AST_UMINUS:
+		return is_pure(node->get_ast_uminus()->expr);
+	case AST_NOT:
+		return is_pure(node->get_ast_not()->expr);
+	case AST_CAST:
+		return is_pure(node->get_ast_cast()->expr);
+	default:
+		return false;
+	}
+}
+
+/* Returns true if two pure expressions always evaluate to the same value.
+ This is a purely structural comparison, so x + 1 and 1 + x are considered
+ different. */
+bool ast_optimizer::same_expression(ast_expression *a, ast_expression *b) {
+	if (a->tag != b->tag)
+		return false;
+
+	if (is_binop(a)) {
+		ast_binaryoperation *l = a->get_ast_binaryoperation();
+		ast_binaryoperation *r = b->get_ast_binaryoperation();
+		return same_expression(l->left, r->left)
+				&& same_expression(l->right, r->right);
+	}
+
+	switch (a->tag) {
+	case AST_ID:
+		return a->get_ast_id()->sym_p == b->get_ast_id()->sym_p;
+	case AST_INTEGER:
+		return a->get_ast_integer()->value == b->get_ast_integer()->value;
+	case AST_INDEXED: {
+		ast_indexed *l = static_cast<ast_indexed *>(a);
+		ast_indexed *r = static_cast<ast_indexed *>(b);
+		return l->id->sym_p == r->id->sym_p
+				&& same_expression(l->index, r->index);
+	}
+	case AST_UMINUS:
+		return same_expression(a->get_ast_uminus()->expr,
+				b->get_ast_uminus()->expr);
+	default:
+		return false;
+	}
+}
+
+/* Returns x + c, merging c into x if x already is a sum or difference with
+ a literal right operand, so that (a + 1) + 2 becomes a + 3. Negative
+ constants are subtracted instead to keep the printed AST readable. */
+static ast_expression *add_constant(position_information *pos,
+		ast_expression *x, long c) {
+	if (x->tag == AST_ADD || x->tag == AST_SUB) {
+		ast_binaryoperation *inner = x->get_ast_binaryoperation();
+		ast_integer *c1 = inner->right->get_ast_integer();
+		if (c1 != NULL) {
+			long k = (x->tag == AST_ADD) ? c1->value : -(unsigned long) c1->value;
+			return add_constant(pos, inner->left, wrap_add(k, c));
+		}
+	}
+
+	if (c == 0)
+		return x;
+
+	ast_binaryoperation *sum;
+	if (c < 0 && c != LONG_MIN) {
+		sum = new ast_sub(pos, x, new ast_integer(pos, -c));
+	} else {
+		sum = new ast_add(pos, x, new ast_integer(pos, c));
+	}
+	sum->type = integer_type;
+	return sum;
+}
+
+/* Algebraic simplification of an integer operation that couldn't be folded
+ completely. Literals are moved to the right of + and *, chains of
+ constants are reassociated ((a + 1) + 2 becomes a + 3, (a * 2) * 4 becomes
+ a * 8), and identities such as x + 0, x * 1 and x - x are removed. An
+ operand is only thrown away if it has no side effects. Multiplication and
+ division by powers of two are left for the quad generator, which turns
+ them into shifts. */
+ast_expression *ast_optimizer::simplify_int_binop(ast_expression *node,
+		ast_binaryoperation *binop) {
+	position_information *pos = binop->pos;
+
+	// Literals have no side effects, so swapping the operands doesn't change
+	// the order in which anything observable happens.
+	if ((binop->tag == AST_ADD || binop->tag == AST_MULT)
+			&& binop->left->get_ast_integer() != NULL) {
+		ast_expression *tmp = binop->left;
+		binop->left = binop->right;
+		binop->right = tmp;
+	}
+
+	ast_expression *x = binop->left;
+	ast_integer *right = binop->right->get_ast_integer();
+
+	if (right == NULL) {
+		if (binop->tag == AST_SUB && is_pure(x)
+				&& same_expression(x, binop->right))
+			return new ast_integer(pos, 0);
+		if (binop->tag == AST_SUB && x->get_ast_integer() != NULL
+				&& x->get_ast_integer()->value == 0)
+			return new ast_uminus(pos, binop->right);
+		return node;
+	}
+
+	long c = right->value;
+	switch (binop->tag) {
+	case AST_ADD:
+		return add_constant(pos, x, c);
+	case AST_SUB:
+		return add_constant(pos, x, -(unsigned long) c);
+	case AST_MULT:
+		if (c == 0)
+			return is_pure(x) ? new ast_integer(pos, 0) : node;
+		if (c == 1)
+			return x;
+		if (c == -1)
+			return new ast_uminus(pos, x);
+		if (x->tag == AST_MULT) {
+			ast_binaryoperation *inner = x->get_ast_binaryoperation();
+			ast_integer *c1 = inner->right->get_ast_integer();
+			if (c1 != NULL) {
+				binop->left = inner->left;
+				right->value = wrap_mult(c1->value, c);
+				return simplify_int_binop(node, binop);
+			}
+		}
+		return node;
+	case AST_IDIV:
+		// Not x div -1, which traps for LONG_MIN like in
+		// fold_int_binop().
+		if (c == 1)
+			return x;
+		return node;
+	case AST_MOD:
+		if (c == 1 && is_pure(x))
+			return new ast_integer(pos, 0);
+		return node;
+	case AST_AND:
+		if (c == 0 && is_pure(x))
+			return new ast_integer(pos, 0);
+		return node;
+	case AST_OR:
+		if (c != 0 && is_pure(x))
+			return new ast_integer(pos, 1);
+		return node;
+	default:
+		return node;
+	}
+}
+
+/* The real counterpart of simplify_int_binop(). Floating point arithmetic
+ isn't associative and x * 0.0 isn't 0.0 for infinities, so only the
+ identities that hold for every value are used: x * 1.0, x / 1.0 and
+ x - 0.0. */
+ast_expression *ast_optimizer::simplify_real_binop(ast_expression *node,
+		ast_binaryoperation *binop) {
+	if (binop->type != real_type)
+		return node;
+
+	if ((binop->tag == AST_ADD || binop->tag == AST_MULT)
+			&& binop->left->get_ast_real() != NULL) {
+		ast_expression *tmp = binop->left;
+		binop->left = binop->right;
+		binop->right = tmp;
+	}
+
+	ast_real *right = binop->right->get_ast_real();
+	if (right == NULL)
+		return node;
+
+	switch (binop->tag) {
+	case AST_MULT:
+	case AST_DIVIDE:
+		return right->value == 1.0 ? binop->left : node;
+	case AST_SUB:
+		return right->value == 0.0 ? binop->left : node;
+	default:
+		return node;
+	}
+}
+
+/* Folds a relation between two literals into the integer 1 or 0. Mixed
+ relations have already had a cast inserted by the type checker, so both
+ sides are either integers or reals here. */
+ast_expression *ast_optimizer::fold_binrel(ast_expression *node,
+		ast_binaryrelation *binrel) {
+	double a, b;
+
+	if (binrel->left->get_ast_integer() != NULL
+			&& binrel->right->get_ast_integer() != NULL) {
+		long ia = binrel->left->get_ast_integer()->value;
+		long ib = binrel->right->get_ast_integer()->value;
+		switch (binrel->tag) {
+		case AST_EQUAL:
+			return new ast_integer(binrel->pos, ia == ib);
+		case AST_NOTEQUAL:
+			return new ast_integer(binrel->pos, ia != ib);
+		case AST_LESSTHAN:
+			return new ast_integer(binrel->pos, ia < ib);
+		case AST_GREATERTHAN:
+			return new ast_integer(binrel->pos, ia > ib);
 		default:
 			return node;
 		}
+	} else if (binrel->left->get_ast_real() != NULL
+			&& binrel->right->get_ast_real() != NULL) {
+		a = binrel->left->get_ast_real()->value;
+		b = binrel->right->get_ast_real()->value;
+	} else {
+		return node;
 	}
-	//Couldn't optimize
+
+	switch (binrel->tag) {
+	case AST_EQUAL:
+		return new ast_integer(binrel->pos, a == b);
+	case AST_NOTEQUAL:
+		return new ast_integer(binrel->pos, a != b);
+	case AST_LESSTHAN:
+		return new ast_integer(binrel->pos, a < b);
+	case AST_GREATERTHAN:
+		return new ast_integer(binrel->pos, a > b);
+	default:
+		return node;
+	}
+}
+
+/* Folds unary minus, logical negation and integer to real casts of
+ literals. The operand is folded first. */
+ast_expression *ast_optimizer::fold_unary(ast_expression *node) {
+	ast_expression *expr;
+
+	if (node->get_ast_uminus() != NULL) {
+		ast_uminus *uminus = node->get_ast_uminus();
+		expr = uminus->expr = fold_constants(uminus->expr);
+		if (expr->get_ast_integer() != NULL)
+			return new ast_integer(node->pos, (long) (0UL
+					- (unsigned long) expr->get_ast_integer()->value));
+		if (expr->get_ast_real() != NULL)
+			return new ast_real(node->pos, -expr->get_ast_real()->value);
+	} else if (node->get_ast_not() != NULL) {
+		ast_not *not_node = node->get_ast_not();
+		expr = not_node->expr = fold_constants(not_node->expr);
+		if (expr->get_ast_integer() != NULL)
+			return new ast_integer(node->pos, expr->get_ast_integer()->value == 0);
+	} else if (node->get_ast_cast() != NULL) {
+		ast_cast *cast = node->get_ast_cast();
+		expr = cast->expr = fold_constants(cast->expr);
+		if (expr->get_ast_integer() != NULL)
+			return new ast_real(node->pos, expr->get_ast_integer()->value);
+	}
+
 	return node;
 }
 
@@ -186,26 +604,124 @@ ast_expression *ast_optimizer::fold_binop(ast_expression *node,
 	return node;
 }
 
+/* Replaces an identifier referring to a declared constant with a literal
+ node holding its value, so that expressions like 4 + FOO can be folded.
+ This changes the generated quads and assembler, so it is only done when
+ constant propagation has been asked for (optimization level 1 and up);
+ at level 0 the output stays identical to the trace files. */
 ast_expression *ast_optimizer::fold_ast_const(ast_expression *node) {
+	if (optimize_level < 1) {
+		return node;
+	}
+
 	symbol *temp_sym = sym_tab->get_symbol(node->get_ast_id()->sym_p);
-	if (temp_sym->tag == SYM_CONST) {
-		// We removed this part because it made us unable to complete the last lab.
-		// Replacing constants with numbers made our assembler not follow the tracefile.
-		// So to clarify this code works but we aren't using it :)
-		/*
-
-		if (node->type == integer_type) {
-			int val = temp_sym->get_constant_symbol()->const_value.ival;
-			return new ast_integer(node->pos, val);
-		} else if (node->type == real_type) {
-			double val = temp_sym->get_constant_symbol()->const_value.rval;
-			return new ast_real(node->pos, val);
-		}
-		*/
+	if (temp_sym == NULL || temp_sym->tag != SYM_CONST) {
+		return node;
+	}
+
+	constant_symbol *con = temp_sym->get_constant_symbol();
+	if (con->type == integer_type) {
+		return new ast_integer(node->pos, con->const_value.ival);
+	} else if (con->type == real_type) {
+		return new ast_real(node->pos, con->const_value.rval);
 	}
 	return node;
 }
 
+/* Replaces the last statement of a list with the statements in body, or
+ removes it altogether if body is NULL. The list nodes of body are reused,
+ so this doesn't allocate anything. */
+void ast_optimizer::splice_statement(ast_stmt_list *list,
+		ast_stmt_list *body) {
+	if (body == NULL) {
+		if (list->preceding != NULL) {
+			list->last_stmt = list->preceding->last_stmt;
+			list->preceding = list->preceding->preceding;
+		} else {
+			list->last_stmt = NULL;
+		}
+		return;
+	}
+
+	ast_stmt_list *first = body;
+	while (first->preceding != NULL) {
+		first = first->preceding;
+	}
+	first->preceding = list->preceding;
+
+	list->last_stmt = body->last_stmt;
+	list->preceding = body->preceding;
+}
+
+/* Called on an if statement whose conditions have already been folded.
+ Arms with a condition that is known to be false are dropped, and an arm
+ whose condition is known to be true becomes the else part, making the
+ arms after it unreachable. If no arm is left, the if statement is turned
+ into "if 1 then <else part> end" (or "if 0" when there is no else part)
+ which prune_statement() later replaces by the else part itself. */
+void ast_optimizer::prune_if(ast_if *node) {
+	vector<ast_elsif *> arms;
+	vector<ast_elsif *> live;
+	ast_stmt_list *else_body = node->else_body;
+
+	for (ast_elsif_list *l = node->elsif_list; l != NULL; l = l->preceding) {
+		arms.push_back(l->last_elsif);
+	}
+	arms.push_back(new ast_elsif(node->pos, node->condition, node->body));
+	reverse(arms.begin(), arms.end());
+
+	for (unsigned int i = 0; i < arms.size(); i++) {
+		ast_integer *cond = arms[i]->condition->get_ast_integer();
+		if (cond == NULL) {
+			live.push_back(arms[i]);
+		} else if (cond->value != 0) {
+			else_body = arms[i]->body;
+			break;
+		}
+	}
+
+	if (live.empty()) {
+		node->condition = new ast_integer(node->pos, else_body != NULL);
+		node->body = else_body;
+		node->elsif_list = NULL;
+		node->else_body = NULL;
+		return;
+	}
+
+	node->condition = live[0]->condition;
+	node->body = live[0]->body;
+	node->elsif_list = NULL;
+	for (unsigned int i = 1; i < live.size(); i++) {
+		node->elsif_list = new ast_elsif_list(live[i]->pos, live[i],
+				node->elsif_list);
+	}
+	node->else_body = else_body;
+}
+
+/* Removes the last statement of a list if it can never be executed, or
+ replaces it with its body if the condition guarding it always holds.
+ Only while loops with a false condition and if statements left with a
+ constant condition by prune_if() are affected. The tag has been checked
+ before the downcasts, so they are safe. */
+void ast_optimizer::prune_statement(ast_stmt_list *list) {
+	ast_statement *stmt = list->last_stmt;
+
+	if (stmt->tag == AST_WHILE) {
+		ast_integer *cond = static_cast<ast_while *>(stmt)->condition
+				->get_ast_integer();
+		if (cond != NULL && cond->value == 0) {
+			splice_statement(list, NULL);
+		}
+	} else if (stmt->tag == AST_IF) {
+		ast_if *if_stmt = static_cast<ast_if *>(stmt);
+		ast_integer *cond = if_stmt->condition->get_ast_integer();
+		if (cond != NULL && if_stmt->elsif_list == NULL
+				&& if_stmt->else_body == NULL) {
+			splice_statement(list, cond->value != 0 ? if_stmt->body : NULL);
+		}
+	}
+}
+
 /* All the binary operations should already have been detected in their parent
  nodes, so we don't need to do anything at all here. */
 void ast_add::optimize() {
@@ -287,6 +803,10 @@ void ast_procedurecall::optimize() {
 
 void ast_assign::optimize() {
 	/* Your code here */
+	if (optimize_level >= 1) {
+		// Folds the index of an array element being assigned to.
+		this->lhs->optimize();
+	}
 	this->rhs->optimize();
 
 	this->rhs = optimizer->fold_constants(this->rhs);
@@ -297,7 +817,9 @@ void ast_while::optimize() {
 	this->condition->optimize();
 	this->condition = optimizer->fold_constants(this->condition);
 
-	this->body->optimize();
+	if (this->body != NULL) {
+		this->body->optimize();
+	}
 }
 
 void ast_if::optimize() {
@@ -305,7 +827,9 @@ void ast_if::optimize() {
 	this->condition->optimize();
 	this->condition = optimizer->fold_constants(this->condition);
 
-	this->body->optimize();
+	if (this->body != NULL) {
+		this->body->optimize();
+	}
 
 	if (this->elsif_list != NULL) {
 		this->elsif_list->optimize();
@@ -313,6 +837,10 @@ void ast_if::optimize() {
 	if (this->else_body != NULL) {
 		this->else_body->optimize();
 	}
+
+	if (optimize_level >= 1) {
+		optimizer->prune_if(this);
+	}
 }
 
 void ast_return::optimize() {
@@ -363,6 +891,15 @@ void ast_cast::optimize() {
 	/* Your code here */
 }
 
+/* The body of an inlined function is optimized once more in its new
+ context. */
+void ast_inlinedcall::optimize() {
+	if (body != NULL) {
+		body->optimize();
+	}
+	result = optimizer->fold_constants(result);
+}
+
 void ast_procedurehead::optimize() {
 	fatal("Trying to call ast_procedurehead::optimize()");
 }
@@ -29,6 +29,9 @@ public:
 	// It's needed to find out which nodes are eligible for optimization.
 	bool is_binop(ast_expression *);
 
+	// Same as above, for subclasses of ast_binaryrelation.
+	bool is_binrel(ast_expression *);
+
 	// This is a convenient method used in optimize.cc. It has to be public
 	// so the ast_* nodes can access it. Another solution would be to make it
 	// a static method in the optimize.cc file... A matter of preference.
@@ -37,6 +40,35 @@ public:
 	ast_expression *fold_binop(ast_expression *, ast_binaryoperation*,
 			double (*)(double, double));
 
+	// These are only used from optimization level 1 and up. The first
+	// folds integer operations without going through doubles, the others
+	// fold relations and the unary nodes.
+	ast_expression *fold_int_binop(ast_expression *, ast_binaryoperation *);
+	ast_expression *fold_binrel(ast_expression *, ast_binaryrelation *);
+	ast_expression *fold_unary(ast_expression *);
+
+	// Algebraic simplification and reassociation (level 1 and up), applied
+	// to the operations fold_constants() couldn't fold. is_pure() tells if
+	// an expression is free of side effects and same_expression() if two
+	// pure expressions are structurally identical.
+	ast_expression *simplify_int_binop(ast_expression *,
+			ast_binaryoperation *);
+	ast_expression *simplify_real_binop(ast_expression *,
+			ast_binaryoperation *);
+	bool is_pure(ast_expression *);
+	bool same_expression(ast_expression *, ast_expression *);
+
+	// Dead branch elimination (level 1 and up). prune_if() drops the arms
+	// of an if statement whose conditions are known to be false, and
+	// prune_statement() removes or splices in the last statement of a list
+	// once its condition is a known constant.
+	void prune_if(ast_if *);
+	void prune_statement(ast_stmt_list *);
+
+	// Replaces the last statement of a list with another list, or removes
+	// it if the list is NULL. Also used by the inliner.
+	void splice_statement(ast_stmt_list *, ast_stmt_list *);
+
 };
 
 #endif
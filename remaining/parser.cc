@@ -68,6 +68,7 @@
 #include "semantic.hh"
 #include "optimize.hh"
 #include "codegen.hh"
+#include "cfg.hh"
 
 /* Defined in parser.cc */
 extern char *yytext;
@@ -95,6 +96,7 @@ extern void yyerror(string);
    given to the 'diesel' script. */
 extern bool print_ast;
 extern bool print_quads;
+extern bool print_cfg;
 extern bool typecheck;
 extern bool optimize;
 extern bool quads;
@@ -107,7 +109,7 @@ extern bool assembler;
    wish. Not mandatory. */
 /* #define YYERROR_VERBOSE */
 
-#line 111 "parser.cc" /* yacc.c:339  */
+#line 113 "parser.cc" /* yacc.c:339  */
 
 # ifndef YY_NULLPTR
 #  if defined __cplusplus && 201103L <= __cplusplus
@@ -194,7 +196,7 @@ extern int yydebug;
 typedef union YYSTYPE YYSTYPE;
 union YYSTYPE
 {
-#line 54 "parser.y" /* yacc.c:355  */
+#line 56 "parser.y" /* yacc.c:355  */
 
     ast_node             *ast;
     ast_id               *id;
@@ -216,7 +218,7 @@ union YYSTYPE
     pool_index            str;
     pool_index            pool_p;
 
-#line 220 "parser.cc" /* yacc.c:355  */
+#line 222 "parser.cc" /* yacc.c:355  */
 };
 # define YYSTYPE_IS_TRIVIAL 1
 # define YYSTYPE_IS_DECLARED 1
@@ -245,7 +247,7 @@ int yyparse (void);
 
 /* Copy the second part of user declarations.  */
 
-#line 249 "parser.cc" /* yacc.c:358  */
+#line 251 "parser.cc" /* yacc.c:358  */
 
 #ifdef short
 # undef short
@@ -1569,7 +1571,7 @@ yyreduce:
   switch (yyn)
     {
         case 2:
-#line 125 "parser.y" /* yacc.c:1646  */
+#line 127 "parser.y" /* yacc.c:1646  */
     {                	
                     symbol *env = sym_tab->get_symbol((yyvsp[-3].procedure_head)->sym_p);
                     
@@ -1600,6 +1602,12 @@ yyreduce:
                                 cout << "\nQuad list for global level" << endl;
                                 cout << (quad_list *)q << endl;
                             }
+                            if (print_cfg) {
+                                cout << "\nControl flow graph for global level"
+                                     << endl;
+                                control_flow_graph cfg(q);
+                                cout << &cfg << endl;
+                            }
 
                             if (assembler) {
                                 cout << "Generating assembler, global level"
@@ -1615,19 +1623,19 @@ yyreduce:
                     // We close the global scope.
                     sym_tab->close_scope();                    
                 }
-#line 1619 "parser.cc" /* yacc.c:1646  */
+#line 1627 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 3:
-#line 174 "parser.y" /* yacc.c:1646  */
+#line 182 "parser.y" /* yacc.c:1646  */
     {
                     (yyval.procedure_head) = (yyvsp[-3].procedure_head);
                 }
-#line 1627 "parser.cc" /* yacc.c:1646  */
+#line 1635 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 4:
-#line 181 "parser.y" /* yacc.c:1646  */
+#line 189 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */                       
                     position_information *pos = new position_information((yylsp[-1]).first_line, (yylsp[-1]).first_column);
@@ -1635,40 +1643,40 @@ yyreduce:
                     (yyval.procedure_head) = new ast_procedurehead(pos, sym_tab->enter_procedure(pos, (yyvsp[0].pool_p)));
                     sym_tab->open_scope();
                 }
-#line 1639 "parser.cc" /* yacc.c:1646  */
+#line 1647 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 10:
-#line 203 "parser.y" /* yacc.c:1646  */
+#line 211 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     position_information *pos = new position_information((yylsp[-3]).first_line, (yylsp[-3]).first_column);
                     sym_tab->enter_constant(pos, (yyvsp[-3].pool_p), integer_type, (yyvsp[-1].integer)->value);
                 }
-#line 1649 "parser.cc" /* yacc.c:1646  */
+#line 1657 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 11:
-#line 209 "parser.y" /* yacc.c:1646  */
+#line 217 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     position_information *pos = new position_information((yylsp[-3]).first_line, (yylsp[-3]).first_column);
                     sym_tab->enter_constant(pos, (yyvsp[-3].pool_p), real_type, (yyvsp[-1].real)->value);
 
                 }
-#line 1660 "parser.cc" /* yacc.c:1646  */
+#line 1668 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 12:
-#line 216 "parser.y" /* yacc.c:1646  */
+#line 224 "parser.y" /* yacc.c:1646  */
     {
                     // This isn't implemented in Diesel... Do nothing.
                 }
-#line 1668 "parser.cc" /* yacc.c:1646  */
+#line 1676 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 13:
-#line 220 "parser.y" /* yacc.c:1646  */
+#line 228 "parser.y" /* yacc.c:1646  */
     {
 
                     // This part of code is a bit ugly, but it's needed to
@@ -1687,41 +1695,41 @@ yyreduce:
                             sym_tab->enter_constant(pos, (yyvsp[-3].pool_p), tmp->type, con->const_value.ival);
                         }                    
                 }
-#line 1691 "parser.cc" /* yacc.c:1646  */
+#line 1699 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 14:
-#line 239 "parser.y" /* yacc.c:1646  */
+#line 247 "parser.y" /* yacc.c:1646  */
     {
                     position_information *pos = new position_information((yylsp[-3]).first_line, (yylsp[-3]).first_column);
                     error(pos) << "missing ';'\n";
                     yyerrok;
                 }
-#line 1701 "parser.cc" /* yacc.c:1646  */
+#line 1709 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 19:
-#line 258 "parser.y" /* yacc.c:1646  */
+#line 266 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     position_information *pos = new position_information((yylsp[-3]).first_line, (yylsp[-3]).first_column);
                     sym_tab->enter_variable(pos, (yyvsp[-3].pool_p), (yyvsp[-1].id)->sym_p);
                 }
-#line 1711 "parser.cc" /* yacc.c:1646  */
+#line 1719 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 20:
-#line 264 "parser.y" /* yacc.c:1646  */
+#line 272 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     position_information *pos = new position_information((yylsp[-8]).first_line, (yylsp[-8]).first_column);           
                     sym_tab->enter_array(pos, (yyvsp[-8].pool_p), (yyvsp[-1].id)->sym_p, (yyvsp[-4].integer)->value);
                 }
-#line 1721 "parser.cc" /* yacc.c:1646  */
+#line 1729 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 21:
-#line 270 "parser.y" /* yacc.c:1646  */
+#line 278 "parser.y" /* yacc.c:1646  */
     {
                     // We enter an array: pool_pointer, type pointer,
                     // the id type of the constant, and the value of the
@@ -1769,11 +1777,11 @@ yyreduce:
                         }
                     }
                 }
-#line 1773 "parser.cc" /* yacc.c:1646  */
+#line 1781 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 26:
-#line 332 "parser.y" /* yacc.c:1646  */
+#line 340 "parser.y" /* yacc.c:1646  */
     {
                     symbol *env = sym_tab->get_symbol((yyvsp[-3].procedure_head)->sym_p);
 
@@ -1807,6 +1815,13 @@ yyreduce:
                                      << "\"" << endl;
                                 cout << (quad_list *)q << endl;
                             }
+                            if (print_cfg) {
+                                cout << "\nControl flow graph for \""
+                                     << sym_tab->pool_lookup(env->id)
+                                     << "\"" << endl;
+                                control_flow_graph cfg(q);
+                                cout << &cfg << endl;
+                            }
 
                             if (assembler) {
                                 cout << "Generating assembler for procedure \""
@@ -1820,11 +1835,11 @@ yyreduce:
                     // Close the current scope.
                     sym_tab->close_scope();
                 }
-#line 1824 "parser.cc" /* yacc.c:1646  */
+#line 1839 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 27:
-#line 379 "parser.y" /* yacc.c:1646  */
+#line 394 "parser.y" /* yacc.c:1646  */
     {
 
                     symbol *env = sym_tab->get_symbol((yyvsp[-3].function_head)->sym_p);
@@ -1859,6 +1874,13 @@ yyreduce:
                                      << "\"" << endl;
                                 cout << (quad_list *)q << endl;
                             }
+                            if (print_cfg) {
+                                cout << "\nControl flow graph for \""
+                                     << sym_tab->pool_lookup(env->id)
+                                     << "\"" << endl;
+                                control_flow_graph cfg(q);
+                                cout << &cfg << endl;
+                            }
 
                             if (assembler) {
                                 cout << "Generating assembler for function \""
@@ -1872,29 +1894,29 @@ yyreduce:
                     // Close the current scope.
                     sym_tab->close_scope();
                 }
-#line 1876 "parser.cc" /* yacc.c:1646  */
+#line 1898 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 28:
-#line 430 "parser.y" /* yacc.c:1646  */
+#line 452 "parser.y" /* yacc.c:1646  */
     {
                     (yyval.procedure_head) = (yyvsp[-4].procedure_head);
                 }
-#line 1884 "parser.cc" /* yacc.c:1646  */
+#line 1906 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 29:
-#line 437 "parser.y" /* yacc.c:1646  */
+#line 459 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     sym_tab->get_symbol((yyvsp[-6].function_head)->sym_p)->type = (yyvsp[-3].id)->sym_p;
                     (yyval.function_head) = (yyvsp[-6].function_head);
                 }
-#line 1894 "parser.cc" /* yacc.c:1646  */
+#line 1916 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 30:
-#line 446 "parser.y" /* yacc.c:1646  */
+#line 468 "parser.y" /* yacc.c:1646  */
     {
                     position_information *pos =
                         new position_information((yylsp[-1]).first_line,
@@ -1911,11 +1933,11 @@ yyreduce:
                     (yyval.procedure_head) = new ast_procedurehead(pos,
                                                proc_loc);
                 }
-#line 1915 "parser.cc" /* yacc.c:1646  */
+#line 1937 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 31:
-#line 466 "parser.y" /* yacc.c:1646  */
+#line 488 "parser.y" /* yacc.c:1646  */
     {
                     position_information *pos =
                         new position_information((yylsp[-1]).first_line,
@@ -1934,73 +1956,73 @@ yyreduce:
                     (yyval.function_head) = new ast_functionhead(pos,
                                               func_loc);
                 }
-#line 1938 "parser.cc" /* yacc.c:1646  */
+#line 1960 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 32:
-#line 488 "parser.y" /* yacc.c:1646  */
+#line 510 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     (yyval.expression_list) = (yyvsp[-1].expression_list);
                 }
-#line 1947 "parser.cc" /* yacc.c:1646  */
+#line 1969 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 33:
-#line 493 "parser.y" /* yacc.c:1646  */
+#line 515 "parser.y" /* yacc.c:1646  */
     {
                     (yyval.expression_list) = NULL;
                 }
-#line 1955 "parser.cc" /* yacc.c:1646  */
+#line 1977 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 34:
-#line 497 "parser.y" /* yacc.c:1646  */
+#line 519 "parser.y" /* yacc.c:1646  */
     {
                     position_information *pos = new position_information((yylsp[-2]).first_line, (yylsp[-2]).first_column);
                     error(pos) << "missing ')'\n";
                     yyerrok;
                 }
-#line 1965 "parser.cc" /* yacc.c:1646  */
+#line 1987 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 35:
-#line 503 "parser.y" /* yacc.c:1646  */
+#line 525 "parser.y" /* yacc.c:1646  */
     {
                     position_information *pos = new position_information((yylsp[-2]).first_line, (yylsp[-2]).first_column);
                     error(pos) << "missing '('\n";
                     yyerrok;
                 }
-#line 1975 "parser.cc" /* yacc.c:1646  */
+#line 1997 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 36:
-#line 509 "parser.y" /* yacc.c:1646  */
+#line 531 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     (yyval.expression_list) = NULL;
                 }
-#line 1984 "parser.cc" /* yacc.c:1646  */
+#line 2006 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 37:
-#line 517 "parser.y" /* yacc.c:1646  */
+#line 539 "parser.y" /* yacc.c:1646  */
     {
                     /* Note that we use expr_lists for parameters. This
                        is thus simply a place-holder in the grammar. */
                 }
-#line 1993 "parser.cc" /* yacc.c:1646  */
+#line 2015 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 38:
-#line 522 "parser.y" /* yacc.c:1646  */
+#line 544 "parser.y" /* yacc.c:1646  */
     {
                 }
-#line 2000 "parser.cc" /* yacc.c:1646  */
+#line 2022 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 39:
-#line 528 "parser.y" /* yacc.c:1646  */
+#line 550 "parser.y" /* yacc.c:1646  */
     {
                     position_information *pos =
                         new position_information((yylsp[-2]).first_line,
@@ -2015,20 +2037,20 @@ yyreduce:
                                                  (yyvsp[-2].pool_p),
                                                  (yyvsp[0].id)->sym_p);
                 }
-#line 2019 "parser.cc" /* yacc.c:1646  */
+#line 2041 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 40:
-#line 546 "parser.y" /* yacc.c:1646  */
+#line 568 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     (yyval.statement_list) = (yyvsp[-1].statement_list);
                 }
-#line 2028 "parser.cc" /* yacc.c:1646  */
+#line 2050 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 41:
-#line 554 "parser.y" /* yacc.c:1646  */
+#line 576 "parser.y" /* yacc.c:1646  */
     {
                     position_information *pos = new position_information((yylsp[0]).first_line, (yylsp[0]).first_column);
                     /* Your code here */
@@ -2039,11 +2061,11 @@ yyreduce:
                     }                    
                     
                 }
-#line 2043 "parser.cc" /* yacc.c:1646  */
+#line 2065 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 42:
-#line 565 "parser.y" /* yacc.c:1646  */
+#line 587 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */           
                     position_information *pos = new position_information((yylsp[-2]).first_line, (yylsp[-2]).first_column);                    
@@ -2053,477 +2075,477 @@ yyreduce:
                         (yyval.statement_list) = new ast_stmt_list(pos, (yyvsp[0].statement), (yyvsp[-2].statement_list));
                     }
                 }
-#line 2057 "parser.cc" /* yacc.c:1646  */
+#line 2079 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 43:
-#line 578 "parser.y" /* yacc.c:1646  */
+#line 600 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     position_information *pos = new position_information((yylsp[-6]).first_line, (yylsp[-6]).first_column);
                     (yyval.statement) = new ast_if(pos, (yyvsp[-5].expression), (yyvsp[-3].statement_list), (yyvsp[-2].elsif_list), (yyvsp[-1].statement_list));
                 }
-#line 2067 "parser.cc" /* yacc.c:1646  */
+#line 2089 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 44:
-#line 584 "parser.y" /* yacc.c:1646  */
+#line 606 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */                    
                     position_information *pos = new position_information((yylsp[-4]).first_line, (yylsp[-4]).first_column);
                     (yyval.statement) = new ast_while(pos, (yyvsp[-3].expression), (yyvsp[-1].statement_list));
                 }
-#line 2077 "parser.cc" /* yacc.c:1646  */
+#line 2099 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 45:
-#line 590 "parser.y" /* yacc.c:1646  */
+#line 612 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     position_information *pos = new position_information((yylsp[-3]).first_line, (yylsp[-3]).first_column);
                     (yyval.statement) = new ast_procedurecall(pos, (yyvsp[-3].id), (yyvsp[-1].expression_list));
                 }
-#line 2087 "parser.cc" /* yacc.c:1646  */
+#line 2109 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 46:
-#line 596 "parser.y" /* yacc.c:1646  */
+#line 618 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     position_information *pos = new position_information((yylsp[-1]).first_line, (yylsp[-1]).first_column);
                     (yyval.statement) = new ast_assign(pos, (yyvsp[-2].lvalue), (yyvsp[0].expression));
                 }
-#line 2097 "parser.cc" /* yacc.c:1646  */
+#line 2119 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 47:
-#line 602 "parser.y" /* yacc.c:1646  */
+#line 624 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     //cout << "T_RETURN - " << $2 << endl;
                     position_information *pos = new position_information((yylsp[-1]).first_line, (yylsp[-1]).first_column);
                     (yyval.statement) = new ast_return(pos, (yyvsp[0].expression));
                 }
-#line 2108 "parser.cc" /* yacc.c:1646  */
+#line 2130 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 48:
-#line 609 "parser.y" /* yacc.c:1646  */
+#line 631 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     position_information *pos = new position_information((yylsp[0]).first_line, (yylsp[0]).first_column);
                     (yyval.statement) = new ast_return(pos);
                 }
-#line 2118 "parser.cc" /* yacc.c:1646  */
+#line 2140 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 49:
-#line 615 "parser.y" /* yacc.c:1646  */
+#line 637 "parser.y" /* yacc.c:1646  */
     {
                     (yyval.statement) = NULL;
                 }
-#line 2126 "parser.cc" /* yacc.c:1646  */
+#line 2148 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 50:
-#line 621 "parser.y" /* yacc.c:1646  */
+#line 643 "parser.y" /* yacc.c:1646  */
     {
                     (yyval.lvalue) = (yyvsp[0].id);
                 }
-#line 2134 "parser.cc" /* yacc.c:1646  */
+#line 2156 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 51:
-#line 625 "parser.y" /* yacc.c:1646  */
+#line 647 "parser.y" /* yacc.c:1646  */
     {
                     (yyval.lvalue) = new ast_indexed((yyvsp[-3].id)->pos,
                                          (yyvsp[-3].id),
                                          (yyvsp[-1].expression));
                 }
-#line 2144 "parser.cc" /* yacc.c:1646  */
+#line 2166 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 52:
-#line 631 "parser.y" /* yacc.c:1646  */
+#line 653 "parser.y" /* yacc.c:1646  */
     {
                     (yyval.lvalue) = NULL;
                 }
-#line 2152 "parser.cc" /* yacc.c:1646  */
+#line 2174 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 53:
-#line 638 "parser.y" /* yacc.c:1646  */
+#line 660 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     (yyval.expression) = (yyvsp[0].id);
                 }
-#line 2161 "parser.cc" /* yacc.c:1646  */
+#line 2183 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 54:
-#line 643 "parser.y" /* yacc.c:1646  */
+#line 665 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     position_information *pos = new position_information((yylsp[-3]).first_line, (yylsp[-3]).first_column);
                     (yyval.expression) = new ast_indexed(pos, (yyvsp[-3].id), (yyvsp[-1].expression));
                 }
-#line 2171 "parser.cc" /* yacc.c:1646  */
+#line 2193 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 55:
-#line 649 "parser.y" /* yacc.c:1646  */
+#line 671 "parser.y" /* yacc.c:1646  */
     {
                     position_information *pos = new position_information((yylsp[-3]).first_line, (yylsp[-3]).first_column);
                     error(pos) << "missing '['\n";
                     yyerrok;
                 }
-#line 2181 "parser.cc" /* yacc.c:1646  */
+#line 2203 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 56:
-#line 655 "parser.y" /* yacc.c:1646  */
+#line 677 "parser.y" /* yacc.c:1646  */
     {
                     position_information *pos = new position_information((yylsp[-3]).first_line, (yylsp[-3]).first_column);
                     error(pos) << "missing ']'\n";
                     yyerrok;
                 }
-#line 2191 "parser.cc" /* yacc.c:1646  */
+#line 2213 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 57:
-#line 664 "parser.y" /* yacc.c:1646  */
+#line 686 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     position_information *pos = new position_information((yylsp[-1]).first_line, (yylsp[-1]).first_column);
                     (yyval.elsif_list) = new ast_elsif_list(pos, (yyvsp[0].elsif), (yyvsp[-1].elsif_list));
                 }
-#line 2201 "parser.cc" /* yacc.c:1646  */
+#line 2223 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 58:
-#line 670 "parser.y" /* yacc.c:1646  */
+#line 692 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     (yyval.elsif_list) = NULL;
                 }
-#line 2210 "parser.cc" /* yacc.c:1646  */
+#line 2232 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 59:
-#line 678 "parser.y" /* yacc.c:1646  */
+#line 700 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     position_information *pos = new position_information((yylsp[-3]).first_line, (yylsp[-3]).first_column);
                     (yyval.elsif) = new ast_elsif(pos, (yyvsp[-2].expression), (yyvsp[0].statement_list));
                 }
-#line 2220 "parser.cc" /* yacc.c:1646  */
+#line 2242 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 60:
-#line 687 "parser.y" /* yacc.c:1646  */
+#line 709 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     (yyval.statement_list) = (yyvsp[0].statement_list);
                 }
-#line 2229 "parser.cc" /* yacc.c:1646  */
+#line 2251 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 61:
-#line 692 "parser.y" /* yacc.c:1646  */
+#line 714 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     (yyval.statement_list) = NULL;
                 }
-#line 2238 "parser.cc" /* yacc.c:1646  */
+#line 2260 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 62:
-#line 700 "parser.y" /* yacc.c:1646  */
+#line 722 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     (yyval.expression_list) = (yyvsp[0].expression_list);
                 }
-#line 2247 "parser.cc" /* yacc.c:1646  */
+#line 2269 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 63:
-#line 705 "parser.y" /* yacc.c:1646  */
+#line 727 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     (yyval.expression_list) = NULL;
                 }
-#line 2256 "parser.cc" /* yacc.c:1646  */
+#line 2278 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 64:
-#line 713 "parser.y" /* yacc.c:1646  */
+#line 735 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     position_information *pos = new position_information((yylsp[0]).first_line, (yylsp[0]).first_column);
                     (yyval.expression_list) = new ast_expr_list(pos, (yyvsp[0].expression));
                 }
-#line 2266 "parser.cc" /* yacc.c:1646  */
+#line 2288 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 65:
-#line 719 "parser.y" /* yacc.c:1646  */
+#line 741 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */                         
                     position_information *pos = new position_information((yylsp[-2]).first_line, (yylsp[-2]).first_column);
                     (yyval.expression_list) = new ast_expr_list(pos, (yyvsp[0].expression), (yyvsp[-2].expression_list));
                 }
-#line 2276 "parser.cc" /* yacc.c:1646  */
+#line 2298 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 66:
-#line 728 "parser.y" /* yacc.c:1646  */
+#line 750 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     (yyval.expression) = (yyvsp[0].expression);
                 }
-#line 2285 "parser.cc" /* yacc.c:1646  */
+#line 2307 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 67:
-#line 733 "parser.y" /* yacc.c:1646  */
+#line 755 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */     
                     position_information *pos = new position_information((yylsp[-2]).first_line, (yylsp[-2]).first_column);
                     (yyval.expression) = new ast_equal(pos, (yyvsp[-2].expression), (yyvsp[0].expression));                    
                 }
-#line 2295 "parser.cc" /* yacc.c:1646  */
+#line 2317 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 68:
-#line 739 "parser.y" /* yacc.c:1646  */
+#line 761 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */                    
                     position_information *pos = new position_information((yylsp[-2]).first_line, (yylsp[-2]).first_column);
                     (yyval.expression) = new ast_notequal(pos, (yyvsp[-2].expression), (yyvsp[0].expression));
                 }
-#line 2305 "parser.cc" /* yacc.c:1646  */
+#line 2327 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 69:
-#line 745 "parser.y" /* yacc.c:1646  */
+#line 767 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */                    
                     position_information *pos = new position_information((yylsp[-2]).first_line, (yylsp[-2]).first_column);
                     (yyval.expression) = new ast_lessthan(pos, (yyvsp[-2].expression), (yyvsp[0].expression));
                 }
-#line 2315 "parser.cc" /* yacc.c:1646  */
+#line 2337 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 70:
-#line 751 "parser.y" /* yacc.c:1646  */
+#line 773 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     position_information *pos = new position_information((yylsp[-2]).first_line, (yylsp[-2]).first_column);
                     (yyval.expression) = new ast_greaterthan(pos, (yyvsp[-2].expression), (yyvsp[0].expression));
                 }
-#line 2325 "parser.cc" /* yacc.c:1646  */
+#line 2347 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 71:
-#line 760 "parser.y" /* yacc.c:1646  */
+#line 782 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     (yyval.expression) = (yyvsp[0].expression);
                 }
-#line 2334 "parser.cc" /* yacc.c:1646  */
+#line 2356 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 72:
-#line 765 "parser.y" /* yacc.c:1646  */
+#line 787 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     (yyval.expression) = (yyvsp[0].expression);
                 }
-#line 2343 "parser.cc" /* yacc.c:1646  */
+#line 2365 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 73:
-#line 770 "parser.y" /* yacc.c:1646  */
+#line 792 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     position_information *pos = new position_information((yylsp[-1]).first_line, (yylsp[-1]).first_column);
                     (yyval.expression) = new ast_uminus(pos, (yyvsp[0].expression));
                 }
-#line 2353 "parser.cc" /* yacc.c:1646  */
+#line 2375 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 74:
-#line 776 "parser.y" /* yacc.c:1646  */
+#line 798 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     position_information *pos = new position_information((yylsp[-2]).first_line, (yylsp[-2]).first_column);
                     (yyval.expression) = new ast_or(pos, (yyvsp[-2].expression), (yyvsp[0].expression));
                 }
-#line 2363 "parser.cc" /* yacc.c:1646  */
+#line 2385 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 75:
-#line 782 "parser.y" /* yacc.c:1646  */
+#line 804 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     position_information *pos = new position_information((yylsp[-2]).first_line, (yylsp[-2]).first_column);
                     (yyval.expression) = new ast_add(pos, (yyvsp[-2].expression), (yyvsp[0].expression));
                 }
-#line 2373 "parser.cc" /* yacc.c:1646  */
+#line 2395 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 76:
-#line 788 "parser.y" /* yacc.c:1646  */
+#line 810 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     position_information *pos = new position_information((yylsp[-2]).first_line, (yylsp[-2]).first_column);
                     (yyval.expression) = new ast_sub(pos, (yyvsp[-2].expression), (yyvsp[0].expression));   
                 }
-#line 2383 "parser.cc" /* yacc.c:1646  */
+#line 2405 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 77:
-#line 797 "parser.y" /* yacc.c:1646  */
+#line 819 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     (yyval.expression) = (yyvsp[0].expression);
                 }
-#line 2392 "parser.cc" /* yacc.c:1646  */
+#line 2414 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 78:
-#line 802 "parser.y" /* yacc.c:1646  */
+#line 824 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     position_information *pos = new position_information((yylsp[-2]).first_line, (yylsp[-2]).first_column);
                     (yyval.expression) = new ast_and(pos, (yyvsp[-2].expression), (yyvsp[0].expression));
                 }
-#line 2402 "parser.cc" /* yacc.c:1646  */
+#line 2424 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 79:
-#line 808 "parser.y" /* yacc.c:1646  */
+#line 830 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     position_information *pos = new position_information((yylsp[-2]).first_line, (yylsp[-2]).first_column);
                     (yyval.expression) = new ast_mult(pos, (yyvsp[-2].expression), (yyvsp[0].expression));
                 }
-#line 2412 "parser.cc" /* yacc.c:1646  */
+#line 2434 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 80:
-#line 814 "parser.y" /* yacc.c:1646  */
+#line 836 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     position_information *pos = new position_information((yylsp[-2]).first_line, (yylsp[-2]).first_column);
                     (yyval.expression) = new ast_divide(pos, (yyvsp[-2].expression), (yyvsp[0].expression));
 
                 }
-#line 2423 "parser.cc" /* yacc.c:1646  */
+#line 2445 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 81:
-#line 821 "parser.y" /* yacc.c:1646  */
+#line 843 "parser.y" /* yacc.c:1646  */
     {
                     position_information *pos = new position_information((yylsp[-2]).first_line, (yylsp[-2]).first_column);
                     (yyval.expression) = new ast_idiv(pos, (yyvsp[-2].expression), (yyvsp[0].expression));
                 }
-#line 2432 "parser.cc" /* yacc.c:1646  */
+#line 2454 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 82:
-#line 826 "parser.y" /* yacc.c:1646  */
+#line 848 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     position_information *pos = new position_information((yylsp[-2]).first_line, (yylsp[-2]).first_column);
                     (yyval.expression) = new ast_mod(pos, (yyvsp[-2].expression), (yyvsp[0].expression));
                 }
-#line 2442 "parser.cc" /* yacc.c:1646  */
+#line 2464 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 83:
-#line 835 "parser.y" /* yacc.c:1646  */
+#line 857 "parser.y" /* yacc.c:1646  */
     {
                     (yyval.expression) = (yyvsp[0].expression);
                 }
-#line 2450 "parser.cc" /* yacc.c:1646  */
+#line 2472 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 84:
-#line 839 "parser.y" /* yacc.c:1646  */
+#line 861 "parser.y" /* yacc.c:1646  */
     {
                     (yyval.expression) = (yyvsp[0].function_call);
                 }
-#line 2458 "parser.cc" /* yacc.c:1646  */
+#line 2480 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 85:
-#line 843 "parser.y" /* yacc.c:1646  */
+#line 865 "parser.y" /* yacc.c:1646  */
     {
                     (yyval.expression) = (yyvsp[0].integer);
                 }
-#line 2466 "parser.cc" /* yacc.c:1646  */
+#line 2488 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 86:
-#line 847 "parser.y" /* yacc.c:1646  */
+#line 869 "parser.y" /* yacc.c:1646  */
     {
                     (yyval.expression) = (yyvsp[0].real);
                 }
-#line 2474 "parser.cc" /* yacc.c:1646  */
+#line 2496 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 87:
-#line 851 "parser.y" /* yacc.c:1646  */
+#line 873 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     position_information *pos = new position_information((yylsp[-1]).first_line, (yylsp[-1]).first_column);
                     (yyval.expression) = new ast_not(pos, (yyvsp[0].expression));
                 }
-#line 2484 "parser.cc" /* yacc.c:1646  */
+#line 2506 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 88:
-#line 857 "parser.y" /* yacc.c:1646  */
+#line 879 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     (yyval.expression) = (yyvsp[-1].expression);
                 }
-#line 2493 "parser.cc" /* yacc.c:1646  */
+#line 2515 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 89:
-#line 862 "parser.y" /* yacc.c:1646  */
+#line 884 "parser.y" /* yacc.c:1646  */
     {
                     position_information *pos = new position_information((yylsp[-2]).first_line, (yylsp[-2]).first_column);                    
                     error(pos) << "missing ')'\n";
                     yyerrok;
                 }
-#line 2503 "parser.cc" /* yacc.c:1646  */
+#line 2525 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 90:
-#line 872 "parser.y" /* yacc.c:1646  */
+#line 894 "parser.y" /* yacc.c:1646  */
     {
                     /* Your code here */
                     position_information *pos = new position_information((yylsp[-3]).first_line, (yylsp[-3]).first_column);
                     (yyval.function_call) = new ast_functioncall(pos, (yyvsp[-3].id), (yyvsp[-1].expression_list));
                 }
-#line 2513 "parser.cc" /* yacc.c:1646  */
+#line 2535 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 91:
-#line 878 "parser.y" /* yacc.c:1646  */
+#line 900 "parser.y" /* yacc.c:1646  */
     {
                     position_information *pos = new position_information((yylsp[-3]).first_line, (yylsp[-3]).first_column);
                     error(pos) << "missing ')'\n";
                     yyerrok;
                 }
-#line 2523 "parser.cc" /* yacc.c:1646  */
+#line 2545 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 92:
-#line 887 "parser.y" /* yacc.c:1646  */
+#line 909 "parser.y" /* yacc.c:1646  */
     {
                     position_information *pos =
                         new position_information((yylsp[0]).first_line,
@@ -2533,11 +2555,11 @@ yyreduce:
                     (yyval.integer) = new ast_integer(pos,
                                          (yyvsp[0].ival));
                 }
-#line 2537 "parser.cc" /* yacc.c:1646  */
+#line 2559 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 93:
-#line 900 "parser.y" /* yacc.c:1646  */
+#line 922 "parser.y" /* yacc.c:1646  */
     {
                     position_information *pos =
                         new position_information((yylsp[0]).first_line,
@@ -2547,11 +2569,11 @@ yyreduce:
                     (yyval.real) = new ast_real(pos,
                                       (yyvsp[0].rval));
                 }
-#line 2551 "parser.cc" /* yacc.c:1646  */
+#line 2573 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 94:
-#line 913 "parser.y" /* yacc.c:1646  */
+#line 935 "parser.y" /* yacc.c:1646  */
     {
                     // Make sure this id is really declared as a type.
                     // debug() << "type_id -> id: "
@@ -2563,11 +2585,11 @@ yyreduce:
                     }
                     (yyval.id) = (yyvsp[0].id);
                 }
-#line 2567 "parser.cc" /* yacc.c:1646  */
+#line 2589 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 95:
-#line 928 "parser.y" /* yacc.c:1646  */
+#line 950 "parser.y" /* yacc.c:1646  */
     {
                     // Make sure this id is really declared as a constant.
                     // debug() << "const_id -> id: " << $1->sym_p << endl;
@@ -2578,11 +2600,11 @@ yyreduce:
                     }
                     (yyval.id) = (yyvsp[0].id);
                 }
-#line 2582 "parser.cc" /* yacc.c:1646  */
+#line 2604 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 96:
-#line 942 "parser.y" /* yacc.c:1646  */
+#line 964 "parser.y" /* yacc.c:1646  */
     {
                     // Make sure this id is really declared as an lvariable.
                     // debug() << "lvar_id -> id: " << $1->sym_p << endl;
@@ -2594,11 +2616,11 @@ yyreduce:
                     }
                     (yyval.id) = (yyvsp[0].id);
                 }
-#line 2598 "parser.cc" /* yacc.c:1646  */
+#line 2620 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 97:
-#line 955 "parser.y" /* yacc.c:1646  */
+#line 977 "parser.y" /* yacc.c:1646  */
     {
                     // Make sure this id is really declared as an rvariable.
                     // debug() << "rvar_id -> id: " << $1->sym_p << endl;
@@ -2612,11 +2634,11 @@ yyreduce:
                     }
                     (yyval.id) = (yyvsp[0].id);
                 }
-#line 2616 "parser.cc" /* yacc.c:1646  */
+#line 2638 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 98:
-#line 972 "parser.y" /* yacc.c:1646  */
+#line 994 "parser.y" /* yacc.c:1646  */
     {
                     // Make sure this id is really declared as a procedure.
                     // debug() << "proc_id -> id: " << $1->sym_p << endl;
@@ -2627,11 +2649,11 @@ yyreduce:
                     }
                     (yyval.id) = (yyvsp[0].id);
                 }
-#line 2631 "parser.cc" /* yacc.c:1646  */
+#line 2653 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 99:
-#line 986 "parser.y" /* yacc.c:1646  */
+#line 1008 "parser.y" /* yacc.c:1646  */
     {
                     // Make sure this id is really declared as a function.
                     //debug() << "func_id -> id: " << $1->sym_p << endl;
@@ -2642,11 +2664,11 @@ yyreduce:
                     }
                     (yyval.id) = (yyvsp[0].id);
                 }
-#line 2646 "parser.cc" /* yacc.c:1646  */
+#line 2668 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 100:
-#line 1000 "parser.y" /* yacc.c:1646  */
+#line 1022 "parser.y" /* yacc.c:1646  */
     {
                     // Make sure this id is really declared as an array.
                     // debug() << "array_id -> id: " << $1->sym_p << endl;
@@ -2657,11 +2679,11 @@ yyreduce:
                     }
                     (yyval.id) = (yyvsp[0].id);
                 }
-#line 2661 "parser.cc" /* yacc.c:1646  */
+#line 2683 "parser.cc" /* yacc.c:1646  */
     break;
 
   case 101:
-#line 1014 "parser.y" /* yacc.c:1646  */
+#line 1036 "parser.y" /* yacc.c:1646  */
     {
                     sym_index sym_p;    // Used to find previous use of symbol.
                     position_information *pos =
@@ -2681,11 +2703,11 @@ yyreduce:
                                     sym_p);
                     (yyval.id)->type = sym_tab->get_symbol_type(sym_p);
                 }
-#line 2685 "parser.cc" /* yacc.c:1646  */
+#line 2707 "parser.cc" /* yacc.c:1646  */
     break;
 
 
-#line 2689 "parser.cc" /* yacc.c:1646  */
+#line 2711 "parser.cc" /* yacc.c:1646  */
       default: break;
     }
   /* User semantic actions sometimes alter yychar, and that requires
@@ -2920,5 +2942,5 @@ yyreturn:
 #endif
   return yyresult;
 }
-#line 1036 "parser.y" /* yacc.c:1906  */
+#line 1058 "parser.y" /* yacc.c:1906  */
 
@@ -3,6 +3,7 @@
 #include "semantic.hh"
 #include "optimize.hh"
 #include "codegen.hh"
+#include "cfg.hh"
 
 /* Defined in parser.cc */
 extern char *yytext;
@@ -30,6 +31,7 @@ extern void yyerror(string);
    given to the 'diesel' script. */
 extern bool print_ast;
 extern bool print_quads;
+extern bool print_cfg;
 extern bool typecheck;
 extern bool optimize;
 extern bool quads;
@@ -152,6 +154,12 @@ program         : prog_decl subprog_part comp_stmt T_DOT
                                 cout << "\nQuad list for global level" << endl;
                                 cout << (quad_list *)q << endl;
                             }
+                            if (print_cfg) {
+                                cout << "\nControl flow graph for global level"
+                                     << endl;
+                                control_flow_graph cfg(q);
+                                cout << &cfg << endl;
+                            }
 
                             if (assembler) {
                                 cout << "Generating assembler, global level"
@@ -362,6 +370,13 @@ subprog_decl    : proc_decl subprog_part comp_stmt T_SEMICOLON
                                      << "\"" << endl;
                                 cout << (quad_list *)q << endl;
                             }
+                            if (print_cfg) {
+                                cout << "\nControl flow graph for \""
+                                     << sym_tab->pool_lookup(env->id)
+                                     << "\"" << endl;
+                                control_flow_graph cfg(q);
+                                cout << &cfg << endl;
+                            }
 
                             if (assembler) {
                                 cout << "Generating assembler for procedure \""
@@ -410,6 +425,13 @@ subprog_decl    : proc_decl subprog_part comp_stmt T_SEMICOLON
                                      << "\"" << endl;
                                 cout << (quad_list *)q << endl;
                             }
+                            if (print_cfg) {
+                                cout << "\nControl flow graph for \""
+                                     << sym_tab->pool_lookup(env->id)
+                                     << "\"" << endl;
+                                control_flow_graph cfg(q);
+                                cout << &cfg << endl;
+                            }
 
                             if (assembler) {
                                 cout << "Generating assembler for function \""
@@ -0,0 +1,1693 @@
+#include <algorithm>
+#include <climits>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "quadopt.hh"
+#include "codegen.hh"
+#include "ssa.hh"
+
+// Defined in main.cc.
+extern int optimize_level;
+
+/*** This file contains the quad optimizer, see quadopt.hh. ***/
+
+quad_optimizer *quad_opt = new quad_optimizer();
+
+/* Returns true if a quad computes a real value. */
+static bool real_result(quad_op_type op) {
+	switch (op) {
+	case q_rload:
+	case q_ruminus:
+	case q_rplus:
+	case q_rminus:
+	case q_rmult:
+	case q_rdivide:
+	case q_itor:
+	case q_rrindex:
+	case q_rderef:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* What a value is computed from: an op code and up to three arguments,
+ which are value numbers, constants or array symbols depending on the op. */
+struct value_key {
+	long op;
+	long arg1;
+	long arg2;
+	long arg3;
+
+	value_key(long op, long arg1, long arg2 = 0, long arg3 = 0) :
+		op(op), arg1(arg1), arg2(arg2), arg3(arg3) {
+	}
+
+	bool operator<(const value_key &k) const {
+		if (op != k.op) {
+			return op < k.op;
+		}
+		if (arg1 != k.arg1) {
+			return arg1 < k.arg1;
+		}
+		if (arg2 != k.arg2) {
+			return arg2 < k.arg2;
+		}
+		return arg3 < k.arg3;
+	}
+};
+
+/* The values known within a basic block. Values are numbered from 0, and
+ two symbols holding the same value number are known to be equal. Array
+ elements are told apart by a version number for each array, which changes
+ whenever something may have been stored into it. */
+class value_table {
+private:
+	// The number of values so far.
+	int values;
+
+	// The value each variable holds. Variables not in the map hold some
+	// unknown value, which is numbered when they're first used.
+	map<sym_index, int> current;
+
+	// Every variable that has been given each value. Those which still
+	// hold it are the ones whose entry in current is the same value.
+	vector<vector<sym_index> > holders;
+
+	// The values that have been computed.
+	map<value_key, int> known;
+
+	// For the values that are addresses computed by q_lindex, the array
+	// and the value of the index.
+	map<int, pair<sym_index, int> > addresses;
+
+	// The version of each array. Arrays not in the map are at
+	// memory_version, which changes when anything may have been stored
+	// anywhere.
+	map<sym_index, int> array_version;
+	int memory_version;
+	int versions;
+
+public:
+	value_table() :
+		values(0), memory_version(0), versions(0) {
+	}
+
+	int new_value() {
+		holders.push_back(vector<sym_index>());
+		return values++;
+	}
+
+	int value_of(sym_index sym_p) {
+		map<sym_index, int>::iterator i = current.find(sym_p);
+		if (i != current.end()) {
+			return i->second;
+		}
+
+		// Named constants have the same value as loading the constant.
+		symbol *sym = sym_tab->get_symbol(sym_p);
+		int value;
+		if (sym->tag == SYM_CONST) {
+			constant_symbol *con = sym->get_constant_symbol();
+			value_key key = sym->type == real_type
+					? value_key(q_rload, sym_tab->ieee(con->const_value.rval))
+					: value_key(q_iload, con->const_value.ival);
+			value = lookup(key);
+			if (value == -1) {
+				value = new_value();
+				enter(key, value);
+			}
+			current[sym_p] = value;
+			return value;
+		}
+
+		value = new_value();
+		assign(sym_p, value);
+		return value;
+	}
+
+	void assign(sym_index sym_p, int value) {
+		current[sym_p] = value;
+		holders[value].push_back(sym_p);
+	}
+
+	// Returns a variable holding a value, the one given it first if there
+	// are several, or NULL_SYM.
+	sym_index holder(int value) {
+		for (unsigned int i = 0; i < holders[value].size(); i++) {
+			map<sym_index, int>::iterator j = current.find(holders[value][i]);
+			if (j != current.end() && j->second == value) {
+				return j->first;
+			}
+		}
+		return NULL_SYM;
+	}
+
+	int lookup(const value_key &key) {
+		map<value_key, int>::iterator i = known.find(key);
+		return i == known.end() ? -1 : i->second;
+	}
+
+	void enter(const value_key &key, int value) {
+		known[key] = value;
+	}
+
+	void enter_address(int value, sym_index array, int index) {
+		addresses[value] = make_pair(array, index);
+	}
+
+	// Returns the array and index of an address, or false if unknown.
+	bool address_of(int value, sym_index *array, int *index) {
+		map<int, pair<sym_index, int> >::iterator i = addresses.find(value);
+		if (i == addresses.end()) {
+			return false;
+		}
+		*array = i->second.first;
+		*index = i->second.second;
+		return true;
+	}
+
+	int version_of(sym_index array) {
+		map<sym_index, int>::iterator i = array_version.find(array);
+		return i == array_version.end() ? memory_version : i->second;
+	}
+
+	// Called when an array is stored into. Returns the new version.
+	int store_array(sym_index array) {
+		return array_version[array] = ++versions;
+	}
+
+	// Called when something has been stored into an unknown array.
+	void store_memory() {
+		array_version.clear();
+		memory_version = ++versions;
+	}
+
+	// Called after a call, which may change anything but temp vars. They
+	// are local to the procedure whose quads use them and can't be seen by
+	// any other procedure.
+	void forget_variables() {
+		map<sym_index, int>::iterator i = current.begin();
+		while (i != current.end()) {
+			symbol *sym = sym_tab->get_symbol(i->first);
+			if (sym->tag != SYM_CONST && !sym_tab->is_temp_var(i->first)) {
+				current.erase(i++);
+			} else {
+				++i;
+			}
+		}
+		store_memory();
+	}
+};
+
+/* Looks up the value a quad computes. If some variable already holds it,
+ the quad is replaced by an assignment from that variable. */
+static void compute(quad_list *q_list, int index, quadruple &q,
+		value_table &table, const value_key &key) {
+	int value = table.lookup(key);
+
+	if (value == -1) {
+		value = table.new_value();
+		table.enter(key, value);
+	} else {
+		sym_index from = table.holder(value);
+		// If the result already holds the value the quad could be removed
+		// altogether, but that's left to dead code elimination.
+		if (from != NULL_SYM && from != q.sym3) {
+			q_list->set(index, quadruple(real_result(q.op_code) ? q_rassign
+					: q_iassign, from, NULL_SYM, q.sym3));
+		}
+	}
+	table.assign(q.sym3, value);
+}
+
+void quad_optimizer::number_values(quad_list *q_list, basic_block &block) {
+	value_table table;
+
+	for (int i = block.first; i <= block.last; i++) {
+		quadruple q = q_list->get(i);
+
+		switch (q.op_code) {
+		case q_rload:
+		case q_iload: {
+			value_key key(q.op_code, q.int1);
+			int value = table.lookup(key);
+			if (value == -1) {
+				value = table.new_value();
+				table.enter(key, value);
+			}
+			table.assign(q.sym3, value);
+			break;
+		}
+
+		case q_inot:
+		case q_ruminus:
+		case q_iuminus:
+		case q_itor:
+			compute(q_list, i, q, table,
+					value_key(q.op_code, table.value_of(q.sym1)));
+			break;
+
+		case q_rplus:
+		case q_iplus:
+		case q_ior:
+		case q_iand:
+		case q_rmult:
+		case q_imult:
+		case q_req:
+		case q_ieq:
+		case q_rne:
+		case q_ine: {
+			// Commutative, so put the arguments in a fixed order.
+			int a = table.value_of(q.sym1);
+			int b = table.value_of(q.sym2);
+			compute(q_list, i, q, table,
+					value_key(q.op_code, min(a, b), max(a, b)));
+			break;
+		}
+
+		case q_rminus:
+		case q_iminus:
+		case q_rdivide:
+		case q_idivide:
+		case q_imod:
+		case q_rlt:
+		case q_ilt:
+			compute(q_list, i, q, table, value_key(q.op_code,
+					table.value_of(q.sym1), table.value_of(q.sym2)));
+			break;
+
+		case q_rgt:
+		case q_igt:
+			// a > b is the same as b < a.
+			compute(q_list, i, q, table,
+					value_key(q.op_code == q_rgt ? q_rlt : q_ilt,
+							table.value_of(q.sym2), table.value_of(q.sym1)));
+			break;
+
+		case q_ishl:
+		case q_ishr:
+		case q_imask:
+		case q_idivc:
+		case q_imodc:
+			compute(q_list, i, q, table,
+					value_key(q.op_code, table.value_of(q.sym1), q.int2));
+			break;
+
+		case q_lindex: {
+			int index = table.value_of(q.sym2);
+			compute(q_list, i, q, table, value_key(q_lindex, q.sym1, index));
+			table.enter_address(table.value_of(q.sym3), q.sym1, index);
+			break;
+		}
+
+		case q_rrindex:
+		case q_irindex:
+			compute(q_list, i, q, table, value_key(q.op_code, q.sym1,
+					table.value_of(q.sym2), table.version_of(q.sym1)));
+			break;
+
+		case q_rderef:
+		case q_ideref:
+			// The array isn't known, so the element can't be either.
+			table.assign(q.sym3, table.new_value());
+			break;
+
+		case q_rstore:
+		case q_istore: {
+			sym_index array;
+			int index;
+			int value = table.value_of(q.sym1);
+			if (table.address_of(table.value_of(q.sym3), &array, &index)) {
+				// Loading the element right back gives the value stored.
+				int version = table.store_array(array);
+				table.enter(value_key(q.op_code == q_rstore ? q_rrindex
+						: q_irindex, array, index, version), value);
+			} else {
+				table.store_memory();
+			}
+			break;
+		}
+
+		case q_rassign:
+		case q_iassign:
+			table.assign(q.sym3, table.value_of(q.sym1));
+			break;
+
+		case q_call:
+			table.forget_variables();
+			if (q.sym3 != NULL_SYM) {
+				table.assign(q.sym3, table.new_value());
+			}
+			break;
+
+		default:
+			// Jumps, labels, returns and parameters only use values.
+			break;
+		}
+	}
+}
+
+/* Returns the variable a quad assigns, or NULL_SYM. */
+static sym_index defined_by(const quadruple &q) {
+	if (!quad_assigns(q.op_code) || !quad_variable(q.sym3)) {
+		return NULL_SYM;
+	}
+	return q.sym3;
+}
+
+/* Appends the variables a quad reads to a vector. Calls also read all
+ variables but temp vars, which isn't included here. */
+static void used_by(const quadruple &q, vector<sym_index> &uses) {
+	sym_index args[3] = { q.sym1, q.sym2, q.sym3 };
+	for (int a = 0; a < 3; a++) {
+		if (quad_reads(q.op_code, a + 1) && quad_variable(args[a])) {
+			uses.push_back(args[a]);
+		}
+	}
+}
+
+/* Returns true if a quad may be removed when the variable it assigns isn't
+ used afterwards. */
+static bool removable(quad_op_type op) {
+	return op != q_call && op != q_nop;
+}
+
+/* Computes the value of an integer quad whose arguments are the constants a
+ and b, the same way the code generator would. Returns false if it can't be
+ done at compile time, ie for division by zero or overflow, which must
+ happen at run time. */
+static bool fold_int(quad_op_type op, long a, long b, long *result) {
+	unsigned long ua = a;
+	unsigned long ub = b;
+
+	switch (op) {
+	case q_inot:
+		*result = a == 0;
+		return true;
+	case q_iuminus:
+		*result = -ua;
+		return true;
+	case q_iplus:
+		*result = ua + ub;
+		return true;
+	case q_iminus:
+		*result = ua - ub;
+		return true;
+	case q_imult:
+		*result = ua * ub;
+		return true;
+	case q_ishl:
+		*result = ua << b;
+		return true;
+	case q_ishr:
+		b = 1L << b;
+		// Fall through, these divide by 2^b.
+	case q_idivide:
+	case q_idivc:
+		if (b == 0 || (a == LONG_MIN && b == -1)) {
+			return false;
+		}
+		*result = a / b;
+		return true;
+	case q_imask:
+		b = 1L << b;
+		// Fall through.
+	case q_imod:
+	case q_imodc:
+		if (b == 0 || (a == LONG_MIN && b == -1)) {
+			return false;
+		}
+		*result = a % b;
+		return true;
+	case q_ior:
+		*result = a != 0 || b != 0;
+		return true;
+	case q_iand:
+		*result = a != 0 && b != 0;
+		return true;
+	case q_ieq:
+		*result = a == b;
+		return true;
+	case q_ine:
+		*result = a != b;
+		return true;
+	case q_ilt:
+		*result = a < b;
+		return true;
+	case q_igt:
+		*result = a > b;
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* Returns the relation an integer quad comparing and jumping jumps unless,
+ or q_nop for other quads. */
+static quad_op_type jump_relation(quad_op_type op) {
+	switch (op) {
+	case q_ijnlt:
+		return q_ilt;
+	case q_ijngt:
+		return q_igt;
+	case q_ijneq:
+		return q_ieq;
+	case q_ijnne:
+		return q_ine;
+	default:
+		return q_nop;
+	}
+}
+
+/* Copy and constant propagation within a basic block. Arguments that are
+ temp vars copied from another variable are replaced by that variable, and
+ assignments from variables holding a known constant become loads of the
+ constant. Integer quads whose arguments are all known constants are folded
+ into a load, and conditional jumps on a known condition into a q_jmp or
+ nothing.
+ Variables which aren't temp vars are never replaced by a copy, since
+ reading them costs the same and the copy would have to be kept. Returns
+ true if a jump was changed, which changes the control flow graph. */
+bool quad_optimizer::propagate(quad_list *q_list, basic_block &block) {
+	map<sym_index, sym_index> copy_of;
+	map<sym_index, long> constant_of;
+	bool jumps_changed = false;
+
+	for (int i = block.first; i <= block.last; i++) {
+		quadruple q = q_list->get(i);
+		bool changed = false;
+
+		// Read the originals of copies.
+		sym_index *args[3] = { &q.sym1, &q.sym2, &q.sym3 };
+		for (int a = 0; a < 3; a++) {
+			if (!quad_reads(q.op_code, a + 1)) {
+				continue;
+			}
+			map<sym_index, sym_index>::iterator c = copy_of.find(*args[a]);
+			if (c != copy_of.end()) {
+				*args[a] = c->second;
+				changed = true;
+			}
+		}
+
+		// Fold what the constants allow.
+		map<sym_index, long>::iterator c1 = constant_of.find(q.sym1);
+		map<sym_index, long>::iterator c2 = constant_of.find(q.sym2);
+		map<sym_index, long>::iterator c3 = constant_of.find(q.sym3);
+		bool const1 = quad_arg(q.op_code, 1) == qa_sym && c1 != constant_of.end();
+		bool const2 = quad_arg(q.op_code, 2) == qa_sym && c2 != constant_of.end();
+		bool const3 = quad_reads(q.op_code, 3) && c3 != constant_of.end();
+		long value;
+
+		if ((q.op_code == q_iassign || q.op_code == q_rassign) && const1) {
+			q = quadruple(q.op_code == q_iassign ? q_iload : q_rload,
+					c1->second, NULL_SYM, q.sym3);
+			changed = true;
+		} else if (q.op_code == q_jmpf && const2) {
+			if (c2->second == 0) {
+				q = quadruple(q_jmp, q.int1, NULL_SYM, NULL_SYM);
+			} else {
+				q = quadruple(q_nop, NULL_SYM, NULL_SYM, NULL_SYM);
+			}
+			changed = true;
+			jumps_changed = true;
+		} else if (jump_relation(q.op_code) != q_nop && const2 && const3) {
+			fold_int(jump_relation(q.op_code), c2->second, c3->second, &value);
+			if (value == 0) {
+				q = quadruple(q_jmp, q.int1, NULL_SYM, NULL_SYM);
+			} else {
+				q = quadruple(q_nop, NULL_SYM, NULL_SYM, NULL_SYM);
+			}
+			changed = true;
+			jumps_changed = true;
+		} else if (const1 && (quad_arg(q.op_code, 2) != qa_sym || const2)
+				&& fold_int(q.op_code, c1->second, quad_arg(q.op_code, 2)
+						== qa_sym ? c2->second : q.int2, &value)) {
+			q = quadruple(q_iload, value, NULL_SYM, q.sym3);
+			changed = true;
+		}
+
+		if (changed) {
+			q_list->set(i, q);
+		}
+
+		// Forget what the quad changes.
+		sym_index d = defined_by(q);
+		if (d != NULL_SYM) {
+			copy_of.erase(d);
+			constant_of.erase(d);
+			map<sym_index, sym_index>::iterator c = copy_of.begin();
+			while (c != copy_of.end()) {
+				if (c->second == d) {
+					copy_of.erase(c++);
+				} else {
+					++c;
+				}
+			}
+		}
+		if (q.op_code == q_call) {
+			map<sym_index, sym_index>::iterator c = copy_of.begin();
+			while (c != copy_of.end()) {
+				if (!sym_tab->is_temp_var(c->second)) {
+					copy_of.erase(c++);
+				} else {
+					++c;
+				}
+			}
+			map<sym_index, long>::iterator k = constant_of.begin();
+			while (k != constant_of.end()) {
+				if (!sym_tab->is_temp_var(k->first)) {
+					constant_of.erase(k++);
+				} else {
+					++k;
+				}
+			}
+		}
+
+		// And remember what it tells.
+		if (d == NULL_SYM) {
+			continue;
+		}
+		if (q.op_code == q_iload || q.op_code == q_rload) {
+			constant_of[d] = q.int1;
+		} else if ((q.op_code == q_iassign || q.op_code == q_rassign)
+				&& sym_tab->is_temp_var(d) && q.sym1 != d && quad_variable(q.sym1)) {
+			copy_of[d] = q.sym1;
+		}
+	}
+
+	return jumps_changed;
+}
+
+/* The lattice of sparse conditional constant propagation. A name starts out
+ as unknown, meaning no assignment to it has been found to run yet, and can
+ then only go down: to a constant, and to varying if it turns out to have
+ more than one value. */
+enum lattice_state { UNKNOWN, CONSTANT, VARYING };
+
+/* The state of sparse conditional constant propagation, after Wegman and
+ Zadeck, "Constant Propagation with Conditional Branches". Names are only
+ evaluated when something they depend on changes, and only the blocks
+ found to run are looked at, so constants flow through variables, across
+ branches and around loops. */
+class conditional_constants {
+private:
+	ssa_form &ssa;
+	quad_list *quads;
+	control_flow_graph &cfg;
+
+	vector<lattice_state> state;
+	vector<long> value;
+
+	// The edges found to run, as (from, to) pairs, and the blocks.
+	set<pair<int, int> > edges;
+	vector<bool> block_runs;
+
+	vector<pair<int, int> > flow_work;
+	vector<int> name_work;
+
+	void lower(int name, lattice_state s, long v) {
+		if (s == CONSTANT && state[name] == CONSTANT && value[name] != v) {
+			s = VARYING;
+		}
+		if (s > state[name]) {
+			state[name] = s;
+			value[name] = v;
+			name_work.push_back(name);
+		}
+	}
+
+	void visit_phi(int p) {
+		phi_node &phi = ssa.phis[p];
+		basic_block &block = cfg.blocks[phi.block];
+
+		for (unsigned int j = 0; j < phi.args.size(); j++) {
+			// The entry block's extra argument is always there.
+			if (j < block.pred.size() && edges.find(make_pair(block.pred[j],
+					phi.block)) == edges.end()) {
+				continue;
+			}
+			int arg = phi.args[j];
+			if (state[arg] != UNKNOWN) {
+				lower(phi.name, state[arg], value[arg]);
+			}
+		}
+	}
+
+	// Returns what is known about whether a quad jumps: UNKNOWN until its
+	// arguments are, CONSTANT if it's known, and then whether in *jumps,
+	// and VARYING otherwise, also if the quad isn't a conditional jump.
+	lattice_state condition(int i, bool *jumps) {
+		quadruple q = quads->get(i);
+
+		if (q.op_code == q_jmpf) {
+			int cond = ssa.quad_use[3 * i + 1];
+			if (cond == -1) {
+				return VARYING;
+			}
+			*jumps = value[cond] == 0;
+			return state[cond];
+		}
+		if (!quad_conditional_jump(q.op_code)) {
+			return VARYING;
+		}
+
+		int left = ssa.quad_use[3 * i + 1];
+		int right = ssa.quad_use[3 * i + 2];
+		long holds;
+		if ((left != -1 && state[left] == UNKNOWN)
+				|| (right != -1 && state[right] == UNKNOWN)) {
+			return UNKNOWN;
+		}
+		if (left != -1 && right != -1 && state[left] == CONSTANT
+				&& state[right] == CONSTANT
+				&& jump_relation(q.op_code) != q_nop) {
+			fold_int(jump_relation(q.op_code), value[left], value[right],
+					&holds);
+			*jumps = holds == 0;
+			return CONSTANT;
+		}
+		return VARYING;
+	}
+
+	// Finds the successors of a block that can run.
+	void visit_edges(int b) {
+		basic_block &block = cfg.blocks[b];
+		quadruple q = quads->get(block.last);
+		bool jumps;
+		lattice_state known = condition(block.last, &jumps);
+
+		if (known == UNKNOWN) {
+			return;
+		}
+		for (unsigned int s = 0; s < block.succ.size(); s++) {
+			// On a known condition, only the target, or only the block
+			// after, can run.
+			int first = cfg.blocks[block.succ[s]].first;
+			bool target = quads->op_code(first) == q_labl
+					&& quads->get(first).int1 == q.int1;
+			if (known == VARYING || target == jumps
+					|| block.succ.size() == 1) {
+				flow_work.push_back(make_pair(b, block.succ[s]));
+			}
+		}
+	}
+
+	void visit_quad(int i) {
+		quadruple q = quads->get(i);
+		int def = ssa.quad_def[i];
+
+		if (q.op_code == q_call) {
+			vector<int> &clobbered = ssa.call_defs[i];
+			for (unsigned int c = 0; c < clobbered.size(); c++) {
+				lower(clobbered[c], VARYING, 0);
+			}
+		}
+		if (def == -1) {
+			return;
+		}
+
+		int arg1 = ssa.quad_use[3 * i];
+		int arg2 = ssa.quad_use[3 * i + 1];
+		long result;
+
+		switch (q.op_code) {
+		case q_iload:
+		case q_rload:
+			lower(def, CONSTANT, q.int1);
+			return;
+		case q_iassign:
+		case q_rassign:
+			if (arg1 == -1) {
+				// A named constant isn't a variable, see quad_variable().
+				break;
+			}
+			if (state[arg1] != UNKNOWN) {
+				lower(def, state[arg1], value[arg1]);
+			}
+			return;
+		default:
+			break;
+		}
+
+		// Integer operations on constants. Named constants are left to the
+		// local propagation.
+		bool binary = quad_arg(q.op_code, 2) == qa_sym;
+		if (arg1 == -1 || (binary && arg2 == -1)) {
+			lower(def, VARYING, 0);
+			return;
+		}
+		if (state[arg1] == UNKNOWN || (binary && state[arg2] == UNKNOWN)) {
+			return;
+		}
+		if (state[arg1] == CONSTANT && (!binary || state[arg2] == CONSTANT)
+				&& fold_int(q.op_code, value[arg1],
+						binary ? value[arg2] : q.int2, &result)) {
+			lower(def, CONSTANT, result);
+		} else {
+			lower(def, VARYING, 0);
+		}
+	}
+
+public:
+	conditional_constants(ssa_form &ssa, quad_list *q_list,
+			control_flow_graph &cfg) :
+		ssa(ssa), quads(q_list), cfg(cfg) {
+	}
+
+	void solve() {
+		state.assign(ssa.names.size(), UNKNOWN);
+		value.assign(ssa.names.size(), 0);
+		block_runs.assign(cfg.blocks.size(), false);
+
+		// Nothing is known about the values variables have on entry.
+		for (unsigned int n = 0; n < ssa.names.size(); n++) {
+			if (ssa.names[n].quad == -1 && ssa.names[n].phi == -1) {
+				lower(n, VARYING, 0);
+			}
+		}
+
+		if (!cfg.rpo_order.empty()) {
+			flow_work.push_back(make_pair(-1, 0));
+		}
+
+		while (!flow_work.empty() || !name_work.empty()) {
+			while (!flow_work.empty()) {
+				pair<int, int> edge = flow_work.back();
+				flow_work.pop_back();
+				if (edges.find(edge) != edges.end()) {
+					continue;
+				}
+				edges.insert(edge);
+
+				int b = edge.second;
+				for (unsigned int p = 0; p < ssa.block_phis[b].size(); p++) {
+					visit_phi(ssa.block_phis[b][p]);
+				}
+				if (!block_runs[b]) {
+					block_runs[b] = true;
+					for (int i = cfg.blocks[b].first; i <= cfg.blocks[b].last;
+							i++) {
+						visit_quad(i);
+					}
+					visit_edges(b);
+				}
+			}
+
+			while (!name_work.empty()) {
+				int n = name_work.back();
+				name_work.pop_back();
+
+				ssa_name &name = ssa.names[n];
+				for (unsigned int u = 0; u < name.phi_uses.size(); u++) {
+					visit_phi(name.phi_uses[u]);
+				}
+				for (unsigned int u = 0; u < name.quad_uses.size(); u++) {
+					int i = name.quad_uses[u];
+					int b = ssa.block_of[i];
+					if (block_runs[b]) {
+						visit_quad(i);
+						if (i == cfg.blocks[b].last) {
+							visit_edges(b);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	// Replaces the quads found to compute a constant by loads of it, and
+	// jumps on a known condition. Returns true if any jump was changed.
+	bool rewrite() {
+		bool jumps_changed = false;
+
+		for (int i = 0; i < quads->size(); i++) {
+			if (ssa.block_of[i] == -1 || !block_runs[ssa.block_of[i]]) {
+				continue;
+			}
+			quadruple q = quads->get(i);
+			int def = ssa.quad_def[i];
+
+			if (def != -1 && state[def] == CONSTANT && q.op_code != q_call
+					&& q.op_code != q_iload && q.op_code != q_rload) {
+				bool real = real_result(q.op_code) || q.op_code == q_rassign;
+				quads->set(i, quadruple(real ? q_rload : q_iload, value[def],
+						NULL_SYM, q.sym3));
+			} else if (quad_conditional_jump(q.op_code)) {
+				bool jumps;
+				if (condition(i, &jumps) == CONSTANT) {
+					if (jumps) {
+						quads->set(i, quadruple(q_jmp, q.int1, NULL_SYM,
+								NULL_SYM));
+					} else {
+						quads->set(i, quadruple(q_nop, NULL_SYM, NULL_SYM,
+								NULL_SYM));
+					}
+					jumps_changed = true;
+				}
+			}
+		}
+
+		return jumps_changed;
+	}
+};
+
+/* Sparse conditional constant propagation over SSA form. Returns true if a
+ jump was changed. */
+bool quad_optimizer::propagate_conditional_constants(quad_list *q_list,
+		control_flow_graph &cfg) {
+	ssa_form ssa(q_list, &cfg);
+	conditional_constants constants(ssa, q_list, cfg);
+
+	constants.solve();
+	return constants.rewrite();
+}
+
+/* Makes a quad computing a temp var which is only read by an assignment
+ right after it compute the assigned variable instead, and removes the
+ assignment. This takes care of the temp vars quad generation puts between
+ an expression and the variable it is assigned to. */
+void quad_optimizer::coalesce(quad_list *q_list, control_flow_graph &cfg) {
+	map<sym_index, int> reads;
+	vector<sym_index> uses;
+
+	for (int i = 0; i < q_list->size(); i++) {
+		uses.clear();
+		used_by(q_list->get(i), uses);
+		for (unsigned int u = 0; u < uses.size(); u++) {
+			reads[uses[u]]++;
+		}
+	}
+
+	for (unsigned int b = 0; b < cfg.blocks.size(); b++) {
+		basic_block &block = cfg.blocks[b];
+		int prev = -1;
+
+		for (int i = block.first; i <= block.last; i++) {
+			quadruple q = q_list->get(i);
+			if (q.op_code == q_nop) {
+				continue;
+			}
+			if ((q.op_code == q_iassign || q.op_code == q_rassign)
+					&& prev != -1 && sym_tab->is_temp_var(q.sym1)
+					&& reads[q.sym1] == 1) {
+				quadruple p = q_list->get(prev);
+				if (defined_by(p) == q.sym1) {
+					p.sym3 = q.sym3;
+					q_list->set(prev, p);
+					q_list->set(i, quadruple(q_nop, NULL_SYM, NULL_SYM,
+							NULL_SYM));
+					reads[q.sym1] = 0;
+					continue;
+				}
+			}
+			prev = i;
+		}
+	}
+}
+
+/* Turns the quads of the blocks that can't be reached into q_nops, except
+ the label ending the quad list, and then the jumps to the block right after
+ the jump. */
+void quad_optimizer::remove_unreachable(quad_list *q_list,
+		control_flow_graph &cfg) {
+	int last_reachable = -1;
+
+	for (unsigned int b = 0; b < cfg.blocks.size(); b++) {
+		basic_block &block = cfg.blocks[b];
+
+		if (block.rpo == -1) {
+			for (int i = block.first; i <= block.last; i++) {
+				if (i < q_list->size() - 1) {
+					q_list->set(i, quadruple(q_nop, NULL_SYM, NULL_SYM,
+							NULL_SYM));
+				}
+			}
+			continue;
+		}
+
+		// Anything between this block and the last reachable one is gone
+		// now, so a jump from there to here can go too.
+		if (last_reachable != -1) {
+			basic_block &prev = cfg.blocks[last_reachable];
+			if (q_list->op_code(prev.last) == q_jmp
+					&& prev.succ.size() == 1 && prev.succ[0] == (int) b) {
+				q_list->set(prev.last, quadruple(q_nop, NULL_SYM, NULL_SYM,
+						NULL_SYM));
+			}
+		}
+		last_reachable = b;
+	}
+}
+
+/* Computes which variables are live at the end of each block, and then
+ walks every block backwards removing the quads assigning variables that
+ aren't live. Variables that aren't temp vars are live at every call, since
+ they may be seen by the procedure called, and the ones that aren't local to
+ the procedure either are live at the end of the quad list. Returns true if
+ any quad was removed. */
+bool quad_optimizer::remove_dead_code(quad_list *q_list,
+		control_flow_graph &cfg) {
+	// Number the variables used in the quad list. The ones that aren't
+	// temp vars can be seen by the procedures called, and those that
+	// aren't local either also after returning.
+	block_level local_level =
+			sym_tab->get_symbol(sym_tab->current_environment())->level + 1;
+	map<sym_index, int> number;
+	vector<bool> visible;
+	vector<bool> global;
+	vector<sym_index> uses;
+
+	for (int i = 0; i < q_list->size(); i++) {
+		quadruple q = q_list->get(i);
+		uses.clear();
+		used_by(q, uses);
+		if (defined_by(q) != NULL_SYM) {
+			uses.push_back(q.sym3);
+		}
+		for (unsigned int u = 0; u < uses.size(); u++) {
+			if (number.find(uses[u]) == number.end()) {
+				number[uses[u]] = visible.size();
+				visible.push_back(!sym_tab->is_temp_var(uses[u]));
+				global.push_back(sym_tab->get_symbol(uses[u])->level
+						!= local_level);
+			}
+		}
+	}
+
+	// The variables read before being assigned in each block, and the ones
+	// assigned.
+	int n = visible.size();
+	int blocks = cfg.blocks.size();
+	vector<vector<bool> > use(blocks, vector<bool>(n, false));
+	vector<vector<bool> > def(blocks, vector<bool>(n, false));
+
+	for (int b = 0; b < blocks; b++) {
+		for (int i = cfg.blocks[b].first; i <= cfg.blocks[b].last; i++) {
+			quadruple q = q_list->get(i);
+			uses.clear();
+			used_by(q, uses);
+			for (unsigned int u = 0; u < uses.size(); u++) {
+				int v = number[uses[u]];
+				if (!def[b][v]) {
+					use[b][v] = true;
+				}
+			}
+			if (q.op_code == q_call) {
+				for (int v = 0; v < n; v++) {
+					if (visible[v] && !def[b][v]) {
+						use[b][v] = true;
+					}
+				}
+			}
+			sym_index d = defined_by(q);
+			if (d != NULL_SYM) {
+				def[b][number[d]] = true;
+			}
+		}
+	}
+
+	// Solve for the variables live at the start and end of each block,
+	// visiting them in postorder so most successors are done first.
+	vector<vector<bool> > live_in(blocks, vector<bool>(n, false));
+	vector<vector<bool> > live_out(blocks, vector<bool>(n, false));
+	bool changed = true;
+
+	while (changed) {
+		changed = false;
+		for (int r = cfg.rpo_order.size() - 1; r >= 0; r--) {
+			int b = cfg.rpo_order[r];
+			basic_block &block = cfg.blocks[b];
+			vector<bool> out(n, false);
+
+			if (block.succ.empty()) {
+				out = global;
+			}
+			for (unsigned int s = 0; s < block.succ.size(); s++) {
+				for (int v = 0; v < n; v++) {
+					if (live_in[block.succ[s]][v]) {
+						out[v] = true;
+					}
+				}
+			}
+			for (int v = 0; v < n; v++) {
+				bool in = use[b][v] || (out[v] && !def[b][v]);
+				if (in != live_in[b][v]) {
+					live_in[b][v] = in;
+					changed = true;
+				}
+			}
+			live_out[b] = out;
+		}
+	}
+
+	// Remove the quads whose results aren't used.
+	bool removed = false;
+
+	for (unsigned int r = 0; r < cfg.rpo_order.size(); r++) {
+		basic_block &block = cfg.blocks[cfg.rpo_order[r]];
+		vector<bool> live = live_out[cfg.rpo_order[r]];
+
+		for (int i = block.last; i >= block.first; i--) {
+			quadruple q = q_list->get(i);
+			sym_index d = defined_by(q);
+
+			if (d != NULL_SYM && removable(q.op_code)
+					&& (!live[number[d]] || ((q.op_code == q_iassign
+							|| q.op_code == q_rassign) && q.sym1 == d))) {
+				q_list->set(i, quadruple(q_nop, NULL_SYM, NULL_SYM,
+						NULL_SYM));
+				removed = true;
+				continue;
+			}
+
+			if (d != NULL_SYM) {
+				live[number[d]] = false;
+			}
+			if (q.op_code == q_call) {
+				for (int v = 0; v < n; v++) {
+					if (visible[v]) {
+						live[v] = true;
+					}
+				}
+			}
+			uses.clear();
+			used_by(q, uses);
+			for (unsigned int u = 0; u < uses.size(); u++) {
+				live[number[uses[u]]] = true;
+			}
+		}
+	}
+
+	return removed;
+}
+
+/* Returns true if a quad can be run more often than before without changing
+ what the program does, provided its arguments have the same values. That
+ is, it has no side effects and can't trap. Array loads and divisions
+ qualify only at the start of a loop, see hoist_invariants(). */
+static bool speculable(quad_op_type op) {
+	switch (op) {
+	case q_rload:
+	case q_iload:
+	case q_inot:
+	case q_ruminus:
+	case q_iuminus:
+	case q_rplus:
+	case q_iplus:
+	case q_rminus:
+	case q_iminus:
+	case q_ior:
+	case q_iand:
+	case q_rmult:
+	case q_imult:
+	case q_rdivide:
+	case q_ishl:
+	case q_ishr:
+	case q_imask:
+	case q_idivc:
+	case q_imodc:
+	case q_req:
+	case q_ieq:
+	case q_rne:
+	case q_ine:
+	case q_rlt:
+	case q_ilt:
+	case q_rgt:
+	case q_igt:
+	case q_rassign:
+	case q_iassign:
+	case q_lindex:
+	case q_itor:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* Returns true if the quads of a loop can be preceded by a preheader, which
+ is run exactly once each time the loop is entered. This is so if only the
+ back edges and a fall through from the block before enter the loop. The
+ preheader is then inserted right before the label starting the loop. */
+static bool has_preheader(quad_list *q_list, control_flow_graph &cfg,
+		loop_info &loop) {
+	vector<bool> in_loop(cfg.blocks.size(), false);
+	for (unsigned int b = 0; b < loop.blocks.size(); b++) {
+		in_loop[loop.blocks[b]] = true;
+	}
+
+	basic_block &head = cfg.blocks[loop.header];
+	for (unsigned int p = 0; p < head.pred.size(); p++) {
+		int pred = head.pred[p];
+		if (in_loop[pred] || cfg.blocks[pred].rpo == -1) {
+			continue;
+		}
+		quad_op_type op = q_list->op_code(cfg.blocks[pred].last);
+		if (pred != loop.header - 1 || op == q_jmp || op == q_ireturn
+				|| op == q_rreturn) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Lists the indexes of the quads in a loop, in order. */
+static void loop_body(control_flow_graph &cfg, loop_info &loop,
+		vector<int> &body) {
+	for (unsigned int b = 0; b < loop.blocks.size(); b++) {
+		basic_block &block = cfg.blocks[loop.blocks[b]];
+		for (int i = block.first; i <= block.last; i++) {
+			body.push_back(i);
+		}
+	}
+	sort(body.begin(), body.end());
+}
+
+/* Moves the quads of a loop which compute the same value in every iteration
+ to a preheader, right before the label starting the loop. Only quads
+ computing temp vars assigned nowhere else are moved. Array loads are only
+ moved if nothing in the loop may store into the array, which any call may,
+ and they and divisions by a variable must also be in the header block,
+ which runs whenever the loop is entered. Returns true if anything was
+ moved, which changes the indexes of the quads. */
+bool quad_optimizer::hoist_invariants(quad_list *q_list,
+		control_flow_graph &cfg, loop_info &loop) {
+	int header = loop.header;
+
+	if (!has_preheader(q_list, cfg, loop)) {
+		return false;
+	}
+
+	// What the loop and the whole list assign, and the arrays stored into
+	// in the loop.
+	map<sym_index, int> loop_defs;
+	map<sym_index, int> list_defs;
+	map<sym_index, sym_index> address_of;
+	set<sym_index> stored;
+	bool stores_anywhere = false;
+	bool calls = false;
+	vector<int> body;
+
+	for (int i = 0; i < q_list->size(); i++) {
+		quadruple q = q_list->get(i);
+		sym_index d = defined_by(q);
+		if (d != NULL_SYM) {
+			list_defs[d]++;
+		}
+		if (q.op_code == q_lindex) {
+			address_of[q.sym3] = q.sym1;
+		}
+	}
+	loop_body(cfg, loop, body);
+	for (unsigned int k = 0; k < body.size(); k++) {
+		quadruple q = q_list->get(body[k]);
+		sym_index d = defined_by(q);
+		if (d != NULL_SYM) {
+			loop_defs[d]++;
+		}
+		if (q.op_code == q_call) {
+			calls = true;
+		} else if (q.op_code == q_istore || q.op_code == q_rstore) {
+			// An address computed once, by a q_lindex, has a known array.
+			map<sym_index, sym_index>::iterator a = address_of.find(q.sym3);
+			if (a != address_of.end() && list_defs[q.sym3] == 1) {
+				stored.insert(a->second);
+			} else {
+				stores_anywhere = true;
+			}
+		}
+	}
+
+	// Mark the invariant quads, in an order where each comes after the
+	// ones computing its arguments.
+	set<sym_index> invariant;
+	vector<int> moved;
+	bool changed = true;
+
+	while (changed) {
+		changed = false;
+		for (unsigned int k = 0; k < body.size(); k++) {
+			int i = body[k];
+			quadruple q = q_list->get(i);
+			sym_index d = defined_by(q);
+
+			if (d == NULL_SYM || invariant.find(d) != invariant.end()
+					|| !sym_tab->is_temp_var(d) || list_defs[d] != 1) {
+				continue;
+			}
+
+			bool at_start = cfg.blocks[header].first <= i
+					&& i <= cfg.blocks[header].last;
+			if (q.op_code == q_irindex || q.op_code == q_rrindex) {
+				if (!at_start || calls || stores_anywhere
+						|| stored.find(q.sym1) != stored.end()) {
+					continue;
+				}
+			} else if (q.op_code == q_idivide || q.op_code == q_imod) {
+				if (!at_start) {
+					continue;
+				}
+			} else if (!speculable(q.op_code)) {
+				continue;
+			}
+
+			bool args_invariant = true;
+			sym_index args[3] = { q.sym1, q.sym2, q.sym3 };
+			for (int a = 0; a < 3; a++) {
+				if (!quad_reads(q.op_code, a + 1)
+						|| !quad_variable(args[a])
+						|| invariant.find(args[a]) != invariant.end()) {
+					continue;
+				}
+				if (loop_defs[args[a]] != 0
+						|| (calls && !sym_tab->is_temp_var(args[a]))) {
+					args_invariant = false;
+				}
+			}
+			if (args_invariant) {
+				invariant.insert(d);
+				moved.push_back(i);
+				changed = true;
+			}
+		}
+	}
+
+	if (moved.empty()) {
+		return false;
+	}
+
+	// The quads are all taken out before any is inserted, since inserting
+	// one moves the ones after it.
+	vector<quadruple> hoisted;
+	for (unsigned int m = 0; m < moved.size(); m++) {
+		hoisted.push_back(q_list->get(moved[m]));
+		q_list->set(moved[m], quadruple(q_nop, NULL_SYM, NULL_SYM, NULL_SYM));
+	}
+	for (unsigned int m = 0; m < hoisted.size(); m++) {
+		q_list->insert(cfg.blocks[header].first + m, hoisted[m]);
+	}
+	q_list->remove_nops();
+	return true;
+}
+
+/* Returns true if a quad argument has the same value throughout a loop,
+ given what the loop assigns and whether it makes calls, which may change
+ any variable but temp vars. */
+static bool loop_invariant(sym_index sym_p, map<sym_index, int> &loop_defs,
+		bool calls) {
+	return !quad_variable(sym_p) || (loop_defs[sym_p] == 0
+			&& (!calls || sym_tab->is_temp_var(sym_p)));
+}
+
+/* Gives the operands of an integer relation, or of a quad comparing
+ integers and jumping. Returns false for other quads. */
+static bool integer_comparison(quadruple &q, sym_index **left,
+		sym_index **right) {
+	switch (q.op_code) {
+	case q_ilt:
+	case q_igt:
+	case q_ieq:
+	case q_ine:
+		*left = &q.sym1;
+		*right = &q.sym2;
+		return true;
+	default:
+		if (jump_relation(q.op_code) == q_nop) {
+			return false;
+		}
+		*left = &q.sym2;
+		*right = &q.sym3;
+		return true;
+	}
+}
+
+/* Returns the comparison which holds for b and a if the one given holds for
+ a and b. */
+static quad_op_type mirrored(quad_op_type op) {
+	switch (op) {
+	case q_ilt:
+		return q_igt;
+	case q_igt:
+		return q_ilt;
+	case q_ijnlt:
+		return q_ijngt;
+	case q_ijngt:
+		return q_ijnlt;
+	default:
+		return op;
+	}
+}
+
+/* Induction variable strength reduction. A basic induction variable of a
+ loop is one the loop only changes by adding or subtracting values which
+ are invariant in it. For each array indexed by one, an address is stepped through the
+ array along with it, starting from the element indexed on entry. The
+ array accesses then use the address right away instead of computing it.
+
+ If nothing but the loop reads the induction variable afterwards, it is
+ removed altogether. Relations comparing it with a constant within the
+ array are then made on addresses instead. Addresses go down as the index
+ goes up, see codegen.cc, so < and > change places. Returns true if the
+ loop was changed. */
+bool quad_optimizer::reduce_induction_variables(quad_list *q_list,
+		control_flow_graph &cfg, loop_info &loop) {
+	if (!has_preheader(q_list, cfg, loop)) {
+		return false;
+	}
+
+	block_level local_level =
+			sym_tab->get_symbol(sym_tab->current_environment())->level + 1;
+	vector<int> body;
+	loop_body(cfg, loop, body);
+	vector<bool> in_body(q_list->size(), false);
+	for (unsigned int k = 0; k < body.size(); k++) {
+		in_body[body[k]] = true;
+	}
+
+	// What the whole list and the loop assign, the temp vars loaded with
+	// constants, and whether the loop, or the list, calls a procedure that
+	// can see the local variables, ie one declared in this block.
+	map<sym_index, int> list_defs;
+	map<sym_index, int> loop_defs;
+	map<sym_index, long> loaded;
+	bool calls = false;
+	bool nested_calls = false;
+
+	for (int i = 0; i < q_list->size(); i++) {
+		quadruple q = q_list->get(i);
+		sym_index d = defined_by(q);
+		if (d != NULL_SYM) {
+			list_defs[d]++;
+			if (in_body[i]) {
+				loop_defs[d]++;
+			}
+		}
+		if (q.op_code == q_iload) {
+			loaded[q.sym3] = q.int1;
+		}
+		if (q.op_code == q_call) {
+			if (sym_tab->get_symbol(q.sym1)->level == local_level) {
+				nested_calls = true;
+			}
+			if (in_body[i]) {
+				calls = true;
+			}
+		}
+	}
+
+	// Find the basic induction variables.
+	map<sym_index, bool> induction;
+	for (unsigned int k = 0; k < body.size(); k++) {
+		quadruple q = q_list->get(body[k]);
+		sym_index d = defined_by(q);
+		if (d == NULL_SYM) {
+			continue;
+		}
+		if ((q.op_code == q_iplus || q.op_code == q_iminus) && q.sym1 == d
+				&& q.sym2 != d && loop_invariant(q.sym2, loop_defs, calls)
+				&& (!calls || sym_tab->is_temp_var(d))) {
+			induction.insert(make_pair(d, true));
+		} else {
+			induction[d] = false;
+		}
+	}
+
+	// An address is stepped for each array indexed by each of them.
+	map<pair<sym_index, sym_index>, sym_index> address;
+	for (unsigned int k = 0; k < body.size(); k++) {
+		quadruple q = q_list->get(body[k]);
+		if ((q.op_code == q_lindex || q.op_code == q_irindex
+				|| q.op_code == q_rrindex) && induction[q.sym2]) {
+			pair<sym_index, sym_index> key(q.sym1, q.sym2);
+			if (address.find(key) == address.end()) {
+				address[key] = sym_tab->gen_temp_var(integer_type);
+			}
+		}
+	}
+	if (address.empty()) {
+		return false;
+	}
+
+	// Which induction variables nothing else reads, and can be removed.
+	// A relation is only rewritten if the value compared with is a
+	// constant index of the array, or at most one past its end.
+	map<sym_index, sym_index> removed;
+	for (map<pair<sym_index, sym_index>, sym_index>::iterator a =
+			address.begin(); a != address.end(); a++) {
+		sym_index var = a->first.second;
+		symbol *sym = sym_tab->get_symbol(var);
+		if (sym_tab->is_temp_var(var) || (sym->level == local_level
+				&& !nested_calls)) {
+			removed[var] = a->first.first;
+		}
+	}
+	for (int i = 0; i < q_list->size() && !removed.empty(); i++) {
+		quadruple q = q_list->get(i);
+		vector<sym_index> uses;
+		used_by(q, uses);
+
+		for (unsigned int u = 0; u < uses.size(); u++) {
+			sym_index var = uses[u];
+			if (removed.find(var) == removed.end()) {
+				continue;
+			}
+			// The steps and array accesses are rewritten.
+			bool steps = (q.op_code == q_iplus || q.op_code == q_iminus)
+					&& q.sym3 == var;
+			bool indexes = (q.op_code == q_lindex || q.op_code == q_irindex
+					|| q.op_code == q_rrindex) && q.sym2 == var;
+			if (in_body[i] && (steps || indexes)) {
+				continue;
+			}
+			sym_index *left;
+			sym_index *right;
+			if (in_body[i] && integer_comparison(q, &left, &right)
+					&& (*left == var) != (*right == var)) {
+				// The address of the bound must be inside the array too,
+				// or it may wrap around and compare the wrong way.
+				sym_index other = *left == var ? *right : *left;
+				map<sym_index, long>::iterator c = loaded.find(other);
+				long size = sym_tab->get_symbol(removed[var])
+						->get_array_symbol()->array_cardinality;
+				if (loop_invariant(other, loop_defs, calls)
+						&& c != loaded.end() && list_defs[other] == 1
+						&& c->second >= 0 && c->second <= size) {
+					continue;
+				}
+			}
+			removed.erase(var);
+		}
+	}
+
+	// The preheader starts each address at the element indexed on entry,
+	// and loads the amounts they are stepped by.
+	vector<quadruple> preheader;
+	map<pair<sym_index, quad_op_type>, sym_index> steps;
+	map<pair<sym_index, sym_index>, sym_index> bounds;
+
+	for (map<pair<sym_index, sym_index>, sym_index>::iterator a =
+			address.begin(); a != address.end(); a++) {
+		preheader.push_back(quadruple(q_lindex, a->first.first,
+				a->first.second, a->second));
+	}
+
+	// Rewrite the loop. The quads to insert after each one are collected
+	// first, and inserted from the end so the indexes stay valid.
+	vector<pair<int, quadruple> > inserts;
+
+	for (unsigned int k = 0; k < body.size(); k++) {
+		int i = body[k];
+		quadruple q = q_list->get(i);
+		sym_index d = defined_by(q);
+
+		if (d != NULL_SYM && induction[d]) {
+			// The addresses are stepped by -STACK_WIDTH times what is added
+			// to the index. That is computed in the preheader, at compile
+			// time if it's a constant.
+			pair<sym_index, quad_op_type> key(q.sym2, q.op_code);
+			if (steps.find(key) == steps.end()) {
+				sym_index bytes = sym_tab->gen_temp_var(integer_type);
+				long width = q.op_code == q_iplus ? -STACK_WIDTH : STACK_WIDTH;
+				map<sym_index, long>::iterator c = loaded.find(q.sym2);
+				if (c != loaded.end() && list_defs[q.sym2] == 1
+						&& sym_tab->is_temp_var(q.sym2)) {
+					unsigned long step = c->second;
+					preheader.push_back(quadruple(q_iload,
+							(long) (step * width), NULL_SYM, bytes));
+				} else {
+					sym_index factor = sym_tab->gen_temp_var(integer_type);
+					preheader.push_back(quadruple(q_iload, width, NULL_SYM,
+							factor));
+					preheader.push_back(quadruple(q_imult, q.sym2, factor,
+							bytes));
+				}
+				steps[key] = bytes;
+			}
+			for (map<pair<sym_index, sym_index>, sym_index>::iterator a =
+					address.begin(); a != address.end(); a++) {
+				if (a->first.second == d) {
+					inserts.push_back(make_pair(i + 1, quadruple(q_iplus,
+							a->second, steps[key], a->second)));
+				}
+			}
+			if (removed.find(d) != removed.end()) {
+				q_list->set(i, quadruple(q_nop, NULL_SYM, NULL_SYM,
+						NULL_SYM));
+			}
+			continue;
+		}
+
+		sym_index *left;
+		sym_index *right;
+		if (integer_comparison(q, &left, &right)) {
+			bool first = removed.find(*left) != removed.end();
+			sym_index var = first ? *left : *right;
+			if (removed.find(var) == removed.end()) {
+				continue;
+			}
+			sym_index array = removed[var];
+			sym_index other = first ? *right : *left;
+			pair<sym_index, sym_index> key(array, other);
+			if (bounds.find(key) == bounds.end()) {
+				bounds[key] = sym_tab->gen_temp_var(integer_type);
+				preheader.push_back(quadruple(q_lindex, array, other,
+						bounds[key]));
+			}
+			*(first ? left : right) = address[make_pair(array, var)];
+			*(first ? right : left) = bounds[key];
+			q.op_code = mirrored(q.op_code);
+			q_list->set(i, q);
+			continue;
+		}
+
+		switch (q.op_code) {
+		case q_lindex:
+		case q_irindex:
+		case q_rrindex: {
+			map<pair<sym_index, sym_index>, sym_index>::iterator a =
+					address.find(make_pair(q.sym1, q.sym2));
+			if (a == address.end()) {
+				break;
+			}
+			quad_op_type op = q.op_code == q_lindex ? q_iassign
+					: q.op_code == q_irindex ? q_ideref : q_rderef;
+			q_list->set(i, quadruple(op, a->second, NULL_SYM, q.sym3));
+			break;
+		}
+
+		default:
+			break;
+		}
+	}
+
+	for (int n = inserts.size() - 1; n >= 0; n--) {
+		q_list->insert(inserts[n].first, inserts[n].second);
+	}
+	for (unsigned int m = 0; m < preheader.size(); m++) {
+		q_list->insert(cfg.blocks[loop.header].first + m, preheader[m]);
+	}
+	q_list->remove_nops();
+	return true;
+}
+
+/* Applies a transformation to each loop, innermost first, so what it moves
+ out of an inner loop may be moved further out of the loops around it. The
+ graph is built again after each loop the transformation changed. */
+void quad_optimizer::transform_loops(quad_list *q_list,
+		bool (quad_optimizer::*transform)(quad_list *, control_flow_graph &,
+				loop_info &)) {
+	set<long> done;
+	bool changed = true;
+
+	while (changed) {
+		changed = false;
+		control_flow_graph cfg(q_list);
+
+		vector<pair<int, int> > order;
+		for (unsigned int l = 0; l < cfg.loops.size(); l++) {
+			order.push_back(make_pair(-cfg.loops[l].depth, l));
+		}
+		sort(order.begin(), order.end());
+
+		for (unsigned int o = 0; o < order.size() && !changed; o++) {
+			loop_info &loop = cfg.loops[order[o].second];
+			quadruple start = q_list->get(cfg.blocks[loop.header].first);
+
+			// Loops are told apart by the label they start with, since
+			// their numbers change when the graph is built again.
+			if (start.op_code != q_labl
+					|| done.find(start.int1) != done.end()) {
+				continue;
+			}
+			done.insert(start.int1);
+			changed = (this->*transform)(q_list, cfg, loop);
+		}
+	}
+}
+
+/* Frees the activation record slots of the temp vars no longer used. */
+void quad_optimizer::shrink_frame(quad_list *q_list) {
+	vector<bool> used;
+
+	for (int i = 0; i < q_list->size(); i++) {
+		quadruple q = q_list->get(i);
+		sym_index args[3] = { q.sym1, q.sym2, q.sym3 };
+
+		for (int a = 0; a < 3; a++) {
+			if (quad_arg(q.op_code, a + 1) == qa_sym && args[a] != NULL_SYM) {
+				if (args[a] >= (sym_index) used.size()) {
+					used.resize(args[a] + 1, false);
+				}
+				used[args[a]] = true;
+			}
+		}
+	}
+
+	sym_tab->remove_temp_vars(used);
+}
+
+/* The interface method, called for every quad list from optimization
+ level 2. */
+void quad_optimizer::do_optimize(quad_list *q_list) {
+	control_flow_graph cfg(q_list);
+
+	bool jumps_changed = false;
+
+	for (unsigned int b = 0; b < cfg.blocks.size(); b++) {
+		number_values(q_list, cfg.blocks[b]);
+		jumps_changed |= propagate(q_list, cfg.blocks[b]);
+	}
+	coalesce(q_list, cfg);
+
+	// Folded jumps change the edges, and maybe what can be reached.
+	if (jumps_changed) {
+		cfg = control_flow_graph(q_list);
+	}
+
+	if (optimize_level >= 3
+			&& propagate_conditional_constants(q_list, cfg)) {
+		cfg = control_flow_graph(q_list);
+	}
+
+	remove_unreachable(q_list, cfg);
+	while (remove_dead_code(q_list, cfg)) {
+	}
+
+	q_list->remove_nops();
+	transform_loops(q_list, &quad_optimizer::hoist_invariants);
+	transform_loops(q_list, &quad_optimizer::reduce_induction_variables);
+
+	// The array accesses rewritten copy the addresses, and what removed
+	// induction variables were computed from may be dead now.
+	cfg = control_flow_graph(q_list);
+	for (unsigned int b = 0; b < cfg.blocks.size(); b++) {
+		propagate(q_list, cfg.blocks[b]);
+	}
+	while (remove_dead_code(q_list, cfg)) {
+	}
+	q_list->remove_nops();
+	shrink_frame(q_list);
+}
@@ -0,0 +1,65 @@
+#ifndef __QUADOPT_HH__
+#define __QUADOPT_HH__
+
+#include "quads.hh"
+#include "cfg.hh"
+
+/*** This class performs optimization on the quad list of a procedure, after
+ it has been generated and before the assembler code is. It is run from
+ optimization level 2, see do_quads() in quads.cc. The passes only ever
+ replace quads in place, removed ones by q_nops, so the control flow graph
+ stays valid between them. The q_nops are taken out at the end, before loop
+ invariant code motion, the one pass moving quads. ***/
+
+class quad_optimizer;
+
+// Defined in quadopt.cc.
+extern quad_optimizer *quad_opt;
+
+class quad_optimizer {
+private:
+	// Local value numbering. Finds quads in a basic block computing a value
+	// which is already held by some variable, and turns them into plain
+	// assignments. This removes common subexpressions, including repeated
+	// array loads, and loads of array elements that were just stored.
+	void number_values(quad_list *, basic_block &);
+
+	// Copy and constant propagation. propagate() makes quads in a basic
+	// block read the original of a copy, and folds quads on constants.
+	// coalesce() then makes quads compute the variables their result is
+	// assigned to right away.
+	bool propagate(quad_list *, basic_block &);
+	void coalesce(quad_list *, control_flow_graph &);
+
+	// Sparse conditional constant propagation, from optimization level 3.
+	// Builds SSA form to find the assignments and branches which give a
+	// constant whatever path is taken to them, and turns them into loads of
+	// the constant and unconditional jumps. See ssa.hh.
+	bool propagate_conditional_constants(quad_list *, control_flow_graph &);
+
+	// Dead code elimination. Removes the blocks that can't be reached and
+	// jumps to the next block, and then, using liveness, the quads whose
+	// results are never used. shrink_frame() then gives back the space of
+	// the temp vars that are gone from the activation record.
+	void remove_unreachable(quad_list *, control_flow_graph &);
+	bool remove_dead_code(quad_list *, control_flow_graph &);
+	void shrink_frame(quad_list *);
+
+	// Loop optimizations, run on one loop at a time by transform_loops().
+	// Unlike the passes above, these move quads around, so it builds the
+	// graph again after each loop that was changed. hoist_invariants() is
+	// loop invariant code motion. reduce_induction_variables() steps
+	// addresses through the arrays indexed by induction variables instead
+	// of computing them from the index each time.
+	bool hoist_invariants(quad_list *, control_flow_graph &, loop_info &);
+	bool reduce_induction_variables(quad_list *, control_flow_graph &,
+			loop_info &);
+	void transform_loops(quad_list *, bool (quad_optimizer::*)(quad_list *,
+			control_flow_graph &, loop_info &));
+
+public:
+	// Optimizes a quad list.
+	void do_optimize(quad_list *);
+};
+
+#endif
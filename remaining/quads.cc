@@ -1,9 +1,16 @@
 #include <iostream>
+#include <climits>
 #include <iomanip>
 #include <stdio.h>
 #include "symtab.hh"
 #include "ast.hh"
 #include "quads.hh"
+#include "quadopt.hh"
+#include "optimize.hh"
+
+// Defined in main.cc.
+extern bool optimize;
+extern int optimize_level;
 using namespace std;
 
 /* This little #define is only here to suppress compiler warnings for methods
@@ -17,58 +24,230 @@ quadruple::quadruple(quad_op_type op, long a1, long a2, long a3) :
 		op_code(op), sym1(a1), sym2(a2), sym3(a3), int1(a1), int2(a2), int3(a3) {
 }
 
-/* The quad_list_element constructor. Not very exciting really. This class
- is never used outside the quad_list class. */
-quad_list_element::quad_list_element(quadruple *q, quad_list_element *n) :
-		data(q), next(n) {
+/* Returns the type of argument 1, 2 or 3 of a quad, following the table in
+ quads.hh. */
+quad_arg_type quad_arg(quad_op_type op, int n) {
+	switch (op) {
+	case q_rload:
+	case q_iload:
+		return n == 1 ? qa_int : n == 3 ? qa_sym : qa_none;
+	case q_inot:
+	case q_ruminus:
+	case q_iuminus:
+	case q_rstore:
+	case q_istore:
+	case q_rassign:
+	case q_iassign:
+	case q_rderef:
+	case q_ideref:
+	case q_itor:
+		return n == 2 ? qa_none : qa_sym;
+	case q_ishl:
+	case q_ishr:
+	case q_imask:
+	case q_idivc:
+	case q_imodc:
+	case q_call:
+		return n == 2 ? qa_int : qa_sym;
+	case q_rreturn:
+	case q_ireturn:
+		return n == 1 ? qa_int : n == 2 ? qa_sym : qa_none;
+	case q_jmp:
+	case q_labl:
+		return n == 1 ? qa_int : qa_none;
+	case q_jmpf:
+		return n == 1 ? qa_int : n == 2 ? qa_sym : qa_none;
+	case q_rjnlt:
+	case q_ijnlt:
+	case q_rjngt:
+	case q_ijngt:
+	case q_rjneq:
+	case q_ijneq:
+	case q_rjnne:
+	case q_ijnne:
+		return n == 1 ? qa_int : qa_sym;
+	case q_param:
+		return n == 1 ? qa_sym : qa_none;
+	case q_nop:
+		return qa_none;
+	default:
+		// All the binary operations, relations and array accesses.
+		return qa_sym;
+	}
+}
+
+/* Returns true if argument n of a quad is a symbol whose value it reads.
+ Stores read the address they store into from their third argument, and
+ the quads comparing and jumping their second operand. */
+bool quad_reads(quad_op_type op, int n) {
+	return quad_arg(op, n) == qa_sym && (n != 3 || op == q_istore
+			|| op == q_rstore || quad_conditional_jump(op));
+}
+
+/* Returns true if the third argument of a quad is the symbol it assigns. */
+bool quad_assigns(quad_op_type op) {
+	return quad_arg(op, 3) == qa_sym && op != q_istore && op != q_rstore
+			&& !quad_conditional_jump(op);
+}
+
+bool quad_conditional_jump(quad_op_type op) {
+	switch (op) {
+	case q_jmpf:
+	case q_rjnlt:
+	case q_ijnlt:
+	case q_rjngt:
+	case q_ijngt:
+	case q_rjneq:
+	case q_ijneq:
+	case q_rjnne:
+	case q_ijnne:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* Finds the q_call each q_param of a quad list passes its argument to, and
+ sets call[i] to the index of that call for parameters and to -1 for the
+ other quads. The arguments are passed last first, and other calls may come
+ between them when they are computed, so a call takes the last int2
+ parameters not taken by a call before it. */
+void quad_parameters(quad_list *q_list, vector<int> &call) {
+	vector<int> pending;
+
+	call.assign(q_list->size(), -1);
+	for (int i = 0; i < q_list->size(); i++) {
+		quadruple q = q_list->get(i);
+		if (q.op_code == q_param) {
+			pending.push_back(i);
+		} else if (q.op_code == q_call) {
+			for (int p = 0; p < q.int2; p++) {
+				call[pending.back()] = i;
+				pending.pop_back();
+			}
+		}
+	}
+}
+
+/* Variables and parameters are the only quad arguments with values that
+ change. Constants don't, and arrays and procedures are only named. */
+bool quad_variable(sym_index sym_p) {
+	symbol *sym = sym_tab->get_symbol(sym_p);
+	return sym != NULL && (sym->tag == SYM_VAR || sym->tag == SYM_PARAM);
 }
 
 /* The quad_list_iterator constructor. It initializes the iterator to point
  to the first element of the quad list passed to it as an argument. */
 quad_list_iterator::quad_list_iterator(quad_list *q_list) :
-		current(q_list->head) {
+		list(q_list), index(0), current(q_nop, NULL_SYM, NULL_SYM, NULL_SYM) {
 }
 
 /* Return the current quad on the quad list we're iterating over, or NULL if
  we've reached the end of the list. */
 quadruple *quad_list_iterator::get_current() {
-	if (current == NULL) {
+	if (index >= list->size()) {
 		return NULL;
 	}
 
-	return current->data;
+	current = list->get(index);
+	return &current;
 }
 
 /* Return the next quadruple on the quad list we're iterating over, or NULL if
  there are no more. */
 quadruple *quad_list_iterator::get_next() {
-	if (current->next == NULL) {
+	if (index + 1 >= list->size()) {
 		return NULL;
 	}
 
-	current = current->next;
-	return current->data;
+	index++;
+	return get_current();
 }
 
 /* The quad_list class. */
 quad_list::quad_list(int ll) :
-		head(NULL), tail(NULL), last_label(ll) {
+		last_label(ll) {
 	quad_nr = 1;
 }
 
-/* Operator for adding on a new quadruple to the list. */
-quad_list &quad_list::operator+=(quadruple *q) {
-	if (head == NULL) {
-		head = new quad_list_element(q, NULL);
-		tail = head;
-	} else {
-		tail->next = new quad_list_element(q, NULL);
-		tail = tail->next;
+/* Packs a quad. Arguments that don't fit in an int go in the pool. */
+packed_quad quad_list::pack(const quadruple &q) {
+	static_assert(sizeof(packed_quad) == 16, "packed_quad should be 16 bytes");
+
+	packed_quad p;
+	long syms[3] = { q.sym1, q.sym2, q.sym3 };
+	long args[3] = { q.int1, q.int2, q.int3 };
+
+	p.op_code = q.op_code;
+	p.arg_types = 0;
+	p.pooled = 0;
+	p.unused = 0;
+	for (int i = 0; i < 3; i++) {
+		// The symN fields are used for sym arguments and the intN ones for
+		// the others, so either may have been changed after construction.
+		if (quad_arg(q.op_code, i + 1) == qa_sym) {
+			args[i] = syms[i];
+		}
+		p.arg_types |= quad_arg(q.op_code, i + 1) << (2 * i);
+		if (args[i] >= INT_MIN && args[i] <= INT_MAX) {
+			p.args[i] = args[i];
+		} else {
+			p.pooled |= 1 << i;
+			p.args[i] = pool.size();
+			pool.push_back(args[i]);
+		}
 	}
+	return p;
+}
 
+/* Returns argument number i (0, 1 or 2) of a packed quad. */
+long quad_list::unpack(const packed_quad &p, int i) {
+	if (p.pooled & (1 << i)) {
+		return pool[p.args[i]];
+	}
+	return p.args[i];
+}
+
+/* Operator for adding on a new quadruple to the list. */
+quad_list &quad_list::operator+=(const quadruple &q) {
+	quads.push_back(pack(q));
 	return *this;
 }
 
+int quad_list::size() {
+	return quads.size();
+}
+
+quadruple quad_list::get(int i) {
+	const packed_quad &p = quads[i];
+	return quadruple((quad_op_type) p.op_code, unpack(p, 0), unpack(p, 1),
+			unpack(p, 2));
+}
+
+/* Note that a replaced quad's pooled values stay in the pool. Quad lists
+ only live as long as it takes to compile one block, so we don't mind. */
+void quad_list::set(int i, const quadruple &q) {
+	quads[i] = pack(q);
+}
+
+quad_op_type quad_list::op_code(int i) {
+	return (quad_op_type) quads[i].op_code;
+}
+
+void quad_list::insert(int i, const quadruple &q) {
+	quads.insert(quads.begin() + i, pack(q));
+}
+
+void quad_list::remove_nops() {
+	unsigned int kept = 0;
+	for (unsigned int i = 0; i < quads.size(); i++) {
+		if (quads[i].op_code != q_nop) {
+			quads[kept++] = quads[i];
+		}
+	}
+	quads.resize(kept);
+}
+
 /**************************************************************
  *** THE AST NODE METHODS FOR GENERATING QUADS FOLLOW HERE. ***
  **************************************************************/
@@ -118,7 +297,7 @@ sym_index ast_integer::generate_quads(quad_list &q) {
 	;
 	/* Your code here */
 	sym_index i = sym_tab->gen_temp_var(integer_type);
-	q += new quadruple(q_iload, this->value, NULL_SYM, i);
+	q += quadruple(q_iload, this->value, NULL_SYM, i);
 	return i;
 }
 
@@ -127,7 +306,7 @@ sym_index ast_real::generate_quads(quad_list &q) {
 	;
 	/* Your code here */
 	sym_index i = sym_tab->gen_temp_var(real_type);
-	q += new quadruple(q_rload, sym_tab->ieee(this->value), NULL_SYM, i);
+	q += quadruple(q_rload, sym_tab->ieee(this->value), NULL_SYM, i);
 	return i;
 }
 
@@ -144,7 +323,7 @@ sym_index ast_not::generate_quads(quad_list &q) {
 	/* Your code here */
 	sym_index i = this->expr->generate_quads(q);
 	sym_index temp = sym_tab->gen_temp_var(integer_type);
-	q += new quadruple(q_inot, i, NULL_SYM, temp);
+	q += quadruple(q_inot, i, NULL_SYM, temp);
 	return temp;
 }
 
@@ -156,11 +335,11 @@ sym_index ast_uminus::generate_quads(quad_list &q) {
 
 	if (sym_tab->get_symbol(i)->type == integer_type) {
 		sym_index temp = sym_tab->gen_temp_var(integer_type);
-		q += new quadruple(q_iuminus, i, NULL_SYM, temp);
+		q += quadruple(q_iuminus, i, NULL_SYM, temp);
 		return temp;
 	} else if (sym_tab->get_symbol(i)->type == real_type) {
 		sym_index temp = sym_tab->gen_temp_var(real_type);
-		q += new quadruple(q_ruminus, i, NULL_SYM, temp);
+		q += quadruple(q_ruminus, i, NULL_SYM, temp);
 		return temp;
 	}
 
@@ -174,7 +353,7 @@ sym_index ast_cast::generate_quads(quad_list &q) {
 	sym_index i = this->expr->generate_quads(q);
 	if (sym_tab->get_symbol(i)->type == integer_type) {
 		sym_index temp = sym_tab->gen_temp_var(real_type);
-		q += new quadruple(q_itor, i, NULL_SYM, temp);
+		q += quadruple(q_itor, i, NULL_SYM, temp);
 		return temp;
 	}
 
@@ -187,7 +366,52 @@ sym_index generate_quad_binop(quad_op_type q_, ast_binaryoperation *node,
 	sym_index ileft = node->left->generate_quads(q);
 	sym_index iright = node->right->generate_quads(q);
 	sym_index temp = sym_tab->gen_temp_var(node->type);
-	q += new quadruple(q_, ileft, iright, temp);
+	q += quadruple(q_, ileft, iright, temp);
+	return temp;
+}
+
+/* Returns k if the right operand of an integer operation is the literal
+ 2^k for some k >= 1, and 0 otherwise. The AST optimizer has moved the
+ literal operand of a multiplication to the right. Strength reduction is
+ only done from optimization level 1, to keep the quads identical to the
+ trace files at level 0. */
+static int power_of_two(ast_binaryoperation *node) {
+	if (!optimize || optimize_level < 1 || node->type != integer_type)
+		return 0;
+
+	ast_integer *right = node->right->get_ast_integer();
+	if (right == NULL || right->value < 2
+			|| (right->value & (right->value - 1)) != 0)
+		return 0;
+
+	int k = 0;
+	while ((1L << k) != right->value)
+		k++;
+	return k;
+}
+
+/* Returns the divisor of a div or mod if it is an integer literal that
+ neither the AST optimizer nor power_of_two() has taken care of, and 0
+ otherwise. Division by 0, 1 and -1 is left to idiv, and so is LONG_MIN
+ whose absolute value doesn't fit in a long. */
+static long constant_divisor(ast_binaryoperation *node) {
+	if (!optimize || optimize_level < 1)
+		return 0;
+
+	ast_integer *right = node->right->get_ast_integer();
+	if (right == NULL || right->value == LONG_MIN
+			|| (right->value >= -1 && right->value <= 1))
+		return 0;
+	return right->value;
+}
+
+/* Generates a quad for an operation with a constant right operand, which
+ is given as an int argument instead of being loaded into a temporary. */
+sym_index generate_quad_constop(quad_op_type q_, ast_binaryoperation *node,
+		long c, quad_list &q) {
+	sym_index ileft = node->left->generate_quads(q);
+	sym_index temp = sym_tab->gen_temp_var(integer_type);
+	q += quadruple(q_, ileft, c, temp);
 	return temp;
 }
 
@@ -221,6 +445,9 @@ sym_index ast_mult::generate_quads(quad_list &q) {
 	USE_Q
 	;
 	/* Your code here */
+	int k = power_of_two(this);
+	if (k != 0)
+		return generate_quad_constop(q_ishl, this, k, q);
 	if (this->type == integer_type)
 		return generate_quad_binop(q_imult, this, q);
 	else if (this->type == real_type)
@@ -241,6 +468,12 @@ sym_index ast_idiv::generate_quads(quad_list &q) {
 	USE_Q
 	;
 	/* Your code here */
+	int k = power_of_two(this);
+	if (k != 0)
+		return generate_quad_constop(q_ishr, this, k, q);
+	long d = constant_divisor(this);
+	if (d != 0)
+		return generate_quad_constop(q_idivc, this, d, q);
 	return generate_quad_binop(q_idivide, this, q);
 }
 
@@ -248,6 +481,12 @@ sym_index ast_mod::generate_quads(quad_list &q) {
 	USE_Q
 	;
 	/* Your code here */
+	int k = power_of_two(this);
+	if (k != 0)
+		return generate_quad_constop(q_imask, this, k, q);
+	long d = constant_divisor(this);
+	if (d != 0)
+		return generate_quad_constop(q_imodc, this, d, q);
 	return generate_quad_binop(q_imod, this, q);
 }
 
@@ -273,9 +512,9 @@ sym_index ast_equal::generate_quads(quad_list &q) {
 	sym_index iright = this->right->generate_quads(q);
 	sym_index temp = sym_tab->gen_temp_var(this->type);
 	if (this->type == integer_type)
-		q += new quadruple(q_ieq, ileft, iright, temp);
+		q += quadruple(q_ieq, ileft, iright, temp);
 	else
-		q += new quadruple(q_req, ileft, iright, temp);
+		q += quadruple(q_req, ileft, iright, temp);
 
 	return temp;
 }
@@ -288,9 +527,9 @@ sym_index ast_notequal::generate_quads(quad_list &q) {
 	sym_index iright = this->right->generate_quads(q);
 	sym_index temp = sym_tab->gen_temp_var(this->type);
 	if (this->left->type == integer_type)
-		q += new quadruple(q_ine, ileft, iright, temp);
+		q += quadruple(q_ine, ileft, iright, temp);
 	else
-		q += new quadruple(q_rne, ileft, iright, temp);
+		q += quadruple(q_rne, ileft, iright, temp);
 
 	return temp;
 }
@@ -303,9 +542,9 @@ sym_index ast_lessthan::generate_quads(quad_list &q) {
 	sym_index iright = this->right->generate_quads(q);
 	sym_index temp = sym_tab->gen_temp_var(this->type);
 	if (this->left->type == integer_type)
-		q += new quadruple(q_ilt, ileft, iright, temp);
+		q += quadruple(q_ilt, ileft, iright, temp);
 	else
-		q += new quadruple(q_rlt, ileft, iright, temp);
+		q += quadruple(q_rlt, ileft, iright, temp);
 
 	return temp;
 }
@@ -318,13 +557,140 @@ sym_index ast_greaterthan::generate_quads(quad_list &q) {
 	sym_index iright = this->right->generate_quads(q);
 	sym_index temp = sym_tab->gen_temp_var(this->type);
 	if (this->left->type == integer_type)
-		q += new quadruple(q_igt, ileft, iright, temp);
+		q += quadruple(q_igt, ileft, iright, temp);
 	else
-		q += new quadruple(q_rgt, ileft, iright, temp);
+		q += quadruple(q_rgt, ileft, iright, temp);
 
 	return temp;
 }
 
+/* Generates quads for a condition, jumping to a label if it is false. */
+void ast_expression::generate_false_jump(quad_list &q, int label) {
+	sym_index cond = generate_quads(q);
+	q += quadruple(q_jmpf, label, cond, NULL_SYM);
+}
+
+/* Generates quads for a condition, jumping to a label if it is true. There
+ is no quad jumping on true, so this jumps past a q_jmp if it's false. */
+void ast_expression::generate_true_jump(quad_list &q, int label) {
+	int next = sym_tab->get_next_label();
+	generate_false_jump(q, next);
+	q += quadruple(q_jmp, label, NULL_SYM, NULL_SYM);
+	q += quadruple(q_labl, next, NULL_SYM, NULL_SYM);
+}
+
+/* From optimization level 1, and, or and not used as conditions jump to
+ where the condition leads as soon as the result is known, instead of
+ computing both operands and combining them. The right operand is only
+ skipped if it is free of side effects, see ast_optimizer::is_pure(), so
+ a function call in it still always happens. */
+static bool short_circuit(ast_binaryoperation *node) {
+	return ::optimize && optimize_level >= 1 && optimizer->is_pure(node->right);
+}
+
+void ast_and::generate_false_jump(quad_list &q, int label) {
+	if (!short_circuit(this)) {
+		ast_expression::generate_false_jump(q, label);
+		return;
+	}
+	left->generate_false_jump(q, label);
+	right->generate_false_jump(q, label);
+}
+
+void ast_and::generate_true_jump(quad_list &q, int label) {
+	if (!short_circuit(this)) {
+		ast_expression::generate_true_jump(q, label);
+		return;
+	}
+	int next = sym_tab->get_next_label();
+	left->generate_false_jump(q, next);
+	right->generate_true_jump(q, label);
+	q += quadruple(q_labl, next, NULL_SYM, NULL_SYM);
+}
+
+void ast_or::generate_false_jump(quad_list &q, int label) {
+	if (!short_circuit(this)) {
+		ast_expression::generate_false_jump(q, label);
+		return;
+	}
+	int next = sym_tab->get_next_label();
+	left->generate_true_jump(q, next);
+	right->generate_false_jump(q, label);
+	q += quadruple(q_labl, next, NULL_SYM, NULL_SYM);
+}
+
+void ast_or::generate_true_jump(quad_list &q, int label) {
+	if (!short_circuit(this)) {
+		ast_expression::generate_true_jump(q, label);
+		return;
+	}
+	left->generate_true_jump(q, label);
+	right->generate_true_jump(q, label);
+}
+
+void ast_not::generate_false_jump(quad_list &q, int label) {
+	if (!::optimize || optimize_level < 1) {
+		ast_expression::generate_false_jump(q, label);
+	} else {
+		expr->generate_true_jump(q, label);
+	}
+}
+
+void ast_not::generate_true_jump(quad_list &q, int label) {
+	if (!::optimize || optimize_level < 1) {
+		ast_expression::generate_true_jump(q, label);
+	} else {
+		expr->generate_false_jump(q, label);
+	}
+}
+
+/* From optimization level 1, relations used as conditions jump on the
+ comparison right away instead of computing 0 or 1 and testing it with a
+ q_jmpf. The quads are picked the same way generate_quads() picks the
+ relation. */
+static void generate_relation_jump(quad_op_type q_, ast_binaryrelation *node,
+		quad_list &q, int label) {
+	sym_index ileft = node->left->generate_quads(q);
+	sym_index iright = node->right->generate_quads(q);
+	q += quadruple(q_, label, ileft, iright);
+}
+
+void ast_equal::generate_false_jump(quad_list &q, int label) {
+	if (!::optimize || optimize_level < 1) {
+		ast_expression::generate_false_jump(q, label);
+	} else {
+		generate_relation_jump(this->left->type == integer_type ? q_ijneq
+				: q_rjneq, this, q, label);
+	}
+}
+
+void ast_notequal::generate_false_jump(quad_list &q, int label) {
+	if (!::optimize || optimize_level < 1) {
+		ast_expression::generate_false_jump(q, label);
+	} else {
+		generate_relation_jump(this->left->type == integer_type ? q_ijnne
+				: q_rjnne, this, q, label);
+	}
+}
+
+void ast_lessthan::generate_false_jump(quad_list &q, int label) {
+	if (!::optimize || optimize_level < 1) {
+		ast_expression::generate_false_jump(q, label);
+	} else {
+		generate_relation_jump(this->left->type == integer_type ? q_ijnlt
+				: q_rjnlt, this, q, label);
+	}
+}
+
+void ast_greaterthan::generate_false_jump(quad_list &q, int label) {
+	if (!::optimize || optimize_level < 1) {
+		ast_expression::generate_false_jump(q, label);
+	} else {
+		generate_relation_jump(this->left->type == integer_type ? q_ijngt
+				: q_rjngt, this, q, label);
+	}
+}
+
 /* Since an lvalue can be either an id or an array reference, we can't solve
  this the usual way since there's no instanceof operator in C++ to find out
  which class an object belongs to. So we define the method
@@ -332,9 +698,9 @@ sym_index ast_greaterthan::generate_quads(quad_list &q) {
  mechanism figure out which one to call. */
 void ast_id::generate_assignment(quad_list &q, sym_index rhs) {
 	if (type == integer_type) {
-		q += new quadruple(q_iassign, rhs, NULL_SYM, sym_p);
+		q += quadruple(q_iassign, rhs, NULL_SYM, sym_p);
 	} else if (type == real_type) {
-		q += new quadruple(q_rassign, rhs, NULL_SYM, sym_p);
+		q += quadruple(q_rassign, rhs, NULL_SYM, sym_p);
 	} else {
 		fatal("Illegal type in ast_id::generate_assignment()");
 	}
@@ -344,12 +710,12 @@ void ast_indexed::generate_assignment(quad_list &q, sym_index rhs) {
 	sym_index index_pos = index->generate_quads(q);
 	sym_index address = sym_tab->gen_temp_var(integer_type);
 
-	q += new quadruple(q_lindex, id->sym_p, index_pos, address);
+	q += quadruple(q_lindex, id->sym_p, index_pos, address);
 
 	if (type == integer_type) {
-		q += new quadruple(q_istore, rhs, NULL_SYM, address);
+		q += quadruple(q_istore, rhs, NULL_SYM, address);
 	} else if (type == real_type) {
-		q += new quadruple(q_rstore, rhs, NULL_SYM, address);
+		q += quadruple(q_rstore, rhs, NULL_SYM, address);
 	} else {
 		fatal("Illegal type in ast_indexed::generate_assignment()");
 	}
@@ -376,7 +742,7 @@ void ast_expr_list::generate_parameter_list(quad_list &q,
 	if (this->preceding != NULL) {
 		*nr_params = *nr_params + 1;
 		sym_index i = this->preceding->last_expr->generate_quads(q);
-		q += new quadruple(q_param, i, NULL_SYM, NULL_SYM);
+		q += quadruple(q_param, i, NULL_SYM, NULL_SYM);
 		this->preceding->generate_parameter_list(q, last_param->preceding,
 				nr_params);
 	}
@@ -393,7 +759,7 @@ sym_index ast_procedurecall::generate_quads(quad_list &q) {
 	if (this->parameter_list != NULL) {
 		*nr_params = *nr_params + 1;
 		sym_index i = this->parameter_list->last_expr->generate_quads(q);
-		q += new quadruple(q_param, i, NULL_SYM, NULL_SYM);
+		q += quadruple(q_param, i, NULL_SYM, NULL_SYM);
 
 		procedure_symbol* symb =
 				sym_tab->get_symbol(this->id->sym_p)->get_procedure_symbol();
@@ -401,7 +767,7 @@ sym_index ast_procedurecall::generate_quads(quad_list &q) {
 		this->parameter_list->generate_parameter_list(q, symb->last_parameter,
 				nr_params);
 	}
-	q += new quadruple(q_call, this->id->sym_p, *nr_params, NULL_SYM);
+	q += quadruple(q_call, this->id->sym_p, *nr_params, NULL_SYM);
 	return NULL_SYM;
 }
 
@@ -417,7 +783,7 @@ sym_index ast_functioncall::generate_quads(quad_list &q) {
 	if (this->parameter_list != NULL) {
 		*nr_params = *nr_params + 1;
 		sym_index i = this->parameter_list->last_expr->generate_quads(q);
-		q += new quadruple(q_param, i, NULL_SYM, NULL_SYM);
+		q += quadruple(q_param, i, NULL_SYM, NULL_SYM);
 
 		function_symbol* symb =
 				sym_tab->get_symbol(this->id->sym_p)->get_function_symbol();
@@ -426,7 +792,7 @@ sym_index ast_functioncall::generate_quads(quad_list &q) {
 				nr_params);
 	}
 
-	q += new quadruple(q_call, this->id->sym_p, *nr_params, temp);
+	q += quadruple(q_call, this->id->sym_p, *nr_params, temp);
 	return temp;
 }
 
@@ -438,22 +804,19 @@ sym_index ast_while::generate_quads(quad_list &q) {
 	int bottom = sym_tab->get_next_label();
 
 	// Here's the label for the top of the while body.
-	q += new quadruple(q_labl, top, NULL_SYM, NULL_SYM);
+	q += quadruple(q_labl, top, NULL_SYM, NULL_SYM);
 
-	// Generate quads for the condition. After this code is being run, we
-	// check if the result in the variable stored in 'pos' is 0. If it is,
-	// we want to exit the loop, which is done via a conditional jump to the
-	// 'bottom' label.
-	sym_index pos = condition->generate_quads(q);
-	q += new quadruple(q_jmpf, bottom, pos, NULL_SYM);
+	// Generate quads for the condition. If it's false we want to exit the
+	// loop, which is done via a conditional jump to the 'bottom' label.
+	condition->generate_false_jump(q, bottom);
 
 	// Generate quads for the body. Following these come an unconditional
 	// jump to the 'top' label, ie, run the condition etc again.
-	pos = body->generate_quads(q);
-	q += new quadruple(q_jmp, top, NULL_SYM, NULL_SYM);
+	body->generate_quads(q);
+	q += quadruple(q_jmp, top, NULL_SYM, NULL_SYM);
 
 	// This is where we jump to if the while condition evaluates to false.
-	q += new quadruple(q_labl, bottom, NULL_SYM, NULL_SYM);
+	q += quadruple(q_labl, bottom, NULL_SYM, NULL_SYM);
 
 	return NULL_SYM;
 }
@@ -466,15 +829,14 @@ void ast_elsif::generate_quads_and_jump(quad_list &q, int label) {
 	/* Your code here */
 	int next = sym_tab->get_next_label();
 
-	sym_index cond = this->condition->generate_quads(q);
-	q += new quadruple(q_jmpf, next, cond, NULL_SYM);
+	this->condition->generate_false_jump(q, next);
 
 	if (this->body != NULL)
 		this->body->generate_quads(q);
 
-	q += new quadruple(q_jmp, label, NULL_SYM, NULL_SYM);
+	q += quadruple(q_jmp, label, NULL_SYM, NULL_SYM);
 
-	q += new quadruple(q_labl, next, NULL_SYM, NULL_SYM);
+	q += quadruple(q_labl, next, NULL_SYM, NULL_SYM);
 }
 
 /* Generate quads (with an ending jump to an end label) for an elsif list.
@@ -504,23 +866,21 @@ sym_index ast_if::generate_quads(quad_list &q) {
 
 	int bottom = sym_tab->get_next_label();
 
-	sym_index cond = this->condition->generate_quads(q);
-
 	if(this->elsif_list != NULL || this->else_body != NULL){
-		q += new quadruple(q_jmpf, next, cond, NULL_SYM);
+		this->condition->generate_false_jump(q, next);
 	} else {
-		q += new quadruple(q_jmpf, bottom, cond, NULL_SYM);
+		this->condition->generate_false_jump(q, bottom);
 	}
 
 
 
 	this->body->generate_quads(q);
 	if(this->elsif_list != NULL || this->else_body != NULL){
-		q += new quadruple(q_jmp, bottom, NULL_SYM, NULL_SYM);
+		q += quadruple(q_jmp, bottom, NULL_SYM, NULL_SYM);
 	}
 
 	if(this->elsif_list != NULL || this->else_body != NULL){
-		q += new quadruple(q_labl, next, NULL_SYM, NULL_SYM);
+		q += quadruple(q_labl, next, NULL_SYM, NULL_SYM);
 	}
 	if (this->elsif_list != NULL) {
 		this->elsif_list->generate_quads_and_jump(q, bottom);
@@ -530,7 +890,7 @@ sym_index ast_if::generate_quads(quad_list &q) {
 		this->else_body->generate_quads(q);
 	}
 
-	q += new quadruple(q_labl, bottom, NULL_SYM, NULL_SYM);
+	q += quadruple(q_labl, bottom, NULL_SYM, NULL_SYM);
 	return NULL_SYM;
 }
 
@@ -544,11 +904,11 @@ sym_index ast_return::generate_quads(quad_list &q) {
 	if (this->value != NULL) {
 		sym_index i = this->value->generate_quads(q);
 		if (this->value->type == integer_type)
-			q += new quadruple(q_ireturn, q.last_label, i, NULL_SYM);
+			q += quadruple(q_ireturn, q.last_label, i, NULL_SYM);
 		else
-			q += new quadruple(q_rreturn, q.last_label, i, NULL_SYM);
+			q += quadruple(q_rreturn, q.last_label, i, NULL_SYM);
 	}else {
-		q += new quadruple(q_rreturn, q.last_label, NULL_SYM, NULL_SYM);
+		q += quadruple(q_rreturn, q.last_label, NULL_SYM, NULL_SYM);
 	}
 
 	return NULL_SYM;
@@ -564,9 +924,9 @@ sym_index ast_indexed::generate_quads(quad_list &q) {
 	sym_index temp = sym_tab->gen_temp_var(this->index->type);
 
 	if (this->id->type == integer_type) {
-		q += new quadruple(q_irindex, this->id->sym_p, i, temp);
+		q += quadruple(q_irindex, this->id->sym_p, i, temp);
 	} else if (this->id->type == real_type) {
-		q += new quadruple(q_rrindex, this->id->sym_p, i, temp);
+		q += quadruple(q_rrindex, this->id->sym_p, i, temp);
 	} else {
 		fatal("strange type in ast:indexed");
 	}
@@ -585,6 +945,15 @@ sym_index ast_stmt_list::generate_quads(quad_list &q) {
 	return NULL_SYM;
 }
 
+/* The body of an inlined function is generated in place of the call, and
+ the result is the value of the call. */
+sym_index ast_inlinedcall::generate_quads(quad_list &q) {
+	if (body != NULL) {
+		body->generate_quads(q);
+	}
+	return result->generate_quads(q);
+}
+
 /* These classes won't actually appear in the part of the AST we generate
  code for, but since we're using abstract virtual methods, these methods
  need to be defined. */
@@ -612,7 +981,11 @@ quad_list *ast_procedurehead::do_quads(ast_stmt_list *s) {
 		s->generate_quads(*q);
 	}
 
-	(*q) += new quadruple(q_labl, last_label, NULL_SYM, NULL_SYM);
+	(*q) += quadruple(q_labl, last_label, NULL_SYM, NULL_SYM);
+
+	if (::optimize && optimize_level >= 2) {
+		quad_opt->do_optimize(q);
+	}
 
 	return q;
 }
@@ -625,7 +998,11 @@ quad_list *ast_functionhead::do_quads(ast_stmt_list *s) {
 		s->generate_quads(*q);
 	}
 
-	(*q) += new quadruple(q_labl, last_label, NULL_SYM, NULL_SYM);
+	(*q) += quadruple(q_labl, last_label, NULL_SYM, NULL_SYM);
+
+	if (::optimize && optimize_level >= 2) {
+		quad_opt->do_optimize(q);
+	}
 
 	return q;
 }
@@ -713,6 +1090,26 @@ void quadruple::print(ostream &o) {
 				<< setw(11) << sym_tab->get_symbol(sym2) << setw(11)
 				<< sym_tab->get_symbol(sym3);
 		break;
+	case q_ishl:
+		o << setw(11) << "q_ishl" << setw(11) << sym_tab->get_symbol(sym1)
+				<< setw(11) << int2 << setw(11) << sym_tab->get_symbol(sym3);
+		break;
+	case q_ishr:
+		o << setw(11) << "q_ishr" << setw(11) << sym_tab->get_symbol(sym1)
+				<< setw(11) << int2 << setw(11) << sym_tab->get_symbol(sym3);
+		break;
+	case q_imask:
+		o << setw(11) << "q_imask" << setw(11) << sym_tab->get_symbol(sym1)
+				<< setw(11) << int2 << setw(11) << sym_tab->get_symbol(sym3);
+		break;
+	case q_idivc:
+		o << setw(11) << "q_idivc" << setw(11) << sym_tab->get_symbol(sym1)
+				<< setw(11) << int2 << setw(11) << sym_tab->get_symbol(sym3);
+		break;
+	case q_imodc:
+		o << setw(11) << "q_imodc" << setw(11) << sym_tab->get_symbol(sym1)
+				<< setw(11) << int2 << setw(11) << sym_tab->get_symbol(sym3);
+		break;
 	case q_req:
 		o << setw(11) << "q_req" << setw(11) << sym_tab->get_symbol(sym1)
 				<< setw(11) << sym_tab->get_symbol(sym2) << setw(11)
@@ -796,6 +1193,14 @@ void quadruple::print(ostream &o) {
 				<< setw(11) << sym_tab->get_symbol(sym2) << setw(11)
 				<< sym_tab->get_symbol(sym3);
 		break;
+	case q_rderef:
+		o << setw(11) << "q_rderef" << setw(11) << sym_tab->get_symbol(sym1)
+				<< setw(11) << "-" << setw(11) << sym_tab->get_symbol(sym3);
+		break;
+	case q_ideref:
+		o << setw(11) << "q_ideref" << setw(11) << sym_tab->get_symbol(sym1)
+				<< setw(11) << "-" << setw(11) << sym_tab->get_symbol(sym3);
+		break;
 	case q_itor:
 		o << setw(11) << "q_itor" << setw(11) << sym_tab->get_symbol(sym1)
 				<< setw(11) << "-" << setw(11) << sym_tab->get_symbol(sym3);
@@ -808,6 +1213,46 @@ void quadruple::print(ostream &o) {
 		o << setw(11) << "q_jmpf" << setw(11) << int1 << setw(11)
 				<< sym_tab->get_symbol(sym2) << setw(11) << "-";
 		break;
+	case q_rjnlt:
+		o << setw(11) << "q_rjnlt" << setw(11) << int1 << setw(11)
+				<< sym_tab->get_symbol(sym2) << setw(11)
+				<< sym_tab->get_symbol(sym3);
+		break;
+	case q_ijnlt:
+		o << setw(11) << "q_ijnlt" << setw(11) << int1 << setw(11)
+				<< sym_tab->get_symbol(sym2) << setw(11)
+				<< sym_tab->get_symbol(sym3);
+		break;
+	case q_rjngt:
+		o << setw(11) << "q_rjngt" << setw(11) << int1 << setw(11)
+				<< sym_tab->get_symbol(sym2) << setw(11)
+				<< sym_tab->get_symbol(sym3);
+		break;
+	case q_ijngt:
+		o << setw(11) << "q_ijngt" << setw(11) << int1 << setw(11)
+				<< sym_tab->get_symbol(sym2) << setw(11)
+				<< sym_tab->get_symbol(sym3);
+		break;
+	case q_rjneq:
+		o << setw(11) << "q_rjneq" << setw(11) << int1 << setw(11)
+				<< sym_tab->get_symbol(sym2) << setw(11)
+				<< sym_tab->get_symbol(sym3);
+		break;
+	case q_ijneq:
+		o << setw(11) << "q_ijneq" << setw(11) << int1 << setw(11)
+				<< sym_tab->get_symbol(sym2) << setw(11)
+				<< sym_tab->get_symbol(sym3);
+		break;
+	case q_rjnne:
+		o << setw(11) << "q_rjnne" << setw(11) << int1 << setw(11)
+				<< sym_tab->get_symbol(sym2) << setw(11)
+				<< sym_tab->get_symbol(sym3);
+		break;
+	case q_ijnne:
+		o << setw(11) << "q_ijnne" << setw(11) << int1 << setw(11)
+				<< sym_tab->get_symbol(sym2) << setw(11)
+				<< sym_tab->get_symbol(sym3);
+		break;
 	case q_param:
 		o << setw(11) << "q_param" << setw(11) << sym_tab->get_symbol(sym1)
 				<< setw(11) << "-" << setw(11) << "-";
@@ -827,16 +1272,11 @@ void quadruple::print(ostream &o) {
 }
 
 void quad_list::print(ostream &o) {
-	quad_list_element *e;
-
 	o << short_symbols;
 
-	quad_nr = 1;
-	e = head;
-	while (e != NULL) {
-		o << setw(5) << quad_nr << e->data << endl;
-		e = e->next;
-		quad_nr++;
+	for (quad_nr = 1; quad_nr <= size(); quad_nr++) {
+		quadruple q = get(quad_nr - 1);
+		o << setw(5) << quad_nr << &q << endl;
 	}
 
 	o << long_symbols;
@@ -1,6 +1,8 @@
 #ifndef __QUADS_HH__
 #define __QUADS_HH__
 
+#include <vector>
+
 #include "ast.hh"
 
 /* Credits to David Byers for the design of this class. /Jonas */
@@ -10,6 +12,18 @@
    we're representing reals as ieee 64-bit integers when we have come this
    far in the compiling. 'sym' is a sym_index, which is just a typedef for
    a long int (see symtab.hh). '-' means the argument is not used. */
+/* q_ishl, q_ishr and q_imask are the strength reduced forms of q_imult,
+   q_idivide and q_imod by the constant 2^int. q_ishr rounds towards zero
+   and q_imask takes the sign of the dividend, exactly like the quads they
+   replace. q_idivc and q_imodc are q_idivide and q_imod by any other
+   constant int, which the code generator does with a multiplication.
+   q_rderef and q_ideref load the element at an address computed by
+   q_lindex, the way q_rstore and q_istore store one. The quad optimizer
+   uses them when it steps an address through an array in a loop.
+   q_rjnlt .. q_ijnne are q_jmpf on a relation computed by the same quad:
+   they jump to the label unless sym rel sym holds, eg q_ijnlt unless the
+   first is less than the second. They are generated for the conditions of
+   if, elsif and while statements from optimization level 1. */
 typedef enum {
     q_rload,       // int, -, sym
     q_iload,       // int, -, sym
@@ -27,6 +41,11 @@ typedef enum {
     q_rdivide,     // sym, sym, sym
     q_idivide,     // sym, sym, sym
     q_imod,        // sym, sym, sym
+    q_ishl,        // sym, int, sym
+    q_ishr,        // sym, int, sym
+    q_imask,       // sym, int, sym
+    q_idivc,       // sym, int, sym
+    q_imodc,       // sym, int, sym
     q_req,         // sym, sym, sym
     q_ieq,         // sym, sym, sym
     q_rne,         // sym, sym, sym
@@ -45,9 +64,19 @@ typedef enum {
     q_lindex,      // sym, sym, sym
     q_rrindex,     // sym, sym, sym
     q_irindex,     // sym, sym, sym
+    q_rderef,      // sym, -, sym
+    q_ideref,      // sym, -, sym
     q_itor,        // sym, -, sym
     q_jmp,         // int, -, -
     q_jmpf,        // int, sym, -
+    q_rjnlt,       // int, sym, sym
+    q_ijnlt,       // int, sym, sym
+    q_rjngt,       // int, sym, sym
+    q_ijngt,       // int, sym, sym
+    q_rjneq,       // int, sym, sym
+    q_ijneq,       // int, sym, sym
+    q_rjnne,       // int, sym, sym
+    q_ijnne,       // int, sym, sym
     q_param,       // sym, -, -
     q_labl,        // int, -, -
     q_nop          // -, -, -
@@ -56,10 +85,38 @@ typedef enum {
 
 class quad_list;
 
+/* What an argument of a quad is, according to the table above. */
+typedef enum {
+    qa_none,       // '-', not used.
+    qa_sym,        // A sym_index.
+    qa_int         // An integer (or real) value, or a label number.
+} quad_arg_type;
+
+// Returns the type of argument 1, 2 or 3 of a quad. See quads.cc.
+quad_arg_type quad_arg(quad_op_type, int);
+
+// Returns true if argument 1, 2 or 3 of a quad is read, and if argument 3
+// is assigned. Calls read and assign more than that, see quadopt.cc.
+bool quad_reads(quad_op_type, int);
+bool quad_assigns(quad_op_type);
+
+// Returns true if a quad argument is a variable or parameter.
+bool quad_variable(sym_index);
+
+// Returns true for q_jmpf and the quads comparing and jumping, which jump
+// to the label in their first argument or fall through.
+bool quad_conditional_jump(quad_op_type);
+
+// Finds the q_call each q_param of a quad list passes its argument to.
+void quad_parameters(quad_list *, vector<int> &);
+
+
 /* The quadruple class. A quadruple is a pseudo-assembler op-code with three
    arguments (more correctly, two arguments and one result), which depend on
    the op_code of the quad. To create a quad with a '-' argument (ie, not used),
-   set the sym_index value to NULL_SYM for that quad. See above. */
+   set the sym_index value to NULL_SYM for that quad. See above.
+   Quads aren't stored like this in a quad_list, see packed_quad below. This
+   class is how they are created and looked at. */
 class quadruple
 {
 private:
@@ -90,24 +147,37 @@ public:
 };
 
 
-/* This class is simply an abstraction to prevent quads from having to
-   contain a link to the next quad, which is a representation issue having
-   nothing to do with the program it represents. */
-class quad_list_element
+/* The form a quad is stored in inside a quad_list: 16 bytes instead of the
+   56 of a quadruple. Every argument is kept as a 32-bit int. The few values
+   that don't fit, ie large integers and the ieee bit patterns of reals in
+   q_iload and q_rload, are put in the constant pool of the quad list, and
+   the argument holds their index in the pool instead. */
+class packed_quad
 {
 public:
-    quadruple         *data;
-    quad_list_element *next;
+    // A quad_op_type.
+    unsigned char op_code;
 
-    quad_list_element(quadruple *, quad_list_element *);
-};
+    // Two bits per argument, giving its quad_arg_type.
+    unsigned char arg_types;
 
+    // One bit per argument, set if it is an index into the constant pool.
+    unsigned char pooled;
 
+    unsigned char unused;
 
-/* This class lets us iterate over a quad_list in a convenient fashion. */
+    int args[3];
+};
+
+
+/* This class lets us iterate over a quad_list in a convenient fashion. The
+   quad returned is an unpacked copy, owned by the iterator and only valid
+   until the next call. */
 class quad_list_iterator
 {
-    quad_list_element *current;
+    quad_list *list;
+    int       index;
+    quadruple current;
 
 public:
     quad_list_iterator(quad_list *q_list);
@@ -124,15 +194,17 @@ public:
 /* A list of quads. This list will eventually contain the entire program in
    quad operations. Or at least entire blocks at a time. Had we represented
    the entire program as an AST, the list would have contained the whole
-   program, but since we don't, it doesn't. :-) */
+   program, but since we don't, it doesn't. :-)
+   The quads are kept packed in a single array, so they can be accessed by
+   their index (0 for the first quad) as well as by an iterator. */
 class quad_list
 {
 private:
-    // Pointer to the first list element.
-    quad_list_element *head;
+    // The quads, in order.
+    vector<packed_quad> quads;
 
-    // Pointer to the rest of the elements.
-    quad_list_element *tail;
+    // Values of quad arguments that don't fit in 32 bits.
+    vector<long> pool;
 
     // Used to get nice printouts.
     int quad_nr;
@@ -140,6 +212,10 @@ private:
      // Used to get nice printouts.
     void print(ostream &);
 
+    // Converts between the two quad representations.
+    packed_quad pack(const quadruple &);
+    long unpack(const packed_quad &, int);
+
 public:
     // Label marking the end of a quad list.
     int last_label;
@@ -148,7 +224,26 @@ public:
     quad_list(int);
 
     // Add on a new quad last on the list.
-    quad_list &operator+=(quadruple *q);
+    quad_list &operator+=(const quadruple &q);
+
+    // The number of quads in the list.
+    int size();
+
+    // Returns an unpacked copy of the quad at an index.
+    quadruple get(int);
+
+    // Replaces the quad at an index.
+    void set(int, const quadruple &);
+
+    // Returns the op code of the quad at an index without unpacking it.
+    quad_op_type op_code(int);
+
+    // Inserts a quad before the one at an index.
+    void insert(int, const quadruple &);
+
+    // Removes the q_nop quads the quad optimizer has left behind, which
+    // moves the quads after them to lower indexes.
+    void remove_nops();
 
     // Allow the iterator access to private data fields in this class.
     friend class quad_list_iterator;
@@ -0,0 +1,352 @@
+#include <algorithm>
+
+#include "regalloc.hh"
+
+/*** This file contains the linear scan register allocator, see
+ regalloc.hh. ***/
+
+register_allocator *reg_alloc = new register_allocator();
+
+// The registers handed out, in the order they are preferred. The called
+// procedure must save those in the second list if it uses them, see
+// code_generator::prologue(). RAX, RCX and RDX are the scratch registers of
+// the code generator, and XMM0 and XMM1 those it does real arithmetic in.
+// R11 holds frame addresses, see code_generator::frame_register(). Calls may
+// change all the XMM registers.
+static const register_type caller_saved[] = { RSI, RDI, R8, R9, R10 };
+static const register_type callee_saved[] = { RBX, R12, R13, R14, R15 };
+static const register_type xmm_registers[] = { XMM2, XMM3, XMM4, XMM5, XMM6,
+		XMM7, XMM8, XMM9, XMM10, XMM11, XMM12, XMM13, XMM14, XMM15 };
+
+static bool saved_by_callee(register_type r)
+{
+	return find(callee_saved, callee_saved + 5, r) != callee_saved + 5;
+}
+
+live_interval::live_interval(sym_index var, int start, bool real) :
+	var(var),
+	start(start),
+	end(start),
+	real(real),
+	crosses_call(false)
+{
+}
+
+/* Returns true if a variable of the procedure on a level may be kept in a
+ register. Arrays never are, and neither are parameters unless the caller
+ passes them in a register. */
+static bool allocatable(sym_index sym_p, block_level level, bool params,
+		set<sym_index> &nonlocal)
+{
+	symbol *sym = sym_tab->get_symbol(sym_p);
+	if (sym->level != level || nonlocal.find(sym_p) != nonlocal.end()) {
+		return false;
+	}
+	return sym->tag == SYM_VAR || (sym->tag == SYM_PARAM && params
+			&& parameter_register(sym->get_parameter_symbol()) != NR_REGISTERS);
+}
+
+/* Returns true if the code generator loads argument 1, 2 or 3 of a quad
+ onto the FPU stack or into an XMM register to compute with it, or stores it
+ from there. The types of temp vars can't be relied on to tell whether they
+ are reals, but these can. */
+static bool real_operand(quad_op_type op, int n)
+{
+	switch (op) {
+	case q_ruminus:
+	case q_rplus:
+	case q_rminus:
+	case q_rmult:
+	case q_rdivide:
+		return true;
+	case q_req:
+	case q_rne:
+	case q_rlt:
+	case q_rgt:
+		return n != 3;
+	case q_itor:
+		return n == 3;
+	case q_rjnlt:
+	case q_rjngt:
+	case q_rjneq:
+	case q_rjnne:
+		return n != 1;
+	default:
+		return false;
+	}
+}
+
+static bool by_start(const live_interval &a, const live_interval &b)
+{
+	return a.start < b.start;
+}
+
+/* Computes the live intervals of the variables of a quad list that may get
+ a register. The variables live when the list is entered are left out, as
+ the code reading them relies on what their slot happens to hold, except
+ for the parameters passed in registers, and so are the reals computed with
+ on the FPU stack unless SSE is used. */
+void register_allocator::find_intervals(quad_list *q_list, block_level level,
+		bool sse, bool params, vector<live_interval> &intervals)
+{
+	int n = q_list->size();
+
+	// The arguments the code generator may load right before each call
+	// rather than at their q_param, see code_generator::find_arguments().
+	vector<int> call;
+	vector<vector<sym_index> > passed(n);
+
+	quad_parameters(q_list, call);
+	for (int i = 0; i < n && params; i++) {
+		if (call[i] != -1) {
+			passed[call[i]].push_back(q_list->get(i).sym1);
+		}
+	}
+
+	// Note the variables of enclosing blocks used here, and the reals, and
+	// number the variables that may get a register.
+	map<sym_index, int> number;
+	vector<sym_index> vars;
+	set<sym_index> reals;
+
+	for (int i = 0; i < n; i++) {
+		quadruple q = q_list->get(i);
+		sym_index args[3] = { q.sym1, q.sym2, q.sym3 };
+		for (int a = 0; a < 3; a++) {
+			if (quad_arg(q.op_code, a + 1) != qa_sym
+					|| !quad_variable(args[a])) {
+				continue;
+			}
+			if (sym_tab->get_symbol(args[a])->level < level) {
+				nonlocal.insert(args[a]);
+			}
+			if (real_operand(q.op_code, a + 1)) {
+				reals.insert(args[a]);
+			}
+		}
+	}
+	for (int i = 0; i < n; i++) {
+		quadruple q = q_list->get(i);
+		sym_index args[3] = { q.sym1, q.sym2, q.sym3 };
+		for (int a = 0; a < 3; a++) {
+			if (quad_arg(q.op_code, a + 1) == qa_sym
+					&& quad_variable(args[a])
+					&& allocatable(args[a], level, params, nonlocal)
+					&& (sse || reals.find(args[a]) == reals.end())
+					&& number.find(args[a]) == number.end()) {
+				number[args[a]] = vars.size();
+				vars.push_back(args[a]);
+			}
+		}
+	}
+
+	// The variables read before being assigned in each block, and the ones
+	// assigned. Calls don't read or assign any of them, as they aren't
+	// visible to other procedures, but they may read their arguments.
+	control_flow_graph cfg(q_list);
+	int v_count = vars.size();
+	int blocks = cfg.blocks.size();
+	vector<vector<bool> > use(blocks, vector<bool>(v_count, false));
+	vector<vector<bool> > def(blocks, vector<bool>(v_count, false));
+
+	for (int b = 0; b < blocks; b++) {
+		for (int i = cfg.blocks[b].first; i <= cfg.blocks[b].last; i++) {
+			quadruple q = q_list->get(i);
+			sym_index args[3] = { q.sym1, q.sym2, q.sym3 };
+			for (int a = 0; a < 3; a++) {
+				if (quad_reads(q.op_code, a + 1)
+						&& number.find(args[a]) != number.end()
+						&& !def[b][number[args[a]]]) {
+					use[b][number[args[a]]] = true;
+				}
+			}
+			for (unsigned int p = 0; p < passed[i].size(); p++) {
+				if (number.find(passed[i][p]) != number.end()
+						&& !def[b][number[passed[i][p]]]) {
+					use[b][number[passed[i][p]]] = true;
+				}
+			}
+			if (quad_assigns(q.op_code) && number.find(q.sym3) != number.end()) {
+				def[b][number[q.sym3]] = true;
+			}
+		}
+	}
+
+	// Solve for the variables live at the start and end of each block. All
+	// blocks are included, since the code generator also expands those that
+	// can't be reached.
+	vector<vector<bool> > live_in(blocks, vector<bool>(v_count, false));
+	vector<vector<bool> > live_out(blocks, vector<bool>(v_count, false));
+	bool changed = true;
+
+	while (changed) {
+		changed = false;
+		for (int b = blocks - 1; b >= 0; b--) {
+			basic_block &block = cfg.blocks[b];
+			for (unsigned int s = 0; s < block.succ.size(); s++) {
+				for (int v = 0; v < v_count; v++) {
+					if (live_in[block.succ[s]][v]) {
+						live_out[b][v] = true;
+					}
+				}
+			}
+			for (int v = 0; v < v_count; v++) {
+				bool in = use[b][v] || (live_out[b][v] && !def[b][v]);
+				if (in != live_in[b][v]) {
+					live_in[b][v] = in;
+					changed = true;
+				}
+			}
+		}
+	}
+
+	// A variable is live from the start of the blocks it is live into to
+	// just past the end of those it is live out of, and at each quad using
+	// it.
+	vector<int> first(v_count, -1);
+	vector<int> last(v_count, -1);
+
+	for (int b = 0; b < blocks; b++) {
+		basic_block &block = cfg.blocks[b];
+		for (int v = 0; v < v_count; v++) {
+			if (live_in[b][v]) {
+				first[v] = first[v] == -1 ? block.first
+						: min(first[v], block.first);
+				last[v] = max(last[v], block.first);
+			}
+			if (live_out[b][v]) {
+				first[v] = first[v] == -1 ? block.last
+						: min(first[v], block.last);
+				last[v] = max(last[v], block.last + 1);
+			}
+		}
+		for (int i = block.first; i <= block.last; i++) {
+			quadruple q = q_list->get(i);
+			sym_index args[3] = { q.sym1, q.sym2, q.sym3 };
+			for (int a = 0; a < 3; a++) {
+				if (quad_arg(q.op_code, a + 1) == qa_sym
+						&& number.find(args[a]) != number.end()) {
+					int v = number[args[a]];
+					first[v] = first[v] == -1 ? i : min(first[v], i);
+					last[v] = max(last[v], i);
+				}
+			}
+			for (unsigned int p = 0; p < passed[i].size(); p++) {
+				if (number.find(passed[i][p]) != number.end()) {
+					int v = number[passed[i][p]];
+					last[v] = max(last[v], i);
+				}
+			}
+		}
+	}
+
+	// The parameters are set before the first quad, so they are live across
+	// a call there.
+	for (int v = 0; v < v_count; v++) {
+		if (sym_tab->get_symbol(vars[v])->tag == SYM_PARAM) {
+			first[v] = -1;
+		} else if (live_in[0][v]) {
+			continue;
+		}
+		intervals.push_back(live_interval(vars[v], first[v],
+				reals.find(vars[v]) != reals.end()));
+		intervals.back().end = last[v];
+	}
+
+	for (int i = 0; i < n; i++) {
+		if (q_list->op_code(i) != q_call) {
+			continue;
+		}
+		for (unsigned int v = 0; v < intervals.size(); v++) {
+			if (intervals[v].start < i && intervals[v].end > i) {
+				intervals[v].crosses_call = true;
+			}
+		}
+	}
+
+	sort(intervals.begin(), intervals.end(), by_start);
+}
+
+/* Hands out the registers in two lists to the intervals of one class, in
+ the order they start. The first list is of registers a call may change,
+ the second of those it saves. */
+void register_allocator::scan(vector<live_interval> &intervals, bool real,
+		vector<register_type> free_caller, vector<register_type> free_callee,
+		map<sym_index, register_type> &registers, set<register_type> &used)
+{
+	// The intervals holding a register.
+	vector<live_interval *> active;
+
+	for (unsigned int i = 0; i < intervals.size(); i++) {
+		live_interval &current = intervals[i];
+		if (current.real != real) {
+			continue;
+		}
+
+		// Give back the registers of the intervals that have ended.
+		for (unsigned int a = 0; a < active.size(); a++) {
+			if (active[a]->end < current.start) {
+				register_type r = registers[active[a]->var];
+				if (saved_by_callee(r)) {
+					free_callee.insert(free_callee.begin(), r);
+				} else {
+					free_caller.insert(free_caller.begin(), r);
+				}
+				active.erase(active.begin() + a);
+				a--;
+			}
+		}
+
+		register_type r;
+		if (!current.crosses_call && !free_caller.empty()) {
+			r = free_caller.front();
+			free_caller.erase(free_caller.begin());
+		} else if (!free_callee.empty()) {
+			r = free_callee.front();
+			free_callee.erase(free_callee.begin());
+		} else {
+			// Spill the interval ending last among the current one and
+			// those holding a register it could use.
+			live_interval *spill = &current;
+			for (unsigned int a = 0; a < active.size(); a++) {
+				register_type held = registers[active[a]->var];
+				if ((!current.crosses_call || saved_by_callee(held))
+						&& active[a]->end > spill->end) {
+					spill = active[a];
+				}
+			}
+			if (spill == &current) {
+				continue;
+			}
+			r = registers[spill->var];
+			registers.erase(spill->var);
+			active.erase(find(active.begin(), active.end(), spill));
+		}
+
+		registers[current.var] = r;
+		active.push_back(&current);
+		if (saved_by_callee(r)) {
+			used.insert(r);
+		}
+	}
+}
+
+void register_allocator::allocate(quad_list *q_list, block_level level,
+		bool sse, bool params, map<sym_index, register_type> &registers,
+		vector<register_type> &saved)
+{
+	vector<live_interval> intervals;
+	set<register_type> used;
+
+	registers.clear();
+	saved.clear();
+	find_intervals(q_list, level, sse, params, intervals);
+
+	scan(intervals, false, vector<register_type>(caller_saved,
+			caller_saved + 5), vector<register_type>(callee_saved,
+			callee_saved + 5), registers, used);
+	scan(intervals, true, vector<register_type>(xmm_registers,
+			xmm_registers + 14), vector<register_type>(), registers, used);
+
+	saved.assign(used.begin(), used.end());
+}
@@ -0,0 +1,77 @@
+#ifndef __REGALLOC_HH__
+#define __REGALLOC_HH__
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "quads.hh"
+#include "cfg.hh"
+#include "codegen.hh"
+
+/*** Linear scan register allocation, after Poletto and Sarkar, "Linear Scan
+ Register Allocation". It is run by the code generator on each quad list from
+ optimization level 2, and gives the temp vars and local variables of the
+ procedure registers of their own, so that fetch() and store() become
+ register moves. Reals used in arithmetic get XMM registers when the code
+ generator does it with SSE. The variables that don't get one are spilled,
+ ie they stay in their slot in the activation record, where the code
+ generator has always kept everything.
+
+ The live range of a variable is approximated by a single interval of quad
+ indexes, from the first to the last quad where it is live. Intervals are
+ handed registers in order of their start, and when they run out, the one
+ ending last is spilled. Variables live across a call must be in one of the
+ registers the called procedure saves (rbx and r12 to r15), so reals live
+ across a call are always spilled. The others may use any register the code
+ generator doesn't use as a scratch register. ***/
+
+/* The quad indexes a variable is live between, both included. */
+class live_interval
+{
+public:
+	sym_index var;
+	int start;
+	int end;
+
+	// True if the variable is a real which goes in an XMM register.
+	bool real;
+
+	// True if there is a call inside the interval, which may change all
+	// registers but those saved by the callee.
+	bool crosses_call;
+
+	live_interval(sym_index, int, bool);
+};
+
+class register_allocator;
+
+// Defined in regalloc.cc.
+extern register_allocator *reg_alloc;
+
+class register_allocator
+{
+private:
+	// The variables of enclosing blocks used by the quad lists seen so far.
+	// Nested procedures are generated before the block they are declared
+	// in, so when that block gets its registers, we know which of its
+	// variables they use. Those must stay in memory.
+	set<sym_index> nonlocal;
+
+	void find_intervals(quad_list *, block_level, bool, bool,
+			vector<live_interval> &);
+	void scan(vector<live_interval> &, bool, vector<register_type>,
+			vector<register_type>, map<sym_index, register_type> &,
+			set<register_type> &);
+
+public:
+	// Assigns registers to the variables of a quad list, whose own variables
+	// are those on the level given. Reals only get one if the code generator
+	// uses SSE for them, and parameters if it passes them in registers.
+	// Fills in the register of each variable that got one, and the callee
+	// saved registers used, which the prologue must save.
+	void allocate(quad_list *, block_level, bool, bool,
+			map<sym_index, register_type> &, vector<register_type> &);
+};
+
+#endif
@@ -0,0 +1,234 @@
+#include "ssa.hh"
+
+/*** This file contains the construction of SSA form, see ssa.hh. It follows
+ Cytron et al., "Efficiently Computing Static Single Assignment Form and the
+ Control Dependence Graph", with the dominance frontiers computed as in
+ Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm". ***/
+
+ssa_name::ssa_name(sym_index var, int quad, int phi) :
+	var(var),
+	quad(quad),
+	phi(phi)
+{
+}
+
+ssa_form::ssa_form(quad_list *q, control_flow_graph *g) :
+	quads(q),
+	cfg(g)
+{
+	int n = quads->size();
+
+	quad_def.assign(n, -1);
+	quad_use.assign(3 * n, -1);
+	block_of.assign(n, -1);
+	block_phis.resize(cfg->blocks.size());
+	for (unsigned int b = 0; b < cfg->blocks.size(); b++) {
+		for (int i = cfg->blocks[b].first; i <= cfg->blocks[b].last; i++) {
+			block_of[i] = b;
+		}
+	}
+
+	find_variables();
+	place_phis();
+
+	// The bottom of each stack is the value the variable has on entry.
+	stacks.resize(vars.size());
+	for (unsigned int v = 0; v < vars.size(); v++) {
+		stacks[v].push_back(new_name(vars[v], -1, -1));
+	}
+	if (!cfg->rpo_order.empty()) {
+		rename(0);
+	}
+}
+
+int ssa_form::new_name(sym_index var, int quad, int phi)
+{
+	names.push_back(ssa_name(var, quad, phi));
+	return names.size() - 1;
+}
+
+/* Numbers the variables read or assigned by the quads that can be
+ reached. */
+void ssa_form::find_variables()
+{
+	for (unsigned int r = 0; r < cfg->rpo_order.size(); r++) {
+		basic_block &block = cfg->blocks[cfg->rpo_order[r]];
+
+		for (int i = block.first; i <= block.last; i++) {
+			quadruple q = quads->get(i);
+			sym_index args[3] = { q.sym1, q.sym2, q.sym3 };
+
+			for (int a = 0; a < 3; a++) {
+				if ((quad_reads(q.op_code, a + 1)
+						|| (a == 2 && quad_assigns(q.op_code)))
+						&& quad_variable(args[a])
+						&& var_number.find(args[a]) == var_number.end()) {
+					var_number[args[a]] = vars.size();
+					vars.push_back(args[a]);
+					call_clobbers.push_back(!sym_tab->is_temp_var(args[a]));
+				}
+			}
+		}
+	}
+}
+
+/* Places phi nodes at the iterated dominance frontier of the blocks
+ assigning each variable. */
+void ssa_form::place_phis()
+{
+	int blocks = cfg->blocks.size();
+
+	// The dominance frontier of a block is where its dominance ends: the
+	// blocks it doesn't strictly dominate which have a predecessor it does.
+	vector<vector<int> > frontier(blocks);
+	for (int b = 0; b < blocks; b++) {
+		basic_block &block = cfg->blocks[b];
+		if (block.rpo == -1 || block.pred.size() < 2) {
+			continue;
+		}
+		for (unsigned int p = 0; p < block.pred.size(); p++) {
+			int runner = block.pred[p];
+			if (cfg->blocks[runner].rpo == -1) {
+				continue;
+			}
+			while (runner != -1 && runner != block.idom) {
+				if (frontier[runner].empty() || frontier[runner].back() != b) {
+					frontier[runner].push_back(b);
+				}
+				runner = cfg->blocks[runner].idom;
+			}
+		}
+	}
+
+	// The blocks assigning each variable. Calls assign all the variables
+	// they may change.
+	vector<vector<int> > def_blocks(vars.size());
+	for (unsigned int r = 0; r < cfg->rpo_order.size(); r++) {
+		int b = cfg->rpo_order[r];
+		for (int i = cfg->blocks[b].first; i <= cfg->blocks[b].last; i++) {
+			quadruple q = quads->get(i);
+			if (q.op_code == q_call) {
+				for (unsigned int v = 0; v < vars.size(); v++) {
+					if (call_clobbers[v] && (def_blocks[v].empty()
+							|| def_blocks[v].back() != b)) {
+						def_blocks[v].push_back(b);
+					}
+				}
+			}
+			if (quad_assigns(q.op_code) && quad_variable(q.sym3)) {
+				int v = var_number[q.sym3];
+				if (def_blocks[v].empty() || def_blocks[v].back() != b) {
+					def_blocks[v].push_back(b);
+				}
+			}
+		}
+	}
+
+	// The stamps tell which variable a block last got a phi node for, and
+	// was last put on the work list for.
+	vector<int> has_phi(blocks, -1);
+	vector<int> queued(blocks, -1);
+	vector<int> work;
+
+	for (unsigned int v = 0; v < vars.size(); v++) {
+		work = def_blocks[v];
+		for (unsigned int w = 0; w < work.size(); w++) {
+			queued[work[w]] = v;
+		}
+		while (!work.empty()) {
+			int x = work.back();
+			work.pop_back();
+			for (unsigned int f = 0; f < frontier[x].size(); f++) {
+				int y = frontier[x][f];
+				if (has_phi[y] == (int) v) {
+					continue;
+				}
+				has_phi[y] = v;
+
+				// The entry block also gets the value on entry, after the
+				// ones from its predecessors.
+				phi_node phi;
+				phi.var = vars[v];
+				phi.block = y;
+				phi.name = new_name(vars[v], -1, phis.size());
+				phi.args.assign(cfg->blocks[y].pred.size() + (y == 0), -1);
+				block_phis[y].push_back(phis.size());
+				phis.push_back(phi);
+
+				if (queued[y] != (int) v) {
+					queued[y] = v;
+					work.push_back(y);
+				}
+			}
+		}
+	}
+}
+
+/* Renames the variables in a block and the blocks it dominates. */
+void ssa_form::rename(int b)
+{
+	basic_block &block = cfg->blocks[b];
+	vector<int> pushed;
+
+	for (unsigned int p = 0; p < block_phis[b].size(); p++) {
+		phi_node &phi = phis[block_phis[b][p]];
+		int v = var_number[phi.var];
+		if (b == 0) {
+			phi.args.back() = stacks[v][0];
+			names[stacks[v][0]].phi_uses.push_back(block_phis[b][p]);
+		}
+		stacks[v].push_back(phi.name);
+		pushed.push_back(v);
+	}
+
+	for (int i = block.first; i <= block.last; i++) {
+		quadruple q = quads->get(i);
+		sym_index args[3] = { q.sym1, q.sym2, q.sym3 };
+
+		for (int a = 0; a < 3; a++) {
+			if (quad_reads(q.op_code, a + 1) && quad_variable(args[a])) {
+				int name = stacks[var_number[args[a]]].back();
+				quad_use[3 * i + a] = name;
+				names[name].quad_uses.push_back(i);
+			}
+		}
+		if (q.op_code == q_call) {
+			for (unsigned int v = 0; v < vars.size(); v++) {
+				if (call_clobbers[v]) {
+					int name = new_name(vars[v], i, -1);
+					call_defs[i].push_back(name);
+					stacks[v].push_back(name);
+					pushed.push_back(v);
+				}
+			}
+		}
+		if (quad_assigns(q.op_code) && quad_variable(q.sym3)) {
+			int v = var_number[q.sym3];
+			quad_def[i] = new_name(q.sym3, i, -1);
+			stacks[v].push_back(quad_def[i]);
+			pushed.push_back(v);
+		}
+	}
+
+	for (unsigned int s = 0; s < block.succ.size(); s++) {
+		basic_block &succ = cfg->blocks[block.succ[s]];
+		unsigned int j = 0;
+		while (succ.pred[j] != b) {
+			j++;
+		}
+		for (unsigned int p = 0; p < block_phis[block.succ[s]].size(); p++) {
+			int phi = block_phis[block.succ[s]][p];
+			int name = stacks[var_number[phis[phi].var]].back();
+			phis[phi].args[j] = name;
+			names[name].phi_uses.push_back(phi);
+		}
+	}
+
+	for (unsigned int c = 0; c < block.dom_children.size(); c++) {
+		rename(block.dom_children[c]);
+	}
+
+	for (unsigned int p = 0; p < pushed.size(); p++) {
+		stacks[pushed[p]].pop_back();
+	}
+}
@@ -0,0 +1,102 @@
+#ifndef __SSA_HH__
+#define __SSA_HH__
+
+#include <map>
+#include <vector>
+
+#include "quads.hh"
+#include "cfg.hh"
+
+/*** Static single assignment form of a quad list. Every assignment to a
+ variable or parameter, including temp vars, gets a name of its own, and
+ phi nodes are placed where different names of a variable meet (at the
+ iterated dominance frontier of the assignments). Each argument a quad reads
+ is then linked to the one name that reaches it.
+
+ The names are kept beside the quads instead of being written into them,
+ since giving each one a symbol would quickly fill up the symbol table. This
+ means every name of a variable is stored in the variable itself, so going
+ back out of SSA form is just a matter of dropping the phi nodes. That only
+ holds as long as two names of the same variable are never live at the same
+ time, so passes using this must not move quads or make them read another
+ name than they did. Replacing a quad by a load of the constant it computes,
+ as sparse conditional constant propagation does, is fine. ***/
+
+/* A name, ie one definition of a variable. */
+class ssa_name
+{
+public:
+	sym_index var;
+
+	// The quad or phi node defining it. Both are -1 for the value the
+	// variable has when the quad list is entered. A call defines a name for
+	// every variable it may change, see ssa_form::call_defs.
+	int quad;
+	int phi;
+
+	// The quads and phi nodes reading it.
+	vector<int> quad_uses;
+	vector<int> phi_uses;
+
+	ssa_name(sym_index, int, int);
+};
+
+/* A phi node at the start of a block. It picks the name of its variable
+ coming from each predecessor. */
+class phi_node
+{
+public:
+	sym_index var;
+	int block;
+
+	// The name it defines.
+	int name;
+
+	// The name coming from each predecessor, in the order of the pred list
+	// of the block.
+	vector<int> args;
+};
+
+class ssa_form
+{
+private:
+	// The variables of the quad list, numbered from 0, and which of them
+	// may be changed by calls, which is all but the temp vars.
+	vector<sym_index> vars;
+	map<sym_index, int> var_number;
+	vector<bool> call_clobbers;
+
+	// Per variable, the names reaching the current point while renaming.
+	vector<vector<int> > stacks;
+
+	void find_variables();
+	void place_phis();
+	void rename(int);
+	int new_name(sym_index, int, int);
+
+public:
+	quad_list *quads;
+	control_flow_graph *cfg;
+
+	vector<ssa_name> names;
+	vector<phi_node> phis;
+
+	// The phi nodes of each block.
+	vector<vector<int> > block_phis;
+
+	// For each quad, the name it defines or -1, and the name read by each
+	// of its three arguments or -1 (quad number * 3 + argument - 1).
+	vector<int> quad_def;
+	vector<int> quad_use;
+
+	// The names each call defines for the variables it may change.
+	map<int, vector<int> > call_defs;
+
+	// The block each quad is in.
+	vector<int> block_of;
+
+	// Builds SSA form for a quad list with an up to date graph.
+	ssa_form(quad_list *, control_flow_graph *);
+};
+
+#endif
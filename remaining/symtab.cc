@@ -66,6 +66,8 @@ symbol_table::symbol_table() {
 
 	label_nr = -1;
 	temp_nr = 0;
+	forget_temps = false;
+	kept_pos = NULL_SYM;
 	// sym_pos will point to the last entry in symbol table
 	sym_pos = -1;
 
@@ -182,6 +184,65 @@ sym_index symbol_table::gen_temp_var(sym_index type) {
 	return NULL_SYM;
 }
 
+/* Temp vars are the only symbols whose names begin with a '$', since the
+ scanner doesn't allow it in identifiers. */
+bool symbol_table::is_temp_var(const sym_index sym_p) {
+	symbol *sym = get_symbol(sym_p);
+	return sym->tag == SYM_VAR && pool_lookup(sym->id)[0] == '$';
+}
+
+/* Recomputes the offsets of the local variables and arrays of the current
+ block the same way enter_variable() and enter_array() did, but skipping
+ the temp vars that are no longer used. The argument is indexed by
+ sym_index, and indexes past its end count as unused. Only the ar_size of
+ the block and the offsets of the symbols that are kept change. */
+void symbol_table::remove_temp_vars(const vector<bool> &used) {
+	symbol *env = sym_table[current_environment()];
+	int ar_size = 0;
+
+	for (sym_index i = current_environment() + 1; i <= sym_pos; i++) {
+		symbol *sym = sym_table[i];
+		if (sym->level != current_level) {
+			continue;
+		}
+		if (sym->tag == SYM_VAR) {
+			if (is_temp_var(i) && (i >= (sym_index) used.size() || !used[i])) {
+				continue;
+			}
+			variable_symbol *var = sym->get_variable_symbol();
+			var->offset = ar_size;
+			ar_size += get_size(var->type);
+		} else if (sym->tag == SYM_ARRAY) {
+			array_symbol *arr = sym->get_array_symbol();
+			if (arr->array_cardinality != ILLEGAL_ARRAY_CARD) {
+				arr->offset = ar_size;
+				ar_size += arr->array_cardinality * get_size(arr->type);
+			}
+		}
+	}
+
+	if (env->tag == SYM_FUNC) {
+		env->get_function_symbol()->ar_size = ar_size;
+	} else {
+		env->get_procedure_symbol()->ar_size = ar_size;
+	}
+}
+
+/* Both the symbol table and the hash table limit the number of symbols,
+ see install_symbol(). */
+sym_index symbol_table::free_symbols() {
+	sym_index limit = MAX_SYM < MAX_HASH ? MAX_SYM : MAX_HASH;
+	return limit - sym_pos;
+}
+
+void symbol_table::forget_temp_vars() {
+	forget_temps = true;
+}
+
+void symbol_table::keep_symbols() {
+	kept_pos = sym_pos;
+}
+
 /* This function returns the byte size of a nametype. */
 
 int symbol_table::get_size(const sym_index type) {
@@ -533,6 +594,17 @@ sym_index symbol_table::close_scope() {
 
 	}
 
+	// The temp vars are installed last. Nothing refers to them once the
+	// code of the block has been generated, unless they have been kept.
+	if (forget_temps) {
+		while (sym_pos > kept_pos && is_temp_var(sym_pos)
+				&& sym_table[sym_pos]->level >= current_level) {
+			delete sym_table[sym_pos];
+			sym_table[sym_pos] = NULL;
+			sym_pos--;
+		}
+	}
+
 	--current_level;
 
 	return current_level;
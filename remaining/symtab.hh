@@ -1,6 +1,8 @@
 #ifndef __SYMTAB_HH__
 #define __SYMTAB_HH__
 
+#include <vector>
+
 #include "error.hh"
 
 // Set this #define to 0 after the scanner works.
@@ -140,6 +142,10 @@ public:
     // Constructor.
     symbol(pool_index);
 
+    // Virtual, as the temp vars the symbol table forgets are deleted
+    // through this class. See symbol_table::close_scope().
+    virtual ~symbol() {}
+
     // Currently lacks print method/operator.
     // Currently lacks some other needed stuff like conversions to and
     //   from strings.
@@ -420,6 +426,11 @@ private:
     // Temp variable counter.
     long temp_nr;
 
+    // Whether close_scope() forgets the temp vars of the block it closes,
+    // and the last symbol which it never forgets. See forget_temp_vars().
+    bool forget_temps;
+    sym_index kept_pos;
+
 public:
     // NOTE: Some of these methods should be made private.
 
@@ -497,6 +508,26 @@ public:
     // Generate, install and return sym_index to next temp var.
     sym_index gen_temp_var(sym_index);
 
+    // Returns true if a symbol is a temp var made by gen_temp_var().
+    bool is_temp_var(const sym_index);
+
+    // Lays out the activation record of the current block again, leaving
+    // out the temp vars for which the argument is false. Used by the quad
+    // optimizer when it has removed quads. See quadopt.cc.
+    void remove_temp_vars(const vector<bool> &);
+
+    // Returns how many more symbols can be installed before the table is
+    // full. Used by the inliner, see inline.cc.
+    sym_index free_symbols();
+
+    // Makes close_scope() forget the temp vars of each block once its code
+    // has been generated, so that their entries can be used again. Those
+    // installed before the last call of keep_symbols() are kept, since the
+    // inliner's copies of bodies refer to them. Used from optimization
+    // level 2, see inline.cc.
+    void forget_temp_vars();
+    void keep_symbols();
+
     // These functions are used to enter identifiers into the symbol table,
     // depending on their context (function, constant, etc).
 